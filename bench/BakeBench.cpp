@@ -0,0 +1,229 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "MediaPack.h"
+
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+
+// Playback cost of baked media against live decoding of the same clip.
+// Every frame is copied into a buffer with DIB row alignment, as monitor does while drawing.
+// Each mode runs in its own process, so working sets aren't mixed. Mapped pages of baked file
+// are shared: run several "baked" processes on the same file, their private memory stays small.
+//
+// usage: BakeBench bake <media_file> <baked_file> <width> <height> [bgra|bgr24]
+//        BakeBench live <media_file> <width> <height> [frames] [bgra|bgr24]
+//        BakeBench baked <baked_file> [frames]
+// e.g.:  BakeBench bake clip_2160p.mp4 clip.dwb 2560 1440
+//        BakeBench live clip_2160p.mp4 2560 1440 600
+//        BakeBench baked clip.dwb 600
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+static double GetProcessCpuMs()
+{
+#ifdef _WIN32
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+		return 0.0;
+
+	// 100 ns units
+	auto to_ms = [](const FILETIME& time) {
+		return (((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime) / 10000.0;
+	};
+
+	return to_ms(kernel_time) + to_ms(user_time);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.0;
+
+	auto to_ms = [](const struct timeval& time) {
+		return time.tv_sec * 1000.0 + time.tv_usec / 1000.0;
+	};
+
+	return to_ms(usage.ru_utime) + to_ms(usage.ru_stime);
+#endif
+}
+
+static void PrintMemory()
+{
+	double working_set = 0.0, peak = 0.0, private_bytes = 0.0;
+
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	counters.cb = sizeof(counters);
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return;
+
+	working_set = (double)counters.WorkingSetSize;
+	peak = (double)counters.PeakWorkingSetSize;
+	private_bytes = (double)counters.PagefileUsage;
+#else
+	// resident, peak resident and resident anonymous memory in kB, mapped file pages aren't anonymous
+	std::ifstream status("/proc/self/status");
+	if (!status)
+		return;
+
+	std::string line;
+	while (std::getline(status, line)) {
+		std::istringstream fields(line);
+		std::string key;
+		double kb = 0.0;
+		if (!(fields >> key >> kb))
+			continue;
+
+		if (key == "VmRSS:")
+			working_set = kb * 1024.0;
+		else if (key == "VmHWM:")
+			peak = kb * 1024.0;
+		else if (key == "RssAnon:")
+			private_bytes = kb * 1024.0;
+	}
+#endif
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< "working set MB: " << working_set / (1024.0 * 1024.0)
+		<< ", peak: " << peak / (1024.0 * 1024.0)
+		<< ", private MB: " << private_bytes / (1024.0 * 1024.0) << std::endl;
+}
+
+static int Play(MediaPack& media, long max_frames)
+{
+	long width = 0, height = 0;
+	if (!media.GetScaledResolution(width, height)) {
+		std::cout << "Can't get resolution." << std::endl;
+		return 1;
+	}
+
+	int bpp = GetBytesPerPixel(media.GetOutputFormat());
+
+	// DIB rows are aligned to 4 bytes
+	long dib_stride = (width * bpp + 3) & ~3;
+	std::vector<uint8_t> dib_pixels((size_t)dib_stride * height);
+
+	// baked frames aren't copied into queue buffer
+	std::vector<uint8_t> queue_buffer(media.IsBaked() ? 0 : media.GetFrameBufferSize());
+
+	Frame frame;
+	long frames = 0;
+
+	double start_cpu = GetProcessCpuMs();
+	auto start = std::chrono::steady_clock::now();
+
+	while (frames < max_frames) {
+		// baked media gives pointers into mapping, live media decodes into queue buffer
+		frame.frame_buf = queue_buffer.data();
+		frame.linesize = 0;
+
+		int code = media.IsBaked() ? media.GetNextFrame(frame) : media.DecodeNextFrame(frame);
+		if (code)
+			break;
+
+		for (long row = 0; row < height; ++row) {
+			std::memcpy(dib_pixels.data() + dib_stride * row, frame.frame_buf + (size_t)frame.linesize * row, width * bpp);
+		}
+
+		++frames;
+	}
+
+	double cpu_ms = GetProcessCpuMs() - start_cpu;
+	ms_d elapsed = std::chrono::steady_clock::now() - start;
+
+	if (frames == 0) {
+		std::cout << "No frames played." << std::endl;
+		return 1;
+	}
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< (media.IsBaked() ? "baked" : "live") << " " << width << "x" << height
+		<< " frames: " << frames
+		<< ", CPU ms per frame: " << cpu_ms / frames
+		<< ", wall ms per frame: " << elapsed.count() / frames << std::endl;
+
+	PrintMemory();
+
+	return 0;
+}
+
+static FrameFormat ParseFormat(int argc, char* argv[], int index)
+{
+	return (argc > index && std::string(argv[index]) == "bgr24") ? FrameFormat::BGR24 : FrameFormat::BGRA;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string mode = argc > 1 ? argv[1] : "";
+
+	bool is_valid = (mode == "bake" && argc >= 6) || (mode == "live" && argc >= 5) || (mode == "baked" && argc >= 3);
+	if (!is_valid) {
+		std::cout << "usage: " << argv[0] << " bake <media_file> <baked_file> <width> <height> [bgra|bgr24]" << std::endl;
+		std::cout << "       " << argv[0] << " live <media_file> <width> <height> [frames] [bgra|bgr24]" << std::endl;
+		std::cout << "       " << argv[0] << " baked <baked_file> [frames]" << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	try {
+		if (mode == "bake") {
+			MediaPack media(argv[2]);
+			media.SetOutputFormat(ParseFormat(argc, argv, 6));
+			if (!media.SetScaling(std::stol(argv[4]), std::stol(argv[5]))) {
+				std::cout << "Can't set scaling." << std::endl;
+				return 1;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+
+			size_t frames_count = 0;
+			if (!BakedMedia::Bake(media, argv[3], frames_count)) {
+				std::cout << "Can't bake media." << std::endl;
+				return 1;
+			}
+
+			ms_d elapsed = std::chrono::steady_clock::now() - start;
+			std::cout << "baked frames: " << frames_count << " in " << std::fixed << std::setprecision(0) << elapsed.count() << " ms" << std::endl;
+		}
+		else if (mode == "live") {
+			MediaPack media(argv[2]);
+			media.SetOutputFormat(ParseFormat(argc, argv, 6));
+			if (!media.SetScaling(std::stol(argv[3]), std::stol(argv[4]))) {
+				std::cout << "Can't set scaling." << std::endl;
+				return 1;
+			}
+
+			return Play(media, argc > 5 ? std::stol(argv[5]) : 600);
+		}
+		else {
+			MediaPack media(argv[2]);
+			if (!media.IsBaked()) {
+				std::cout << argv[2] << " isn't baked media." << std::endl;
+				return 1;
+			}
+
+			return Play(media, argc > 3 ? std::stol(argv[3]) : 600);
+		}
+	}
+	catch (std::exception& exception) {
+		std::cout << exception.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
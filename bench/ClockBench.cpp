@@ -0,0 +1,157 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "MediaClock.h"
+
+// Drift of presentation deadlines of MediaClock against exact media time, for NTSC frame rates
+// (24000/1001, 30000/1001) and a variable frame rate pattern, over hours of looped media played
+// into a null sink. Timestamps are made like MediaPack makes them (pts * time base + loop offset
+// in doubles) and the simulated player wakes up late by up to 2 ms, like sleep_until does.
+// Fails if a deadline drifts by more than one frame duration or the clock has to resync.
+// Sleeping for durations rounded to milliseconds (the player before MediaClock) is shown for comparison.
+//
+// usage: ClockBench [hours] [loop_seconds]
+// e.g.:  ClockBench 24 60
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+struct ClockCase {
+	const char* name;
+	int64_t time_base_num, time_base_den;
+
+	// pts steps of frames, repeated
+	std::vector<int64_t> steps;
+};
+
+struct Drift {
+	double max_drift_ms = 0.0;
+	double rounded_drift_ms = 0.0;
+	double frame_ms = 0.0;
+	uint64_t frames = 0;
+	uint64_t resyncs = 0;
+};
+
+// deterministic wake-up lateness in [0, 2) ms
+static std::chrono::steady_clock::duration GetJitter(uint64_t& state)
+{
+	state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return std::chrono::microseconds((state >> 33) % 2000);
+}
+
+static Drift RunCase(const ClockCase& clock_case, double hours, double loop_seconds)
+{
+	Drift drift;
+
+	double base_time = (double)clock_case.time_base_num / clock_case.time_base_den;
+	int64_t min_step = *std::min_element(clock_case.steps.begin(), clock_case.steps.end());
+	drift.frame_ms = min_step * base_time * 1000.0;
+
+	// the same pts sequence in every loop, it ends after loop_seconds
+	std::vector<int64_t> loop_pts;
+	int64_t loop_ticks = 0;
+	for (size_t i = 0; loop_ticks * base_time < loop_seconds; ++i) {
+		loop_pts.push_back(loop_ticks);
+		loop_ticks += clock_case.steps[i % clock_case.steps.size()];
+	}
+
+	MediaClock clock;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::time_point() + std::chrono::hours(1);
+	std::chrono::steady_clock::time_point now = start;
+
+	double loop_offset = 0.0, last_timestamp = 0.0, last_duration = 0.0;
+	int64_t loop_start_ticks = 0;
+	double rounded_ms = 0.0;
+	uint64_t jitter_state = 1;
+
+	for (size_t i = 0; ; ++i) {
+		size_t index = i % loop_pts.size();
+
+		// media is looped, timestamps continue after the last frame
+		if (i > 0 && index == 0) {
+			loop_offset = last_timestamp + last_duration;
+			loop_start_ticks += loop_ticks;
+		}
+
+		int64_t pts = loop_pts[index];
+		int64_t next_pts = index + 1 < loop_pts.size() ? loop_pts[index + 1] : loop_ticks;
+
+		double timestamp = pts * base_time + loop_offset;
+		double duration = (next_pts - pts) * base_time;
+
+		// exact media time from integer ticks
+		int64_t ticks = loop_start_ticks + pts;
+		long double exact = (long double)ticks * clock_case.time_base_num / clock_case.time_base_den;
+		if (exact > hours * 3600.0)
+			break;
+
+		if (!clock.IsStarted())
+			clock.Start(timestamp, now);
+
+		clock.CorrectDrift(timestamp, now);
+
+		std::chrono::steady_clock::time_point deadline = clock.GetDeadline(timestamp);
+		double error_ms = (ms_d(deadline - start).count() - (double)(exact * 1000.0));
+		drift.max_drift_ms = std::max(drift.max_drift_ms, std::abs(error_ms));
+
+		// player sleeps until deadline and presents the frame
+		if (deadline > now)
+			now = deadline;
+		now += GetJitter(jitter_state);
+
+		// sleep for the frame duration in whole milliseconds
+		rounded_ms += std::round(duration * 1000.0);
+
+		last_timestamp = timestamp;
+		last_duration = duration;
+		++drift.frames;
+	}
+
+	long double total_ms = (long double)(loop_start_ticks + loop_ticks) * clock_case.time_base_num / clock_case.time_base_den * 1000.0;
+	drift.rounded_drift_ms = std::abs(rounded_ms - (double)total_ms);
+	drift.resyncs = clock.GetResyncCount();
+
+	return drift;
+}
+
+int main(int argc, char* argv[])
+{
+	double hours = argc > 1 ? std::stod(argv[1]) : 24.0;
+	double loop_seconds = argc > 2 ? std::stod(argv[2]) : 60.0;
+	if (hours <= 0.0 || loop_seconds <= 0.0) {
+		std::cout << "usage: " << argv[0] << " [hours] [loop_seconds]" << std::endl;
+		return 1;
+	}
+
+	std::vector<ClockCase> cases = {
+		{ "23.976 fps", 1001, 24000, { 1 } },
+		{ "29.97 fps", 1001, 30000, { 1 } },
+		{ "23.976 fps in 1/90000", 1, 90000, { 3754, 3753 } },
+		{ "VFR 1/90000", 1, 90000, { 3003, 3754, 2252, 3003, 6006, 1501, 4505 } },
+		{ "VFR 1/1000", 1, 1000, { 33, 34, 33, 41, 17, 50 } }
+	};
+
+	std::cout << hours << " h of media looped every " << loop_seconds << " s, deadline against exact media time:" << std::endl;
+
+	bool success = true;
+	for (const ClockCase& clock_case : cases) {
+		Drift drift = RunCase(clock_case, hours, loop_seconds);
+
+		bool passed = drift.max_drift_ms <= drift.frame_ms && drift.resyncs == 0;
+		success = success && passed;
+
+		std::cout << "   " << std::left << std::setw(24) << clock_case.name << std::right << std::fixed << std::setprecision(3)
+			<< " frames " << std::setw(9) << drift.frames << "  max drift " << std::setprecision(6) << std::setw(10) << drift.max_drift_ms << " ms"
+			<< std::setprecision(3)
+			<< "  (frame " << std::setw(7) << drift.frame_ms << " ms, ms-rounded sleeps " << std::setw(10) << drift.rounded_drift_ms << " ms)"
+			<< "  resyncs " << drift.resyncs << (passed ? "" : "  FAILED") << std::endl;
+	}
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+#include "Compositor.h"
+
+// Drawing of 1, 2, 4 and 8 simulated monitors into one in-memory surface (like WorkerW):
+//   before - every player draws by itself under one global lock: lock wait and draw time per frame
+//   after  - players publish frames into compositor without locking, it draws all monitors once
+//            per tick: publish time, players' wait for presentation and present cost per tick
+// Players run at frame rate of media, monitors are refreshed at refresh rate.
+//
+// usage: CompositorBench [width] [height] [seconds] [fps] [refresh_rate]
+// e.g.:  CompositorBench 1920 1080 5 30 60
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+// region of the shared surface
+class MemoryMonitor : public FrameTarget {
+public:
+	MemoryMonitor(uint8_t* surface, long surface_stride, long x_offset, long width, long height) :
+		surface(surface), surface_stride(surface_stride), x_offset(x_offset), width(width), height(height)
+	{
+	}
+
+	bool DrawFrame(Frame& frame) override
+	{
+		long row_size = std::min(width, frame.crop_width) * frame.bytes_per_pixel;
+		for (long row = 0; row < height && row < frame.crop_height; ++row) {
+			std::memcpy(surface + surface_stride * row + x_offset * 4,
+				frame.frame_buf + (size_t)frame.linesize * (row + frame.y_offset) + frame.x_offset * frame.bytes_per_pixel, row_size);
+		}
+
+		return true;
+	}
+
+	int GetTargetID() override
+	{
+		return (int)(x_offset / std::max(width, 1L));
+	}
+
+	bool GetResolution(long& target_width, long& target_height) override
+	{
+		target_width = width;
+		target_height = height;
+
+		return true;
+	}
+
+private:
+	uint8_t* surface;
+	long surface_stride;
+	long x_offset, width, height;
+};
+
+struct PlayerStats {
+	long frames = 0;
+	double lock_ms = 0.0, max_lock_ms = 0.0;	// before: waiting for lock, after: publishing
+	double draw_ms = 0.0;						// before: drawing by player
+	double present_wait_ms = 0.0;				// after: waiting until compositor draws frame
+};
+
+static void PrintStats(const char* name, size_t monitors, const std::vector<PlayerStats>& players, double tick_ms, double max_tick_ms)
+{
+	PlayerStats total;
+	for (auto& player : players) {
+		total.frames += player.frames;
+		total.lock_ms += player.lock_ms;
+		total.max_lock_ms = std::max(total.max_lock_ms, player.max_lock_ms);
+		total.draw_ms += player.draw_ms;
+		total.present_wait_ms += player.present_wait_ms;
+	}
+
+	if (total.frames == 0)
+		return;
+
+	std::cout << std::left << std::setw(8) << name << std::setw(10) << monitors << std::fixed << std::setprecision(3)
+		<< std::setw(14) << total.lock_ms / total.frames
+		<< std::setw(14) << total.max_lock_ms
+		<< std::setw(14) << total.draw_ms / total.frames
+		<< std::setw(16) << total.present_wait_ms / total.frames
+		<< std::setw(12) << tick_ms
+		<< max_tick_ms << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	long width = argc > 1 ? std::stol(argv[1]) : 1920;
+	long height = argc > 2 ? std::stol(argv[2]) : 1080;
+	double seconds = argc > 3 ? std::stod(argv[3]) : 5.0;
+	double fps = argc > 4 ? std::stod(argv[4]) : 30.0;
+	double refresh_rate = argc > 5 ? std::stod(argv[5]) : 60.0;
+
+	auto frame_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / fps));
+
+	// every player shows its own frame
+	long stride = width * 4;
+	std::vector<uint8_t> frame_pixels((size_t)stride * height, 0x80);
+
+	Frame frame;
+	frame.frame_buf = frame_pixels.data();
+	frame.original_width = width;
+	frame.original_height = height;
+	frame.linesize = stride;
+	frame.crop_width = width;
+	frame.crop_height = height;
+
+	std::cout << "frame " << width << "x" << height << ", " << fps << " fps, refresh " << refresh_rate << " Hz" << std::endl;
+	std::cout << std::left << std::setw(8) << "mode" << std::setw(10) << "monitors" << std::setw(14) << "lock ms"
+		<< std::setw(14) << "max lock ms" << std::setw(14) << "draw ms" << std::setw(16) << "present wait ms"
+		<< std::setw(12) << "tick ms" << "max tick ms" << std::endl;
+
+	for (size_t monitors_count : { 1, 2, 4, 8 }) {
+		// all monitors are placed side by side on one surface
+		long surface_stride = width * 4 * (long)monitors_count;
+		std::vector<uint8_t> surface((size_t)surface_stride * height);
+
+		std::vector<MemoryMonitor> monitors;
+		for (size_t i = 0; i < monitors_count; ++i)
+			monitors.emplace_back(surface.data(), surface_stride, width * (long)i, width, height);
+
+		for (int use_compositor = 0; use_compositor < 2; ++use_compositor) {
+			std::vector<PlayerStats> stats(monitors_count);
+			std::vector<std::thread> players;
+
+			std::timed_mutex worker_lock;
+			Compositor compositor;
+			for (size_t i = 0; i < monitors_count; ++i)
+				compositor.AddTarget((int)i, &monitors[i]);
+
+			if (use_compositor)
+				compositor.Start(refresh_rate);
+
+			auto start = std::chrono::steady_clock::now();
+			auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+
+			for (size_t i = 0; i < monitors_count; ++i) {
+				players.emplace_back([&, i]() {
+					Frame player_frame = frame;
+					PlayerStats& player_stats = stats[i];
+
+					for (auto deadline = start; deadline < end; deadline += frame_interval) {
+						std::this_thread::sleep_until(deadline);
+
+						auto lock_start = std::chrono::steady_clock::now();
+						if (use_compositor) {
+							uint64_t ticket = compositor.Publish((int)i, player_frame);
+							auto published = std::chrono::steady_clock::now();
+
+							// frame is reused only after it is presented
+							compositor.WaitPresented((int)i, ticket);
+
+							double lock_ms = ms_d(published - lock_start).count();
+							player_stats.lock_ms += lock_ms;
+							player_stats.max_lock_ms = std::max(player_stats.max_lock_ms, lock_ms);
+							player_stats.present_wait_ms += ms_d(std::chrono::steady_clock::now() - published).count();
+						}
+						else {
+							// the old way: lock shared surface and draw
+							std::lock_guard<std::timed_mutex> locker(worker_lock);
+							auto locked = std::chrono::steady_clock::now();
+
+							monitors[i].DrawFrame(player_frame);
+
+							double lock_ms = ms_d(locked - lock_start).count();
+							player_stats.lock_ms += lock_ms;
+							player_stats.max_lock_ms = std::max(player_stats.max_lock_ms, lock_ms);
+							player_stats.draw_ms += ms_d(std::chrono::steady_clock::now() - locked).count();
+						}
+
+						++player_stats.frames;
+					}
+				});
+			}
+
+			for (auto& player : players)
+				player.join();
+
+			compositor.Stop();
+
+			if (use_compositor)
+				PrintStats("after", monitors_count, stats, compositor.GetAverageTickMs(), compositor.GetMaxTickMs());
+			else
+				PrintStats("before", monitors_count, stats, 0.0, 0.0);
+		}
+	}
+
+	return 0;
+}
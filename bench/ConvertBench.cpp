@@ -0,0 +1,299 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+
+extern "C"
+{
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+#include "ColorConverter.h"
+
+// Microbenchmark and correctness check of ColorConverter kernels on synthetic frames.
+// Speed of every source/destination format and SIMD level is measured on a whole frame.
+// Then every matrix (BT.601, BT.709) and range (limited, full) is converted for the whole frame
+// and for a cropped region (planes start inside the frame, odd size), and compared:
+//   - every SIMD level with scalar reference, it must be bit-exact (cropped region with the same
+//     region of the whole frame converted by scalar reference);
+//   - with swscale set up like MediaPack does (SWS_BICUBIC, matrix and range of frame), max difference
+//     must be within sws_tolerance.
+// Fails if any comparison fails.
+//
+// usage: ConvertBench [width] [height] [iterations]
+
+typedef std::chrono::duration<double> sec_d;
+
+// max difference with swscale in levels of 255: both use fixed point matrices rounded differently (1-2 levels),
+// and swscale interpolates chroma instead of taking the nearest sample, chroma of test images changes
+// by one level per sample, so it adds at most another 2 levels
+static const int sws_tolerance = 4;
+
+
+struct TestImage {
+	AVPixelFormat format;
+	std::vector<uint8_t> buffer;
+	uint8_t* data[4] = { nullptr, nullptr, nullptr, nullptr };
+	int linesize[4] = { 0, 0, 0, 0 };
+};
+
+struct TestCase {
+	const char* name;
+	AVColorSpace colorspace;
+	bool full_range;
+};
+
+// converted region of test image, offsets are even like crop offsets of MediaPack
+struct Region {
+	int x, y;
+	int width, height;
+};
+
+// triangle wave going through all 256 levels, one level per sample
+static int GetChromaLevel(int position)
+{
+	int phase = position % 510;
+	return phase < 256 ? phase : 510 - phase;
+}
+
+// random luma and smooth chroma (U changes along rows, V along columns), so interpolation of chroma by swscale
+// hardly changes it, 10 bit samples use only low bits
+static bool MakeImage(TestImage& image, AVPixelFormat format, int width, int height, std::mt19937& rng)
+{
+	image.format = format;
+
+	int size = av_image_get_buffer_size(format, width, height, 64);
+	if (size < 0)
+		return false;
+
+	image.buffer.resize(size);
+	if (av_image_fill_arrays(image.data, image.linesize, image.buffer.data(), format, width, height, 64) < 0)
+		return false;
+
+	bool is_10bit = format == AV_PIX_FMT_YUV420P10LE;
+	int chroma_width = (width + 1) / 2, chroma_height = (height + 1) / 2;
+
+	for (int row = 0; row < height; ++row) {
+		for (int x = 0; x < width; ++x) {
+			if (is_10bit)
+				reinterpret_cast<uint16_t*>(image.data[0] + (size_t)row * image.linesize[0])[x] = (uint16_t)(rng() % 1024);
+			else
+				image.data[0][(size_t)row * image.linesize[0] + x] = (uint8_t)rng();
+		}
+	}
+
+	for (int row = 0; row < chroma_height; ++row) {
+		for (int x = 0; x < chroma_width; ++x) {
+			int u = GetChromaLevel(x), v = GetChromaLevel(row + 128);
+
+			if (format == AV_PIX_FMT_NV12) {
+				image.data[1][(size_t)row * image.linesize[1] + x * 2] = (uint8_t)u;
+				image.data[1][(size_t)row * image.linesize[1] + x * 2 + 1] = (uint8_t)v;
+			}
+			else if (is_10bit) {
+				reinterpret_cast<uint16_t*>(image.data[1] + (size_t)row * image.linesize[1])[x] = (uint16_t)(u << 2);
+				reinterpret_cast<uint16_t*>(image.data[2] + (size_t)row * image.linesize[2])[x] = (uint16_t)(v << 2);
+			}
+			else {
+				image.data[1][(size_t)row * image.linesize[1] + x] = (uint8_t)u;
+				image.data[2][(size_t)row * image.linesize[2] + x] = (uint8_t)v;
+			}
+		}
+	}
+
+	return true;
+}
+
+// planes of image moved to the top left pixel of region
+static void GetRegionPlanes(const TestImage& image, const Region& region, const uint8_t* src_data[4])
+{
+	const AVPixFmtDescriptor* pix_desc = av_pix_fmt_desc_get(image.format);
+	int bytes = image.format == AV_PIX_FMT_YUV420P10LE ? 2 : 1;
+
+	src_data[0] = image.data[0] + (size_t)region.y * image.linesize[0] + (size_t)region.x * bytes;
+	for (int plane = 1; plane < 4; ++plane) {
+		if (!image.data[plane]) {
+			src_data[plane] = nullptr;
+			continue;
+		}
+
+		// semi-planar chroma has both samples in one row
+		int chroma_x = region.x >> pix_desc->log2_chroma_w;
+		int chroma_bytes = image.format == AV_PIX_FMT_NV12 ? 2 : bytes;
+		src_data[plane] = image.data[plane] + (size_t)(region.y >> pix_desc->log2_chroma_h) * image.linesize[plane] + (size_t)chroma_x * chroma_bytes;
+	}
+}
+
+// max difference of region of a and b, where b may be a bigger image starting at b_x, b_y
+static int MaxDifference(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int width, int height, int stride, int bpp,
+	int b_x = 0, int b_y = 0)
+{
+	int max_diff = 0;
+	for (int row = 0; row < height; ++row) {
+		for (int x = 0; x < width * bpp; ++x) {
+			// alpha of BGRA isn't compared
+			if (bpp == 4 && x % 4 == 3)
+				continue;
+
+			int diff = std::abs((int)a[(size_t)row * stride + x] - (int)b[(size_t)(row + b_y) * stride + b_x * bpp + x]);
+			if (diff > max_diff)
+				max_diff = diff;
+		}
+	}
+
+	return max_diff;
+}
+
+// -1 if swscale can't convert
+static int SwsDifference(const TestImage& image, const Region& region, const TestCase& test_case, AVPixelFormat dst_format,
+	const std::vector<uint8_t>& result, int stride, int bpp)
+{
+	SwsContext* sws_ctx = sws_getContext(region.width, region.height, image.format, region.width, region.height, dst_format,
+		SWS_BICUBIC, NULL, NULL, NULL);
+	if (!sws_ctx)
+		return -1;
+
+	sws_setColorspaceDetails(sws_ctx, sws_getCoefficients(test_case.colorspace), test_case.full_range ? 1 : 0,
+		sws_getCoefficients(SWS_CS_DEFAULT), 0, 0, 1 << 16, 1 << 16);
+
+	const uint8_t* src_data[4];
+	GetRegionPlanes(image, region, src_data);
+
+	std::vector<uint8_t> sws_result((size_t)stride * region.height, 0);
+	uint8_t* dst_data[4] = { sws_result.data(), NULL, NULL, NULL };
+	int dst_linesize[4] = { stride, 0, 0, 0 };
+	sws_scale(sws_ctx, src_data, image.linesize, 0, region.height, dst_data, dst_linesize);
+	sws_freeContext(sws_ctx);
+
+	return MaxDifference(result, sws_result, region.width, region.height, stride, bpp);
+}
+
+int main(int argc, char* argv[])
+{
+	int width = argc > 1 ? std::stoi(argv[1]) : 1920;
+	int height = argc > 2 ? std::stoi(argv[2]) : 1080;
+	int iterations = argc > 3 ? std::stoi(argv[3]) : 100;
+	if (width < 16 || height < 16 || iterations <= 0) {
+		std::cout << "usage: " << argv[0] << " [width] [height] [iterations]" << std::endl;
+		return 1;
+	}
+
+	std::mt19937 rng(12345);
+
+	const AVPixelFormat src_formats[] = { AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P10LE };
+	const AVPixelFormat dst_formats[] = { AV_PIX_FMT_BGRA, AV_PIX_FMT_BGR24 };
+
+	const TestCase test_cases[] = {
+		{ "bt601 limited", AVCOL_SPC_BT470BG, false },
+		{ "bt601 full", AVCOL_SPC_BT470BG, true },
+		{ "bt709 limited", AVCOL_SPC_BT709, false },
+		{ "bt709 full", AVCOL_SPC_BT709, true }
+	};
+
+	// whole frame and a region with odd size, so rows end in the middle of SIMD blocks and chroma pairs
+	const Region frame_region = { 0, 0, width, height };
+	const Region crop_region = { 6, 4, width - 13, height - 7 };
+
+	ColorConverter::SimdLevel cpu_level = ColorConverter::GetCpuSimdLevel();
+	std::cout << "CPU: " << ColorConverter::GetSimdLevelName(cpu_level) << ", frame " << width << "x" << height
+		<< ", crop " << crop_region.width << "x" << crop_region.height << "+" << crop_region.x << "+" << crop_region.y << std::endl;
+
+	std::vector<TestImage> images(std::size(src_formats));
+	for (size_t i = 0; i < images.size(); ++i) {
+		if (!MakeImage(images[i], src_formats[i], width, height, rng)) {
+			std::cout << "Can't allocate test image." << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << std::left << std::setw(14) << "source" << std::setw(8) << "dest" << std::setw(10) << "level" << "Mpix/s" << std::endl;
+
+	for (const TestImage& image : images) {
+		for (AVPixelFormat dst_format : dst_formats) {
+			int bpp = dst_format == AV_PIX_FMT_BGRA ? 4 : 3;
+			int stride = (width * bpp + 63) & ~63;
+			std::vector<uint8_t> result((size_t)stride * height, 0);
+
+			for (int level = 0; level <= (int)cpu_level; ++level) {
+				ColorConverter::SimdLevel used_level = ColorConverter::SetSimdLevel((ColorConverter::SimdLevel)level);
+
+				auto start = std::chrono::steady_clock::now();
+				for (int i = 0; i < iterations; ++i) {
+					ColorConverter::Convert(image.data, image.linesize, image.format, false, AVCOL_SPC_BT470BG,
+						result.data(), stride, dst_format, width, height);
+				}
+				sec_d elapsed = std::chrono::steady_clock::now() - start;
+
+				double mpix = (double)width * height * iterations / 1e6 / elapsed.count();
+
+				std::cout << std::left << std::setw(14) << av_get_pix_fmt_name(image.format)
+					<< std::setw(8) << (bpp == 4 ? "bgra" : "bgr24")
+					<< std::setw(10) << ColorConverter::GetSimdLevelName(used_level)
+					<< std::fixed << std::setprecision(1) << mpix << std::endl;
+			}
+		}
+	}
+
+	std::cout << std::endl << std::left << std::setw(14) << "source" << std::setw(8) << "dest" << std::setw(24) << "case"
+		<< std::setw(24) << "exact" << "max diff to swscale (tolerance " << sws_tolerance << ")" << std::endl;
+
+	bool success = true;
+	for (const TestImage& image : images) {
+		for (AVPixelFormat dst_format : dst_formats) {
+			int bpp = dst_format == AV_PIX_FMT_BGRA ? 4 : 3;
+			int stride = (width * bpp + 63) & ~63;
+
+			for (const TestCase& test_case : test_cases) {
+				// whole frame converted by scalar reference
+				std::vector<uint8_t> reference((size_t)stride * height, 0);
+				ColorConverter::SetSimdLevel(ColorConverter::SimdLevel::Scalar);
+				bool converted = ColorConverter::Convert(image.data, image.linesize, image.format, test_case.full_range, test_case.colorspace,
+					reference.data(), stride, dst_format, width, height);
+
+				for (const Region* region : { &frame_region, &crop_region }) {
+					const uint8_t* src_data[4];
+					GetRegionPlanes(image, *region, src_data);
+
+					// levels which differ from scalar reference
+					std::string mismatches;
+					std::vector<uint8_t> result((size_t)stride * region->height, 0);
+
+					for (int level = 0; level <= (int)cpu_level && converted; ++level) {
+						ColorConverter::SimdLevel used_level = ColorConverter::SetSimdLevel((ColorConverter::SimdLevel)level);
+
+						std::fill(result.begin(), result.end(), 0);
+						converted = ColorConverter::Convert(src_data, image.linesize, image.format, test_case.full_range, test_case.colorspace,
+							result.data(), stride, dst_format, region->width, region->height);
+
+						if (converted && MaxDifference(result, reference, region->width, region->height, stride, bpp, region->x, region->y) != 0)
+							mismatches += std::string(mismatches.empty() ? "NO: " : " ") + ColorConverter::GetSimdLevelName(used_level);
+					}
+
+					int sws_diff = converted ? SwsDifference(image, *region, test_case, dst_format, result, stride, bpp) : -1;
+
+					bool passed = converted && mismatches.empty() && sws_diff >= 0 && sws_diff <= sws_tolerance;
+					success = success && passed;
+
+					std::string name = std::string(test_case.name) + (region == &crop_region ? " cropped" : "");
+					std::cout << std::left << std::setw(14) << av_get_pix_fmt_name(image.format)
+						<< std::setw(8) << (bpp == 4 ? "bgra" : "bgr24")
+						<< std::setw(24) << name
+						<< std::setw(24) << (!converted ? "not converted" : (mismatches.empty() ? "yes" : mismatches))
+						<< (sws_diff >= 0 ? std::to_string(sws_diff) : "n/a") << (passed ? "" : "  FAILED") << std::endl;
+				}
+			}
+		}
+	}
+
+	ColorConverter::SetSimdLevel(cpu_level);
+
+	return success ? 0 : 1;
+}
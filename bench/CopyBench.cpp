@@ -0,0 +1,123 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+
+#include "MediaPack.h"
+
+// Headless benchmark of memory traffic on the drawing path:
+//   before - frame is converted into queue buffer and copied row by row into DIB memory
+//   after  - frame is converted directly into DIB memory (zero copy)
+// DIB is simulated by a buffer with DIB row alignment, blit itself isn't measured.
+// Convert and copy stages are reported for BGRA and BGR24 frames.
+//
+// usage: CopyBench <media_file> <width> <height> [frames] [bgra|bgr24|both]
+// e.g.:  CopyBench clip_2160p.mp4 2560 1440 600 both
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+struct BenchResult {
+	long frames = 0;
+	double convert_ms = 0.0, copy_ms = 0.0;
+	double bytes_moved = 0.0;
+};
+
+static void PrintResult(const std::string& name, const BenchResult& result)
+{
+	if (result.frames == 0) {
+		std::cout << name << ": no frames decoded." << std::endl;
+		return;
+	}
+
+	std::cout << std::left << std::setw(10) << name << std::fixed << std::setprecision(2)
+		<< "frames: " << std::setw(8) << result.frames
+		<< "convert: " << std::setw(10) << result.convert_ms / result.frames
+		<< "copy: " << std::setw(10) << result.copy_ms / result.frames
+		<< "MB moved per frame: " << result.bytes_moved / result.frames / (1024.0 * 1024.0) << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 4) {
+		std::cout << "usage: " << argv[0] << " <media_file> <width> <height> [frames] [bgra|bgr24|both]" << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	std::string path = argv[1];
+	long width = std::stol(argv[2]);
+	long height = std::stol(argv[3]);
+	long max_frames = argc > 4 ? std::stol(argv[4]) : 600;
+
+	std::string format_name = argc > 5 ? argv[5] : "both";
+
+	std::vector<FrameFormat> formats;
+	if (format_name != "bgr24")
+		formats.push_back(FrameFormat::BGRA);
+	if (format_name != "bgra")
+		formats.push_back(FrameFormat::BGR24);
+
+	for (FrameFormat format : formats) {
+		int bpp = GetBytesPerPixel(format);
+		std::cout << (format == FrameFormat::BGRA ? "BGRA" : "BGR24") << std::endl;
+
+		// DIB rows are aligned to 4 bytes
+		long dib_stride = (width * bpp + 3) & ~3;
+		std::vector<uint8_t> dib_pixels((size_t)dib_stride * height);
+
+		for (int zero_copy = 0; zero_copy < 2; ++zero_copy) {
+			BenchResult result;
+
+			try {
+				MediaPack media(path);
+				media.SetOutputFormat(format);
+				if (!media.SetScaling(width, height)) {
+					std::cout << "Can't set scaling." << std::endl;
+					return 1;
+				}
+
+				std::vector<uint8_t> queue_buffer(media.GetFrameBufferSize());
+
+				Frame frame;
+				frame.frame_buf = zero_copy ? dib_pixels.data() : queue_buffer.data();
+				frame.linesize = zero_copy ? dib_stride : 0;
+
+				while (result.frames < max_frames) {
+					auto start = std::chrono::steady_clock::now();
+					if (media.DecodeNextFrame(frame))
+						break;
+					auto converted = std::chrono::steady_clock::now();
+
+					// converted frame is written once
+					result.bytes_moved += (double)width * height * bpp;
+
+					if (!zero_copy) {
+						for (long row = 0; row < height; ++row) {
+							std::memcpy(dib_pixels.data() + dib_stride * row, frame.frame_buf + frame.linesize * row, width * bpp);
+						}
+
+						// read from queue buffer and write to DIB
+						result.bytes_moved += (double)width * height * bpp * 2;
+					}
+					auto copied = std::chrono::steady_clock::now();
+
+					result.convert_ms += ms_d(converted - start).count();
+					result.copy_ms += ms_d(copied - converted).count();
+					++result.frames;
+				}
+			}
+			catch (std::exception& exception) {
+				std::cout << path << ": " << exception.what() << std::endl;
+				return 1;
+			}
+
+			PrintResult(zero_copy ? "after" : "before", result);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "MediaPack.h"
+
+// Headless decoding benchmark: decodes whole file for every thread count
+// and prints fps, so it can be run without any monitor.
+//
+// usage: DecodeBench <max_threads> <media_file> [media_file...]
+// e.g.:  DecodeBench 16 h264_1080p.mp4 h264_2160p.mp4 hevc_1080p.mkv hevc_2160p.mkv vp9_1080p.webm vp9_2160p.webm
+
+
+// decode all frames of media file, returns decoded frames count
+static long DecodeAll(MediaPack& media)
+{
+	Frame frame;
+	long frames_count = 0;
+
+	while (media.GetNextFrame(frame) == 0)
+		++frames_count;
+
+	return frames_count;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		std::cout << "usage: " << argv[0] << " <max_threads> <media_file> [media_file...]" << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	int max_threads = std::stoi(argv[1]);
+	if (max_threads <= 0)
+		max_threads = DecodeBudget::GetCoreCount();
+
+	std::vector<int> thread_counts;
+	for (int threads = 1; threads < max_threads; threads *= 2)
+		thread_counts.push_back(threads);
+	thread_counts.push_back(max_threads);
+
+	std::cout << std::left << std::setw(40) << "file" << std::setw(12) << "resolution"
+		<< std::setw(10) << "threads" << std::setw(10) << "frames" << "fps" << std::endl;
+
+	for (int i = 2; i < argc; ++i) {
+		std::string path = argv[i];
+
+		for (int threads : thread_counts) {
+			try {
+				MediaPack media(path, threads);
+
+				// keep original resolution, only conversion to output format
+				if (!media.SetScaling()) {
+					std::cout << path << ": can't set scaling." << std::endl;
+					break;
+				}
+
+				long width = 0, height = 0;
+				media.GetVideoResolution(width, height);
+
+				auto start = std::chrono::steady_clock::now();
+				long frames_count = DecodeAll(media);
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+				double fps = elapsed.count() > 0.0 ? frames_count / elapsed.count() : 0.0;
+
+				std::cout << std::left << std::setw(40) << path
+					<< std::setw(12) << (std::to_string(width) + "x" + std::to_string(height))
+					<< std::setw(10) << media.GetDecodeThreads() << std::setw(10) << frames_count
+					<< std::fixed << std::setprecision(1) << fps << std::endl;
+			}
+			catch (std::exception& exception) {
+				std::cout << path << ": " << exception.what() << std::endl;
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,201 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <ctime>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "MediaPack.h"
+
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+
+// Reads from OS, page faults and CPU time per second of playback for different inputs of a local
+// file: FFmpeg's file protocol with all streams (as before), with other streams than video
+// discarded, read-ahead input and memory mapped input with discarding. Read syscalls, bytes and
+// page faults are counted by OS for the whole process, so they include everything FFmpeg reads
+// (mapped input reads bytes by page faults instead of syscalls). Demuxing is inline to count
+// only what was played, decoded frames are scaled down to keep conversion cheap.
+//
+// usage: InputBench <media_file> [seconds] [block_kb] [blocks]
+// e.g.:  InputBench video.mp4 60 1024 4
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+struct IoCounters {
+	uint64_t read_calls = 0;
+	uint64_t bytes_read = 0;
+
+	// major faults read from disk, on Windows all faults are counted as minor
+	uint64_t minor_faults = 0;
+	uint64_t major_faults = 0;
+};
+
+static IoCounters GetIoCounters()
+{
+	IoCounters counters;
+
+#ifdef _WIN32
+	IO_COUNTERS io;
+	if (GetProcessIoCounters(GetCurrentProcess(), &io)) {
+		counters.read_calls = io.ReadOperationCount;
+		counters.bytes_read = io.ReadTransferCount;
+	}
+
+	PROCESS_MEMORY_COUNTERS memory;
+	memory.cb = sizeof(memory);
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+		counters.minor_faults = memory.PageFaultCount;
+#else
+	// syscr counts read syscalls, rchar bytes returned by them (page cache included)
+	std::ifstream io("/proc/self/io");
+	std::string name;
+	uint64_t value = 0;
+	while (io >> name >> value) {
+		if (name == "syscr:")
+			counters.read_calls = value;
+		else if (name == "rchar:")
+			counters.bytes_read = value;
+	}
+
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		counters.minor_faults = (uint64_t)usage.ru_minflt;
+		counters.major_faults = (uint64_t)usage.ru_majflt;
+	}
+#endif
+
+	return counters;
+}
+
+static double GetCpuMs()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0.0;
+
+	ULARGE_INTEGER kernel_time, user_time;
+	kernel_time.LowPart = kernel.dwLowDateTime;
+	kernel_time.HighPart = kernel.dwHighDateTime;
+	user_time.LowPart = user.dwLowDateTime;
+	user_time.HighPart = user.dwHighDateTime;
+
+	// 100 ns units
+	return (kernel_time.QuadPart + user_time.QuadPart) / 10000.0;
+#else
+	return (double)std::clock() * 1000.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+static bool Run(const std::string& label, const std::string& path, const InputOptions& input_options, double seconds)
+{
+	MediaPack media(path, 0, input_options);
+	media.SetDemuxerThread(false);
+
+	if (!media.SetScaling(320, 180)) {
+		std::cout << "Can't set scaling." << std::endl;
+		return false;
+	}
+
+	std::vector<uint8_t> buffer(media.GetFrameBufferSize());
+
+	Frame frame;
+	frame.frame_buf = buffer.data();
+	media.GetScaledResolution(frame.crop_width, frame.crop_height);
+
+	IoCounters start_io = GetIoCounters();
+	double start_cpu = GetCpuMs();
+	auto start = std::chrono::steady_clock::now();
+
+	double media_seconds = 0.0;
+	size_t frames = 0;
+	while (media_seconds < seconds) {
+		if (media.DecodeNextFrame(frame, true)) {
+			std::cout << "Can't decode frame." << std::endl;
+			return false;
+		}
+
+		media_seconds += frame.duration > 0.0 ? frame.duration : media.GetFrameDuration().count() / 1000.0;
+		++frames;
+	}
+
+	double wall_ms = ms_d(std::chrono::steady_clock::now() - start).count();
+	double cpu_ms = GetCpuMs() - start_cpu;
+	IoCounters end_io = GetIoCounters();
+	InputStats input_stats = media.GetInputStats();
+
+	double read_calls = (double)(end_io.read_calls - start_io.read_calls) / media_seconds;
+	double kb_read = (double)(end_io.bytes_read - start_io.bytes_read) / 1024.0 / media_seconds;
+	double minor_faults = (double)(end_io.minor_faults - start_io.minor_faults) / media_seconds;
+	double major_faults = (double)(end_io.major_faults - start_io.major_faults) / media_seconds;
+
+	std::cout << std::fixed << std::setprecision(1) << std::left << std::setw(24) << label << std::right
+		<< " reads/s " << std::setw(9) << read_calls
+		<< "  KB/s " << std::setw(10) << kb_read
+		<< "  faults/s " << std::setw(8) << minor_faults << " + " << std::setw(6) << major_faults << " major"
+		<< "  CPU ms/s " << std::setw(7) << cpu_ms / media_seconds
+		<< "  wall ms " << std::setw(8) << wall_ms
+		<< "  (" << frames << " frames";
+
+	if (input_stats.read_calls)
+		std::cout << ", input reads or mappings " << input_stats.read_calls << ", seeks " << input_stats.seeks;
+
+	std::cout << ")" << std::endl;
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " <media_file> [seconds] [block_kb] [blocks]" << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	std::string path = argv[1];
+	double seconds = argc > 2 ? std::stod(argv[2]) : 60.0;
+
+	InputOptions read_ahead;
+	if (argc > 3)
+		read_ahead.block_size = std::stoul(argv[3]) * 1024;
+	if (argc > 4)
+		read_ahead.read_ahead_blocks = std::stoul(argv[4]);
+
+	InputOptions mapped = read_ahead;
+	mapped.mode = InputMode::Mapped;
+
+	InputOptions all_streams;
+	all_streams.mode = InputMode::Default;
+	all_streams.discard_other_streams = false;
+
+	InputOptions discard = all_streams;
+	discard.discard_other_streams = true;
+
+	std::cout << "per second of media, " << seconds << " s played" << std::endl;
+
+	try {
+		if (!Run("file, all streams", path, all_streams, seconds) ||
+			!Run("file, video only", path, discard, seconds) ||
+			!Run("read-ahead, video only", path, read_ahead, seconds) ||
+			!Run("mapped, video only", path, mapped, seconds))
+			return 1;
+	}
+	catch (std::exception& exception) {
+		std::cout << path << ": " << exception.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "MediaPack.h"
+
+// Check of gapless looping: media is looped several times and time taken to read
+// the first frame of every loop is compared with frame interval.
+// Exit code is 1 if any loop boundary takes longer than one frame interval.
+//
+// usage: LoopBench <media_file> [loops] [preroll_frames] [width] [height]
+// e.g.:  LoopBench clip_1080p.mp4 10 4 1920 1080
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " <media_file> [loops] [preroll_frames] [width] [height]" << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	std::string path = argv[1];
+	size_t loops = argc > 2 ? std::stoul(argv[2]) : 5;
+	size_t preroll_frames = argc > 3 ? std::stoul(argv[3]) : 4;
+	long width = argc > 5 ? std::stol(argv[4]) : 0;
+	long height = argc > 5 ? std::stol(argv[5]) : 0;
+
+	try {
+		MediaPack media(path);
+		if (!media.SetScaling(width, height)) {
+			std::cout << "Can't set scaling." << std::endl;
+			return 1;
+		}
+
+		media.SetLoopPreroll(preroll_frames);
+
+		std::vector<uint8_t> buffer(media.GetFrameBufferSize());
+
+		Frame frame;
+		frame.frame_buf = buffer.data();
+
+		double frame_interval = media.GetFrameDuration().count();
+		double frames_ms = 0.0;
+		long frames = 0;
+		size_t slow_loops = 0;
+
+		std::cout << "frame interval: " << std::fixed << std::setprecision(2) << frame_interval << " ms, preroll frames: " << preroll_frames << std::endl;
+
+		while (media.GetLoopsCount() < loops) {
+			size_t loops_count = media.GetLoopsCount();
+
+			auto start = std::chrono::steady_clock::now();
+			if (media.DecodeNextFrame(frame, true)) {
+				std::cout << "Can't read frame." << std::endl;
+				return 1;
+			}
+			ms_d elapsed = std::chrono::steady_clock::now() - start;
+
+			if (media.GetLoopsCount() == loops_count) {
+				frames_ms += elapsed.count();
+				++frames;
+				continue;
+			}
+
+			double latency = media.GetLastLoopLatency().count();
+			bool is_slow = latency > frame_interval;
+			if (is_slow)
+				++slow_loops;
+
+			std::cout << "loop " << media.GetLoopsCount() << ": " << latency << " ms" << (is_slow ? " - SLOW" : "") << std::endl;
+		}
+
+		std::cout << "average frame: " << (frames > 0 ? frames_ms / frames : 0.0) << " ms, max loop boundary: "
+			<< media.GetMaxLoopLatency().count() << " ms" << std::endl;
+
+		if (slow_loops > 0) {
+			std::cout << slow_loops << " loop boundaries took longer than frame interval." << std::endl;
+			return 1;
+		}
+	}
+	catch (std::exception& exception) {
+		std::cout << path << ": " << exception.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+
+#include "PlayerMetrics.h"
+#include "Tracer.h"
+
+// Cost of metrics recorded by player for every frame: five histograms, two counters
+// and the clock reads around sleeping, against the frame interval. It must stay below 1%.
+// Cost of a trace scope is measured too, while tracing is stopped and while it is running.
+//
+// usage: MetricsBench [frames] [fps]
+// e.g.:  MetricsBench 1000000 60
+
+typedef std::chrono::duration<double, std::micro> us_d;
+
+
+int main(int argc, char* argv[])
+{
+	long frames = argc > 1 ? std::stol(argv[1]) : 1000000;
+	double fps = argc > 2 ? std::stod(argv[2]) : 60.0;
+	if (frames <= 0 || fps <= 0.0) {
+		std::cout << "usage: " << argv[0] << " [frames] [fps]" << std::endl;
+		return 1;
+	}
+
+	PlayerMetrics metrics;
+
+	// spread of values like real stage timings, so different buckets are touched
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < frames; ++i) {
+		double value_ms = (i % 997) * 0.037;
+
+		metrics.demux.RecordMs(value_ms * 0.1);
+		metrics.decode.RecordMs(value_ms);
+		metrics.convert.RecordMs(value_ms * 0.5);
+
+		auto now = std::chrono::steady_clock::now();
+		metrics.sleep_jitter.Record(std::chrono::steady_clock::now() - now);
+
+		metrics.copy.RecordMs(value_ms * 0.2);
+		++metrics.presented_frames;
+		if (value_ms > 16.7)
+			++metrics.late_frames;
+	}
+	double record_us = us_d(std::chrono::steady_clock::now() - start).count() / frames;
+
+	start = std::chrono::steady_clock::now();
+	MetricsSnapshot snapshot = metrics.GetSnapshot();
+	double snapshot_us = us_d(std::chrono::steady_clock::now() - start).count();
+
+	double frame_us = 1000000.0 / fps;
+
+	// scopes are used directly, so they are measured without DW_TRACING too
+	auto trace_scopes = [frames]() {
+		auto start = std::chrono::steady_clock::now();
+		for (long i = 0; i < frames; ++i) {
+			TraceScope scope("MetricsBench");
+		}
+
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / frames;
+	};
+
+	double stopped_ns = trace_scopes();
+	Tracer::Start();
+	double running_ns = trace_scopes();
+	Tracer::Stop();
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "frames: " << snapshot.presented_frames << ", decode p50 " << snapshot.decode.p50_ms
+		<< " ms, p99 " << snapshot.decode.p99_ms << " ms" << std::endl;
+	std::cout << "record per frame: " << record_us << " us, " << std::setprecision(4)
+		<< record_us / frame_us * 100.0 << "% of " << std::setprecision(1) << fps << " fps frame" << std::endl;
+	std::cout << std::setprecision(3) << "snapshot: " << snapshot_us << " us" << std::endl;
+	std::cout << std::setprecision(1) << "trace scope: " << stopped_ns << " ns stopped, " << running_ns << " ns running" << std::endl;
+
+	return record_us / frame_us < 0.01 ? 0 : 1;
+}
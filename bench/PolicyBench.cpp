@@ -0,0 +1,350 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cmath>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "MediaPack.h"
+#include "MediaClock.h"
+#include "PlaybackPolicy.h"
+
+// CPU time saved by playback policies on a reference clip. The clip is looped in real time
+// for every policy, like player does: frames above frame rate limit are dropped without copying,
+// pause stops decoding. Load of the system is faked, so throttling doesn't depend on the machine:
+//   full  - no policy
+//   cap   - frame rate is limited to max_fps
+//   load  - fake system load is above threshold all the time
+//   pause - paused for the second half of the run
+// Before that decisions of policies are checked on synthetic time and loads: frame rate cap,
+// hysteresis and sample interval of load throttling, frames chosen by FrameLimiter.
+// Fails if a check fails or the cap run presents more frames than max_fps allows.
+//
+// usage: PolicyBench <media_file> [seconds] [width] [height] [max_fps]
+// e.g.:  PolicyBench clip_1080p60.mp4 10 1920 1080 24
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+// load set by caller, counts how many times it was read
+class FakeLoadSource : public LoadSource {
+public:
+	FakeLoadSource(double load) :
+		load(load)
+	{
+	}
+
+	double GetCpuLoad() override
+	{
+		++reads;
+		return load;
+	}
+
+	void SetLoad(double new_load)
+	{
+		load = new_load;
+	}
+
+	size_t GetReads()
+	{
+		return reads;
+	}
+
+private:
+	double load;
+	size_t reads = 0;
+};
+
+static double GetProcessCpuMs()
+{
+#ifdef _WIN32
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+		return 0.0;
+
+	// 100 ns units
+	auto to_ms = [](const FILETIME& time) {
+		return (((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime) / 10000.0;
+	};
+
+	return to_ms(kernel_time) + to_ms(user_time);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.0;
+
+	auto to_ms = [](const struct timeval& time) {
+		return time.tv_sec * 1000.0 + time.tv_usec / 1000.0;
+	};
+
+	return to_ms(usage.ru_utime) + to_ms(usage.ru_stime);
+#endif
+}
+
+static bool Check(bool condition, const char* what)
+{
+	if (!condition)
+		std::cout << "FAILED: " << what << std::endl;
+
+	return condition;
+}
+
+// frames of media_fps presented under max_fps limit during seconds of media
+static long CountPresented(FrameLimiter& frame_limiter, double media_fps, double max_fps, double seconds, double start = 0.0)
+{
+	long presented = 0;
+	double duration = 1.0 / media_fps;
+
+	for (long i = 0; i < std::lround(seconds * media_fps); ++i) {
+		if (frame_limiter.ShouldPresent(start + i * duration, duration, max_fps))
+			++presented;
+	}
+
+	return presented;
+}
+
+// decisions of policies on synthetic time, they don't depend on the machine
+static bool CheckPolicies()
+{
+	bool success = true;
+	PlaybackPolicy::time_point now = std::chrono::steady_clock::time_point() + std::chrono::hours(1);
+
+	FpsCapPolicy fps_cap(24.0);
+	success = Check(fps_cap.Decide(60.0, now).max_fps == 24.0, "cap limits faster media") && success;
+	success = Check(fps_cap.Decide(23.976, now).max_fps == 0.0, "cap doesn't limit slower media") && success;
+	success = Check(fps_cap.Decide(0.0, now).max_fps == 24.0, "cap limits media of unknown frame rate") && success;
+
+	// threshold 0.85, release 0.65, load is read once per second
+	std::shared_ptr<FakeLoadSource> load_source = std::make_shared<FakeLoadSource>(0.5);
+	LoadThrottlePolicy load_throttle(load_source, 0.85, 0.65, std::chrono::seconds(1));
+
+	struct LoadStep {
+		double load;
+		bool throttled;
+		const char* what;
+	};
+
+	const LoadStep load_steps[] = {
+		{ 0.50, false, "load below threshold isn't throttled" },
+		{ 0.90, true, "load above threshold is throttled" },
+		{ 0.75, true, "load between release and threshold stays throttled" },
+		{ -1.0, true, "unknown load keeps throttling" },
+		{ 0.60, false, "load below release isn't throttled" },
+		{ 0.75, false, "load between release and threshold stays released" },
+		{ 0.86, true, "load above threshold is throttled again" }
+	};
+
+	for (const LoadStep& step : load_steps) {
+		load_source->SetLoad(step.load);
+		size_t reads = load_source->GetReads();
+
+		PlaybackDecision decision = load_throttle.Decide(60.0, now);
+		bool throttled = decision.max_fps == 30.0 && decision.reduce_decoding;
+		bool released = decision.max_fps == 0.0 && !decision.reduce_decoding;
+
+		success = Check(load_source->GetReads() == reads + 1, "load is read when sample interval has passed") && success;
+		success = Check(step.throttled ? throttled : released, step.what) && success;
+		success = Check(load_throttle.IsThrottled() == step.throttled, step.what) && success;
+
+		// load changes within the interval are ignored
+		load_source->SetLoad(step.throttled ? 0.0 : 1.0);
+		reads = load_source->GetReads();
+		decision = load_throttle.Decide(60.0, now + std::chrono::milliseconds(999));
+
+		success = Check(load_source->GetReads() == reads, "load isn't read within sample interval") && success;
+		success = Check(load_throttle.IsThrottled() == step.throttled, "decision doesn't change within sample interval") && success;
+
+		now += std::chrono::seconds(1);
+	}
+
+	PausePolicy pause;
+	pause.SetPaused(true);
+	success = Check(pause.Decide(60.0, now).pause, "paused policy pauses") && success;
+	pause.SetPaused(false);
+	success = Check(!pause.Decide(60.0, now).pause, "resumed policy doesn't pause") && success;
+
+	CombinedPolicy combined;
+	combined.AddPolicy(std::make_shared<FpsCapPolicy>(24.0));
+	combined.AddPolicy(std::make_shared<FpsCapPolicy>(30.0));
+	success = Check(combined.Decide(60.0, now).max_fps == 24.0, "combined policy takes the lowest frame rate") && success;
+
+	// frames are chosen evenly by timestamps, rounding errors don't accumulate
+	FrameLimiter frame_limiter;
+	success = Check(CountPresented(frame_limiter, 60.0, 0.0, 10.0) == 600, "no limit presents every frame") && success;
+
+	frame_limiter.Reset();
+	success = Check(CountPresented(frame_limiter, 60.0, 30.0, 10.0) == 300, "60 fps at 30 fps limit presents every second frame") && success;
+
+	frame_limiter.Reset();
+	long presented = CountPresented(frame_limiter, 60.0, 24.0, 10.0);
+	success = Check(std::abs(presented - 240) <= 1, "60 fps at 24 fps limit presents 24 frames per second") && success;
+
+	frame_limiter.Reset();
+	success = Check(CountPresented(frame_limiter, 23.976, 30.0, 10.0) == std::lround(10.0 * 23.976),
+		"media slower than limit presents every frame") && success;
+
+	// after seek back the first frame is presented at once
+	frame_limiter.Reset();
+	CountPresented(frame_limiter, 60.0, 24.0, 1.0, 5.0);
+	success = Check(frame_limiter.ShouldPresent(1.0, 1.0 / 60.0, 24.0), "frame after seek back is presented") && success;
+
+	return success;
+}
+
+struct PolicyResult {
+	double cpu_ms = 0.0;
+	long presented = 0;
+	long throttled = 0;
+};
+
+static bool Play(const std::string& path, long width, long height, double seconds,
+	std::shared_ptr<PlaybackPolicy> policy, PausePolicy* pause_policy, PolicyResult& result)
+{
+	MediaPack media(path);
+	if (!media.SetScaling(width, height)) {
+		std::cout << "Can't set scaling." << std::endl;
+		return false;
+	}
+
+	std::vector<uint8_t> buffer(media.GetFrameBufferSize());
+	std::vector<uint8_t> surface(media.GetFrameBufferSize());
+
+	Frame frame;
+	frame.frame_buf = buffer.data();
+
+	MediaClock media_clock;
+	FrameLimiter frame_limiter;
+
+	float frame_ms = media.GetFrameDuration().count();
+	double media_fps = frame_ms > 0.0f ? 1000.0 / frame_ms : 0.0;
+
+	double start_cpu = GetProcessCpuMs();
+	auto start = std::chrono::steady_clock::now();
+	auto half = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds / 2.0));
+	auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+
+	while (true) {
+		auto now = std::chrono::steady_clock::now();
+		if (now >= end)
+			break;
+
+		if (pause_policy)
+			pause_policy->SetPaused(now >= half);
+
+		PlaybackDecision decision;
+		if (policy)
+			decision = policy->Decide(media_fps, now);
+
+		if (decision.pause) {
+			media_clock.Reset();
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+
+		media.SetReducedDecoding(decision.reduce_decoding);
+
+		if (media.DecodeNextFrame(frame, true)) {
+			std::cout << "Can't read frame." << std::endl;
+			return false;
+		}
+
+		if (!frame_limiter.ShouldPresent(frame.timestamp, frame.duration, decision.max_fps)) {
+			++result.throttled;
+			continue;
+		}
+
+		now = std::chrono::steady_clock::now();
+		if (!media_clock.IsStarted())
+			media_clock.Start(frame.timestamp, now);
+
+		media_clock.CorrectDrift(frame.timestamp, now);
+		std::this_thread::sleep_until(media_clock.GetDeadline(frame.timestamp));
+
+		// monitor copies presented frame into its DIB
+		std::memcpy(surface.data(), buffer.data(), buffer.size());
+		++result.presented;
+	}
+
+	result.cpu_ms = GetProcessCpuMs() - start_cpu;
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " <media_file> [seconds] [width] [height] [max_fps]" << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	std::string path = argv[1];
+	double seconds = argc > 2 ? std::stod(argv[2]) : 10.0;
+	long width = argc > 4 ? std::stol(argv[3]) : 0;
+	long height = argc > 4 ? std::stol(argv[4]) : 0;
+	double max_fps = argc > 5 ? std::stod(argv[5]) : 24.0;
+
+	std::shared_ptr<PausePolicy> pause_policy = std::make_shared<PausePolicy>();
+
+	struct Run {
+		const char* name;
+		std::shared_ptr<PlaybackPolicy> policy;
+		PausePolicy* pause_policy;
+	};
+
+	std::vector<Run> runs = {
+		{ "full", nullptr, nullptr },
+		{ "cap", std::make_shared<FpsCapPolicy>(max_fps), nullptr },
+		{ "load", std::make_shared<LoadThrottlePolicy>(std::make_shared<FakeLoadSource>(1.0)), nullptr },
+		{ "pause", pause_policy, pause_policy.get() }
+	};
+
+	if (!CheckPolicies())
+		return 1;
+
+	std::cout << "Policy checks passed." << std::endl;
+	std::cout << seconds << " s per policy, max fps " << max_fps << std::endl;
+	std::cout << std::left << std::setw(8) << "policy" << std::setw(14) << "cpu ms/s" << std::setw(14) << "presented fps"
+		<< std::setw(12) << "throttled" << "cpu saved %" << std::endl;
+
+	double full_cpu_ms = 0.0;
+	bool success = true;
+
+	try {
+		for (auto& run : runs) {
+			PolicyResult result;
+			if (!Play(path, width, height, seconds, run.policy, run.pause_policy, result))
+				return 1;
+
+			if (run.policy == nullptr)
+				full_cpu_ms = result.cpu_ms;
+
+			double saved = full_cpu_ms > 0.0 ? (1.0 - result.cpu_ms / full_cpu_ms) * 100.0 : 0.0;
+
+			std::cout << std::left << std::setw(8) << run.name << std::fixed << std::setprecision(1)
+				<< std::setw(14) << result.cpu_ms / seconds
+				<< std::setw(14) << result.presented / seconds
+				<< std::setw(12) << result.throttled
+				<< saved << std::endl;
+
+			// 5% and the first and the last frame for rounding of frame timestamps
+			if (std::strcmp(run.name, "cap") == 0 && max_fps > 0.0)
+				success = Check(result.presented <= max_fps * seconds * 1.05 + 2.0, "cap run presents no more than max_fps") && success;
+		}
+	}
+	catch (std::exception& exception) {
+		std::cout << path << ": " << exception.what() << std::endl;
+		return 1;
+	}
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,257 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "MediaPlayer.h"
+#include "Compositor.h"
+#include "PosterCache.h"
+
+// Time to first pixel of a starting wallpaper, from opening media till something is drawn on monitor,
+// and till the first decoded frame is drawn:
+//   cold - media has no poster, monitor is blank until the first frame is decoded (poster is stored)
+//   warm - poster is drawn by player thread at once, decoded frames take over
+// Also how much the poster differs from the first decoded frame (JPEG is lossy), in levels of 255.
+// Probe cache is warmed by an uncounted start, so both cases open media the same way.
+//
+// usage: PosterBench <media_file> [starts] [width] [height]
+// e.g.:  PosterBench hevc_2160p.mp4 10 3840 2160
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+// copies frames like monitor does, keeps the first two of every start
+class StartSink : public FrameTarget {
+public:
+	StartSink(long width, long height) :
+		width(width), height(height)
+	{
+	}
+
+	bool DrawFrame(Frame& frame) override
+	{
+		long row_size = frame.crop_width * frame.bytes_per_pixel;
+		std::vector<uint8_t> pixels((size_t)row_size * frame.crop_height);
+
+		const uint8_t* src = frame.frame_buf + (size_t)frame.linesize * frame.y_offset + (size_t)frame.x_offset * frame.bytes_per_pixel;
+		for (long row = 0; row < frame.crop_height; ++row)
+			std::memcpy(pixels.data() + (size_t)row_size * row, src + (size_t)frame.linesize * row, row_size);
+
+		std::lock_guard<std::mutex> lock(draws_lock);
+		if (draws.empty())
+			first_draw = std::chrono::steady_clock::now();
+		if (draws.size() < 2)
+			draws.push_back(std::move(pixels));
+
+		bytes_per_pixel = frame.bytes_per_pixel;
+		++frames_count;
+
+		return true;
+	}
+
+	int GetTargetID() override
+	{
+		return 0;
+	}
+
+	bool GetResolution(long& sink_width, long& sink_height) override
+	{
+		sink_width = width;
+		sink_height = height;
+
+		return true;
+	}
+
+	void Reset()
+	{
+		std::lock_guard<std::mutex> lock(draws_lock);
+		draws.clear();
+		frames_count = 0;
+	}
+
+	size_t GetFramesCount()
+	{
+		return frames_count;
+	}
+
+	std::chrono::steady_clock::time_point GetFirstDraw()
+	{
+		std::lock_guard<std::mutex> lock(draws_lock);
+		return first_draw;
+	}
+
+	// mean difference of color channels of the first two draws, negative if there weren't two
+	double GetFirstDrawsDifference()
+	{
+		std::lock_guard<std::mutex> lock(draws_lock);
+		if (draws.size() < 2 || draws[0].size() != draws[1].size() || draws[0].empty())
+			return -1.0;
+
+		uint64_t sum = 0, count = 0;
+		for (size_t i = 0; i < draws[0].size(); ++i) {
+			// alpha of BGRA isn't shown
+			if (bytes_per_pixel == 4 && i % 4 == 3)
+				continue;
+
+			sum += std::abs((int)draws[0][i] - (int)draws[1][i]);
+			++count;
+		}
+
+		return (double)sum / count;
+	}
+
+private:
+	long width, height;
+	std::mutex draws_lock;
+	std::vector<std::vector<uint8_t>> draws;
+	std::chrono::steady_clock::time_point first_draw;
+	int bytes_per_pixel = 4;
+	std::atomic<size_t> frames_count{ 0 };
+};
+
+struct Result {
+	std::vector<double> start_ms;
+	std::vector<double> first_pixel_ms;
+	std::vector<double> first_frame_ms;
+	size_t posters_shown = 0;
+	double max_difference = 0.0;
+};
+
+static void PrintResult(const char* name, Result& result)
+{
+	auto print = [](const char* label, std::vector<double>& values) {
+		if (values.empty())
+			return;
+
+		std::sort(values.begin(), values.end());
+
+		double sum = 0.0;
+		for (double value : values)
+			sum += value;
+
+		std::cout << "   " << std::left << std::setw(20) << label << std::right << std::fixed << std::setprecision(2)
+			<< " mean " << std::setw(8) << sum / values.size() << "  p50 " << std::setw(8) << values[values.size() / 2]
+			<< "  max " << std::setw(8) << values.back() << std::endl;
+	};
+
+	std::cout << name << " (" << result.first_pixel_ms.size() << " starts), ms:" << std::endl;
+	print("caller blocked", result.start_ms);
+	print("first pixel", result.first_pixel_ms);
+	print("first decoded frame", result.first_frame_ms);
+	std::cout << "   poster shown by " << result.posters_shown << " starts, max difference from the first frame "
+		<< std::fixed << std::setprecision(2) << result.max_difference << " of 255" << std::endl;
+}
+
+// opens media and starts a new player, measures till its first decoded frame is drawn
+static bool RunStart(const std::string& path, StartSink& sink, Compositor& compositor, Result* result)
+{
+	sink.Reset();
+
+	MediaPlayer player(sink, compositor);
+	player.SetPoster(true);
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (!player.SetMedia(std::make_unique<MediaPack>(path)) || !player.SetScaling(MediaPlayer::ScalingMode::Scale) ||
+		!player.StartPlayer(true))
+		return false;
+
+	double start_ms = ms_d(std::chrono::steady_clock::now() - start).count();
+
+	auto deadline = start + std::chrono::seconds(30);
+	while (player.GetMetrics().presented_frames == 0) {
+		if (std::chrono::steady_clock::now() > deadline || !player.IsPlaying())
+			return false;
+
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+
+	double first_frame_ms = ms_d(std::chrono::steady_clock::now() - start).count();
+
+	// poster and the first decoded frame were drawn
+	bool poster_shown = sink.GetFramesCount() >= 2;
+
+	if (result) {
+		result->start_ms.push_back(start_ms);
+		result->first_pixel_ms.push_back(ms_d(sink.GetFirstDraw() - start).count());
+		result->first_frame_ms.push_back(first_frame_ms);
+
+		if (poster_shown) {
+			++result->posters_shown;
+			result->max_difference = std::max(result->max_difference, sink.GetFirstDrawsDifference());
+		}
+	}
+
+	// poster taken from the first frame is written when player is destroyed
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " <media_file> [starts] [width] [height]" << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	std::string path = argv[1];
+	size_t starts = argc > 2 ? std::stoul(argv[2]) : 10;
+	long width = argc > 4 ? std::stol(argv[3]) : 1920;
+	long height = argc > 4 ? std::stol(argv[4]) : 1080;
+
+	StartSink sink(width, height);
+
+	Compositor compositor;
+	compositor.AddTarget(sink.GetTargetID(), &sink);
+	if (!compositor.Start(60.0)) {
+		std::cout << "Can't start compositor." << std::endl;
+		return 1;
+	}
+
+	Result cold, warm;
+	bool success = true;
+
+	try {
+		// probe cache entry and pages of the file
+		success = RunStart(path, sink, compositor, nullptr);
+
+		for (size_t i = 0; i < starts && success; ++i) {
+			PosterCache::Remove(path);
+			success = RunStart(path, sink, compositor, &cold);
+		}
+
+		for (size_t i = 0; i < starts && success; ++i)
+			success = RunStart(path, sink, compositor, &warm);
+	}
+	catch (std::exception& exception) {
+		std::cout << path << ": " << exception.what() << std::endl;
+		success = false;
+	}
+
+	compositor.Stop();
+
+	if (!success) {
+		std::cout << "Can't play media." << std::endl;
+		return 1;
+	}
+
+	std::cout << path << " at " << width << "x" << height << std::endl;
+	PrintResult("cold", cold);
+	PrintResult("warm", warm);
+
+	if (warm.posters_shown == 0) {
+		std::cout << "Poster wasn't shown, poster cache: " << PosterCache::GetDirectory() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
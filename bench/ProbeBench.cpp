@@ -0,0 +1,146 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+
+#include "MediaPack.h"
+#include "ProbeCache.h"
+
+// Open latency of media files with an empty probe cache (cold: container is probed by
+// avformat_find_stream_info) and with its entry (warm: only the header is read), and time
+// till the first frame is decoded. Bytes read by our input while media is opened show how
+// much of the file probing reads. Both opens must decode the same first frame.
+// OS file cache is warm in both cases after the first open, so only probing differs.
+//
+// usage: ProbeBench <opens> <media_file> [media_file...]
+// e.g.:  ProbeBench 10 h264_2160p.mp4 hevc_2160p.mkv vp9_2160p.webm
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+struct OpenResult {
+	double open_ms = 0.0;
+	double first_frame_ms = 0.0;
+	uint64_t bytes_read = 0;
+	bool probe_cached = false;
+	size_t frame_hash = 0;
+};
+
+// open media, set scaling and decode the first frame
+static bool OpenMedia(const std::string& path, OpenResult& result)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	MediaPack media(path);
+
+	auto opened = std::chrono::steady_clock::now();
+	result.open_ms = ms_d(opened - start).count();
+	result.bytes_read = media.GetInputStats().bytes_read;
+	result.probe_cached = media.IsProbeCached();
+
+	if (!media.SetScaling())
+		return false;
+
+	Frame frame;
+	if (media.GetNextFrame(frame) != 0)
+		return false;
+
+	result.first_frame_ms = ms_d(std::chrono::steady_clock::now() - start).count();
+
+	std::string pixels((const char*)frame.frame_buf, (size_t)frame.linesize * frame.original_height);
+	result.frame_hash = std::hash<std::string>()(pixels);
+
+	return true;
+}
+
+static void PrintResults(const char* name, std::vector<OpenResult>& results)
+{
+	auto print = [](const char* label, std::vector<double> values) {
+		std::sort(values.begin(), values.end());
+
+		double sum = 0.0;
+		for (double value : values)
+			sum += value;
+
+		std::cout << "   " << std::left << std::setw(22) << label << std::right << std::fixed << std::setprecision(2)
+			<< " mean " << std::setw(8) << sum / values.size() << "  p50 " << std::setw(8) << values[values.size() / 2]
+			<< "  max " << std::setw(8) << values.back() << std::endl;
+	};
+
+	std::vector<double> open_ms, first_frame_ms;
+	uint64_t bytes_read = 0;
+	for (OpenResult& result : results) {
+		open_ms.push_back(result.open_ms);
+		first_frame_ms.push_back(result.first_frame_ms);
+		bytes_read += result.bytes_read;
+	}
+
+	std::cout << " " << name << " (" << results.size() << " opens), ms:" << std::endl;
+	print("open", open_ms);
+	print("open till first frame", first_frame_ms);
+	std::cout << "   KB read while opening " << std::fixed << std::setprecision(1) << bytes_read / 1024.0 / results.size() << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		std::cout << "usage: " << argv[0] << " <opens> <media_file> [media_file...]" << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	int opens = std::max(1, std::stoi(argv[1]));
+
+	// entries of the benchmark don't mix with the user's cache
+	ProbeCache::SetDirectory("probe_bench_cache");
+
+	bool success = true;
+
+	for (int i = 2; i < argc; ++i) {
+		std::string path = argv[i];
+
+		std::vector<OpenResult> cold, warm;
+
+		try {
+			for (int open = 0; open < opens && success; ++open) {
+				ProbeCache::Remove(path);
+
+				OpenResult cold_result, warm_result;
+				success = OpenMedia(path, cold_result) && OpenMedia(path, warm_result);
+
+				// warm open must use the entry stored by cold open and decode the same frame
+				if (success && (cold_result.probe_cached || !warm_result.probe_cached)) {
+					std::cout << path << ": media isn't opened from probe cache." << std::endl;
+					success = false;
+				}
+
+				if (success && cold_result.frame_hash != warm_result.frame_hash) {
+					std::cout << path << ": first frame differs with probe cache." << std::endl;
+					success = false;
+				}
+
+				cold.push_back(cold_result);
+				warm.push_back(warm_result);
+			}
+		}
+		catch (std::exception& exception) {
+			std::cout << path << ": " << exception.what() << std::endl;
+			success = false;
+		}
+
+		ProbeCache::Remove(path);
+
+		if (!success)
+			break;
+
+		std::cout << path << std::endl;
+		PrintResults("cold", cold);
+		PrintResults("warm", warm);
+	}
+
+	return success ? 0 : 1;
+}
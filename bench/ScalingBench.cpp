@@ -0,0 +1,159 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <memory>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "MediaPack.h"
+#include "FrameQueue.h"
+#include "FramePool.h"
+
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+
+// Memory and time of changing scaling at runtime. Scaling is switched between scale, crop
+// and fill modes, after every switch frame queue is recreated from the pool like player does
+// on restart and a frame is decoded. Resident memory must stay flat: fails if it grows by more
+// than 4 MB after the first round of modes.
+//
+// usage: ScalingBench <media_file|lavfi:graph> [flips] [width] [height]
+// e.g.:  ScalingBench lavfi:testsrc2=size=1920x1080:rate=30 10000 1280 720
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+static size_t GetResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	counters.cb = sizeof(counters);
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return counters.WorkingSetSize;
+#else
+	// second field is resident pages
+	std::ifstream statm("/proc/self/statm");
+	size_t total_pages = 0, resident_pages = 0;
+	if (!(statm >> total_pages >> resident_pages))
+		return 0;
+
+	return resident_pages * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// the same regions MediaPlayer chooses for scale, crop and fill modes
+static bool ApplyMode(MediaPack& media, int mode, long width, long height, long media_width, long media_height)
+{
+	if (mode == 0)
+		return media.SetScaling(width, height);
+
+	if (mode == 1) {
+		long visible_width = std::min(width, media_width);
+		long visible_height = std::min(height, media_height);
+
+		return media.SetScaling(visible_width, visible_height, (media_width - visible_width) / 2,
+			(media_height - visible_height) / 2, visible_width, visible_height);
+	}
+
+	long fill_width = media_width, fill_height = media_height;
+	if (media_width * height > width * media_height)
+		fill_width = media_height * width / height;
+	else
+		fill_height = media_width * height / width;
+
+	return media.SetScaling(width, height, (media_width - fill_width) / 2, (media_height - fill_height) / 2, fill_width, fill_height);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " <media_file|lavfi:graph> [flips] [width] [height]" << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	std::string path = argv[1];
+	long flips = argc > 2 ? std::stol(argv[2]) : 10000;
+	long width = argc > 4 ? std::stol(argv[3]) : 1280;
+	long height = argc > 4 ? std::stol(argv[4]) : 720;
+
+	const long modes_count = 3;
+	const size_t queue_depth = 3;
+
+	try {
+		MediaPack media(path);
+
+		long media_width = 0, media_height = 0;
+		media.GetVideoResolution(media_width, media_height);
+
+		FramePool queue_pool;
+		size_t start_resident = 0;
+		double total_ms = 0.0, max_ms = 0.0;
+
+		for (long i = 0; i < flips; ++i) {
+			auto start = std::chrono::steady_clock::now();
+
+			if (!ApplyMode(media, i % modes_count, width, height, media_width, media_height)) {
+				std::cout << "Can't set scaling." << std::endl;
+				return 1;
+			}
+
+			Frame frame;
+			media.GetScaledResolution(frame.crop_width, frame.crop_height);
+
+			if (!queue_pool.SetBufferSize(media.GetFrameBufferSize())) {
+				std::cout << "Can't allocate frame queue." << std::endl;
+				return 1;
+			}
+
+			double flip_ms = ms_d(std::chrono::steady_clock::now() - start).count();
+			total_ms += flip_ms;
+			max_ms = std::max(max_ms, flip_ms);
+
+			FrameQueue queue(queue_depth, queue_pool, frame);
+
+			Frame* free_frame = queue.BeginWrite();
+			if (media.DecodeNextFrame(*free_frame, true)) {
+				std::cout << "Can't decode frame." << std::endl;
+				return 1;
+			}
+			queue.EndWrite();
+
+			// buffers of every mode exist after the first round
+			if (i == modes_count - 1)
+				start_resident = GetResidentBytes();
+		}
+
+		size_t end_resident = GetResidentBytes();
+		double growth_mb = ((double)end_resident - (double)start_resident) / (1024.0 * 1024.0);
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< flips << " flips, scaling change mean " << total_ms / flips << " ms, max " << max_ms << " ms" << std::endl
+			<< std::setprecision(1) << "resident MB after first round: " << start_resident / (1024.0 * 1024.0)
+			<< ", at the end: " << end_resident / (1024.0 * 1024.0) << ", growth: " << growth_mb << std::endl
+			<< "queue buffers allocated: " << queue_pool.GetAllocatedCount() << std::endl;
+
+		if (growth_mb > 4.0) {
+			std::cout << "Memory isn't flat." << std::endl;
+			return 1;
+		}
+	}
+	catch (std::exception& exception) {
+		std::cout << path << ": " << exception.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,197 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <cmath>
+
+#include "MediaPack.h"
+
+// Latency of seeking to random positions from the call till the frame at position is converted,
+// with keyframes known only to the demuxer (container's index or its own search) and with the
+// complete index of MediaPack::ScanKeyframes. Long-GOP media shows how many frames are decoded
+// only as references. Every frame after seek must be the frame shown at position, with the same
+// pixels as in sequential playback (no artifacts of missing references), and its timestamp
+// must continue after the previous frame.
+//
+// usage: SeekBench <media_file> [seeks] [width] [height]
+// e.g.:  SeekBench hevc_2160p_gop250.mp4 50 1280 720
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+struct FrameInfo {
+	double position;
+	double duration;
+	size_t hash;
+};
+
+static size_t HashFrame(const Frame& frame)
+{
+	std::string pixels;
+	size_t row_size = (size_t)frame.original_width * frame.bytes_per_pixel;
+	for (long row = 0; row < frame.original_height; ++row)
+		pixels.append((const char*)frame.frame_buf + (size_t)frame.linesize * row, row_size);
+
+	return std::hash<std::string>()(pixels);
+}
+
+// frame shown at position in sequential playback
+static const FrameInfo* FindFrame(const std::vector<FrameInfo>& frames, double position)
+{
+	auto it = std::upper_bound(frames.begin(), frames.end(), position,
+		[](double value, const FrameInfo& info) { return value < info.position; });
+
+	return it == frames.begin() ? nullptr : &*(it - 1);
+}
+
+static void PrintLatency(const char* label, std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+
+	double sum = 0.0;
+	for (double value : values)
+		sum += value;
+
+	std::cout << "   " << std::left << std::setw(24) << label << std::right << std::fixed << std::setprecision(2)
+		<< " mean " << std::setw(8) << sum / values.size() << "  p50 " << std::setw(8) << values[values.size() / 2]
+		<< "  p95 " << std::setw(8) << values[values.size() * 95 / 100] << "  max " << std::setw(8) << values.back() << std::endl;
+}
+
+// seek to every position and check the first frame after it, false if any frame is wrong
+static bool RunSeeks(MediaPack& media, const std::vector<double>& positions, const std::vector<FrameInfo>& frames,
+	std::vector<double>& latencies)
+{
+	Frame frame;
+	if (media.GetNextFrame(frame) != 0)
+		return false;
+
+	double next_timestamp = frame.timestamp + frame.duration;
+
+	for (double position : positions) {
+		auto start = std::chrono::steady_clock::now();
+
+		if (media.Seek(position) != 0 || media.GetNextFrame(frame) != 0) {
+			std::cout << "Can't seek to " << position << " s." << std::endl;
+			return false;
+		}
+
+		latencies.push_back(ms_d(std::chrono::steady_clock::now() - start).count());
+
+		const FrameInfo* expected = FindFrame(frames, position);
+		if (!expected || std::abs(frame.position - expected->position) > 1e-6) {
+			std::cout << "Seek to " << position << " s returned frame at " << frame.position << " s." << std::endl;
+			return false;
+		}
+
+		if (HashFrame(frame) != expected->hash) {
+			std::cout << "Frame at " << position << " s differs from sequential playback." << std::endl;
+			return false;
+		}
+
+		if (std::abs(frame.timestamp - next_timestamp) > 1e-6) {
+			std::cout << "Timestamp after seek to " << position << " s doesn't continue." << std::endl;
+			return false;
+		}
+
+		next_timestamp = frame.timestamp + frame.duration;
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " <media_file> [seeks] [width] [height]" << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	std::string path = argv[1];
+	int seeks = argc > 2 ? std::max(1, std::stoi(argv[2])) : 50;
+	long width = argc > 3 ? std::stol(argv[3]) : 1280;
+	long height = argc > 4 ? std::stol(argv[4]) : 720;
+
+	// index stored by earlier runs isn't used, so the first case has only what the container has
+	InputOptions input_options;
+	input_options.use_probe_cache = false;
+
+	try {
+		// pixels of every frame in sequential playback
+		std::vector<FrameInfo> frames;
+		{
+			MediaPack media(path, 0, input_options);
+			if (!media.SetScaling(width, height)) {
+				std::cout << "Can't set scaling." << std::endl;
+				return 1;
+			}
+
+			Frame frame;
+			while (media.GetNextFrame(frame) == 0)
+				frames.push_back({ frame.position, frame.duration, HashFrame(frame) });
+		}
+
+		if (frames.empty()) {
+			std::cout << "Media has no frames." << std::endl;
+			return 1;
+		}
+
+		double media_seconds = frames.back().position + frames.back().duration;
+
+		// the same random positions for both cases
+		std::mt19937 generator(1);
+		std::uniform_real_distribution<double> distribution(0.0, media_seconds);
+		std::vector<double> positions;
+		for (int i = 0; i < seeks; ++i)
+			positions.push_back(distribution(generator));
+
+		std::cout << path << ": " << frames.size() << " frames, " << std::fixed << std::setprecision(2)
+			<< media_seconds << " s, " << seeks << " seeks" << std::endl;
+
+		std::vector<double> demuxer_latencies, indexed_latencies;
+		{
+			MediaPack media(path, 0, input_options);
+			if (!media.SetScaling(width, height))
+				return 1;
+
+			std::cout << "   keyframes before scan    " << media.GetKeyframesCount() << std::endl;
+
+			if (!RunSeeks(media, positions, frames, demuxer_latencies))
+				return 1;
+		}
+		{
+			MediaPack media(path, 0, input_options);
+			if (!media.SetScaling(width, height))
+				return 1;
+
+			auto start = std::chrono::steady_clock::now();
+			if (!media.ScanKeyframes()) {
+				std::cout << "Can't scan keyframes." << std::endl;
+				return 1;
+			}
+			double scan_ms = ms_d(std::chrono::steady_clock::now() - start).count();
+
+			std::cout << "   keyframes of scan        " << media.GetKeyframesCount() << " in " << std::setprecision(2) << scan_ms
+				<< " ms, average GOP " << std::setprecision(1) << (double)frames.size() / std::max<size_t>(1, media.GetKeyframesCount())
+				<< " frames" << std::endl;
+
+			if (!RunSeeks(media, positions, frames, indexed_latencies))
+				return 1;
+		}
+
+		std::cout << " seek till converted frame, ms:" << std::endl;
+		PrintLatency("demuxer", demuxer_latencies);
+		PrintLatency("keyframe index", indexed_latencies);
+	}
+	catch (std::exception& exception) {
+		std::cout << path << ": " << exception.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,235 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "MediaPlayer.h"
+#include "Compositor.h"
+
+// Latency of switching a playing wallpaper between two media files, from the request till the
+// first frame of the new media is drawn:
+//   restart - StopPlayer, MediaPack is opened on the calling thread, SetScaling and StartPlayer
+//             (as before): the calling thread is blocked and nothing is drawn meanwhile
+//   switch  - SwitchMedia: media is preloaded in background and swapped in at a frame boundary
+// Also the time the calling thread was blocked and the longest gap between drawn frames.
+//
+// usage: SwitchBench <media_file> <other_media_file> [switches] [width] [height] [interval_ms]
+// e.g.:  SwitchBench a.mp4 b.mp4 20 1920 1080 1000
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+// copies frames like monitor does and remembers the longest interval between them
+class GapSink : public FrameTarget {
+public:
+	GapSink(long width, long height) :
+		width(width), height(height)
+	{
+	}
+
+	bool DrawFrame(Frame& frame) override
+	{
+		long row_size = frame.crop_width * frame.bytes_per_pixel;
+		size_t size = (size_t)row_size * frame.crop_height;
+		if (pixels.size() < size)
+			pixels.resize(size);
+
+		const uint8_t* src = frame.frame_buf + (size_t)frame.linesize * frame.y_offset + (size_t)frame.x_offset * frame.bytes_per_pixel;
+		for (long row = 0; row < frame.crop_height; ++row)
+			std::memcpy(pixels.data() + (size_t)row_size * row, src + (size_t)frame.linesize * row, row_size);
+
+		int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+		int64_t previous = last_draw.exchange(now);
+		if (previous != 0 && now - previous > max_gap)
+			max_gap = now - previous;
+
+		++frames_count;
+
+		return true;
+	}
+
+	int GetTargetID() override
+	{
+		return 0;
+	}
+
+	bool GetResolution(long& sink_width, long& sink_height) override
+	{
+		sink_width = width;
+		sink_height = height;
+
+		return true;
+	}
+
+	size_t GetFramesCount()
+	{
+		return frames_count;
+	}
+
+	double TakeMaxGapMs()
+	{
+		int64_t gap = max_gap.exchange(0);
+		return ms_d(std::chrono::steady_clock::duration(gap)).count();
+	}
+
+private:
+	long width, height;
+	std::vector<uint8_t> pixels;
+	std::atomic<size_t> frames_count{ 0 };
+	std::atomic<int64_t> last_draw{ 0 };
+	std::atomic<int64_t> max_gap{ 0 };
+};
+
+struct Result {
+	std::vector<double> latency_ms;
+	std::vector<double> blocked_ms;
+	double max_gap_ms = 0.0;
+};
+
+static void PrintResult(const char* name, Result& result)
+{
+	auto print = [](const char* label, std::vector<double>& values) {
+		if (values.empty())
+			return;
+
+		std::sort(values.begin(), values.end());
+
+		double sum = 0.0;
+		for (double value : values)
+			sum += value;
+
+		std::cout << "   " << std::left << std::setw(20) << label << std::right << std::fixed << std::setprecision(2)
+			<< " mean " << std::setw(8) << sum / values.size() << "  p50 " << std::setw(8) << values[values.size() / 2]
+			<< "  max " << std::setw(8) << values.back() << std::endl;
+	};
+
+	std::cout << name << " (" << result.latency_ms.size() << " switches), ms:" << std::endl;
+	print("request to frame", result.latency_ms);
+	print("caller blocked", result.blocked_ms);
+	std::cout << "   longest gap between frames " << std::fixed << std::setprecision(2) << result.max_gap_ms << std::endl;
+}
+
+static bool WaitFrames(GapSink& sink, size_t frames_count)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (sink.GetFramesCount() < frames_count) {
+		if (std::chrono::steady_clock::now() > deadline)
+			return false;
+
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		std::cout << "usage: " << argv[0] << " <media_file> <other_media_file> [switches] [width] [height] [interval_ms]" << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	std::string paths[2] = { argv[1], argv[2] };
+	size_t switches = argc > 3 ? std::stoul(argv[3]) : 20;
+	long width = argc > 5 ? std::stol(argv[4]) : 1920;
+	long height = argc > 5 ? std::stol(argv[5]) : 1080;
+	int interval_ms = argc > 6 ? std::stoi(argv[6]) : 1000;
+
+	GapSink sink(width, height);
+
+	Compositor compositor;
+	compositor.AddTarget(sink.GetTargetID(), &sink);
+	if (!compositor.Start(60.0)) {
+		std::cout << "Can't start compositor." << std::endl;
+		return 1;
+	}
+
+	Result restart, seamless;
+	bool success = true;
+	{
+		MediaPlayer player(sink, compositor);
+
+		try {
+			if (!player.SetMedia(std::make_unique<MediaPack>(paths[0])) || !player.SetScaling(MediaPlayer::ScalingMode::Scale) ||
+				!player.StartPlayer(true) || !WaitFrames(sink, 1))
+				throw std::runtime_error("Can't play media.");
+
+			// before: player is stopped and started with media opened on this thread
+			for (size_t i = 0; i < switches && success; ++i) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+				sink.TakeMaxGapMs();
+
+				auto start = std::chrono::steady_clock::now();
+
+				player.StopPlayer();
+				size_t frames_count = sink.GetFramesCount();
+
+				success = player.SetMedia(std::make_unique<MediaPack>(paths[(i + 1) % 2])) &&
+					player.SetScaling(MediaPlayer::ScalingMode::Scale) && player.StartPlayer(true);
+				restart.blocked_ms.push_back(ms_d(std::chrono::steady_clock::now() - start).count());
+
+				success = success && WaitFrames(sink, frames_count + 1);
+				restart.latency_ms.push_back(ms_d(std::chrono::steady_clock::now() - start).count());
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				restart.max_gap_ms = std::max(restart.max_gap_ms, sink.TakeMaxGapMs());
+			}
+
+			// after: media is swapped at a frame boundary, latency is measured by player
+			for (size_t i = 0; i < switches && success; ++i) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+				sink.TakeMaxGapMs();
+
+				uint64_t switches_count = player.GetMetrics().media_switch.GetSnapshot().count;
+
+				auto start = std::chrono::steady_clock::now();
+				success = player.SwitchMedia(paths[(i + 1) % 2]);
+				seamless.blocked_ms.push_back(ms_d(std::chrono::steady_clock::now() - start).count());
+
+				auto deadline = start + std::chrono::seconds(10);
+				while (success && player.GetMetrics().media_switch.GetSnapshot().count == switches_count) {
+					if (std::chrono::steady_clock::now() > deadline || !player.IsPlaying())
+						success = false;
+
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+				}
+
+				seamless.latency_ms.push_back(ms_d(std::chrono::steady_clock::now() - start).count());
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				seamless.max_gap_ms = std::max(seamless.max_gap_ms, sink.TakeMaxGapMs());
+			}
+
+			// player's own measurement from request till the new frame was presented
+			LatencyHistogram::Snapshot measured = player.GetMetrics().media_switch.GetSnapshot();
+			std::cout << "player's media_switch metric: count " << measured.count << std::fixed << std::setprecision(2)
+				<< ", mean " << measured.mean_ms << " ms, p99 " << measured.p99_ms << " ms, max " << measured.max_ms << " ms" << std::endl;
+		}
+		catch (std::exception& exception) {
+			std::cout << exception.what() << std::endl;
+			success = false;
+		}
+
+		player.StopPlayer();
+	}
+
+	compositor.Stop();
+
+	if (!success) {
+		std::cout << "Switching failed." << std::endl;
+		return 1;
+	}
+
+	PrintResult("restart", restart);
+	PrintResult("switch", seamless);
+
+	return 0;
+}
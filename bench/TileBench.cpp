@@ -0,0 +1,214 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#include "TileDiff.h"
+#include "MediaPack.h"
+
+// Copy of frames into a drawing surface:
+//   full  - every frame is copied completely, like before
+//   tiles - only tiles changed since the previous frame are copied, unchanged frames are skipped
+// CPU time per frame, estimated memory traffic, average dirty ratio and skipped frames are printed.
+// Without media file synthetic cinemagraph is used: static background, small moving region and
+// every frame shown twice (like 30 fps media on 60 Hz).
+// Fails if a change of the top byte of two words hashed by the same lane (e.g. BGR24 pixels)
+// leaves the tile clean.
+//
+// usage: TileBench [media_file|-] [frames] [width] [height]
+// e.g.:  TileBench - 600 1920 1080
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+static void DrawSynthetic(std::vector<uint8_t>& pixels, long width, long height, long frame_number)
+{
+	long stride = width * 4;
+
+	// background
+	if (frame_number == 0) {
+		for (long y = 0; y < height; ++y) {
+			for (long x = 0; x < width; ++x) {
+				uint8_t* pixel = pixels.data() + (size_t)stride * y + x * 4;
+				pixel[0] = (uint8_t)x;
+				pixel[1] = (uint8_t)y;
+				pixel[2] = (uint8_t)(x ^ y);
+				pixel[3] = 0xFF;
+			}
+		}
+	}
+
+	// moving region of 1/8 of frame's width, it changes every second frame
+	long step = frame_number / 2;
+	long size = std::max(width / 8, 1L);
+	long region_x = (step * 4) % std::max(width - size, 1L);
+	long region_y = height / 2 - size / 2;
+
+	for (long y = std::max(region_y, 0L); y < region_y + size && y < height; ++y) {
+		uint8_t* row = pixels.data() + (size_t)stride * y;
+		for (long x = region_x; x < region_x + size && x < width; ++x) {
+			uint8_t* pixel = row + x * 4;
+			pixel[0] = (uint8_t)(step + x);
+			pixel[1] = (uint8_t)(step + y);
+			pixel[2] = 0x40;
+		}
+	}
+}
+
+// every change of the top byte in two words of a row 32 bytes apart must make the tile dirty,
+// returns count of missed changes
+static size_t CheckHighBits(int bytes_per_pixel, size_t changes)
+{
+	const long size = TileDiff::tile_size;
+	int stride = size * bytes_per_pixel;
+
+	std::vector<uint8_t> pixels((size_t)stride * size);
+	for (size_t i = 0; i < pixels.size(); ++i)
+		pixels[i] = (uint8_t)(i * 7 + (i >> 8));
+
+	TileDiff tile_diff;
+	tile_diff.Reset(size, size, bytes_per_pixel);
+	tile_diff.Update(pixels.data(), stride);
+
+	size_t missed = 0;
+	uint32_t state = 1;
+	for (size_t i = 0; i < changes; ++i) {
+		state = state * 1664525u + 1013904223u;
+
+		// the first change flips bit 63 of both words
+		size_t row = (state >> 8) % size;
+		size_t block = (state >> 16) % (stride / 32 - 1);
+		uint8_t delta = i == 0 ? 0x80 : (uint8_t)((state >> 24) | 1);
+
+		uint8_t* first = pixels.data() + (size_t)stride * row + block * 32 + 7;
+		first[0] ^= delta;
+		first[32] ^= delta;
+
+		if (tile_diff.Update(pixels.data(), stride) == 0)
+			++missed;
+	}
+
+	return missed;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string path = argc > 1 ? argv[1] : "-";
+	long frames_count = argc > 2 ? std::stol(argv[2]) : 600;
+	long width = argc > 3 ? std::stol(argv[3]) : 1920;
+	long height = argc > 4 ? std::stol(argv[4]) : 1080;
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	const size_t changes = 4096;
+	size_t missed_bgr = CheckHighBits(3, changes), missed_bgra = CheckHighBits(4, changes);
+	std::cout << "changes of high bits missed: BGR24 " << missed_bgr << ", BGRA " << missed_bgra << " of " << changes << std::endl;
+	if (missed_bgr > 0 || missed_bgra > 0)
+		return 1;
+
+	try {
+		// all frames are prepared before measurement
+		std::vector<std::vector<uint8_t>> frames;
+		int stride = width * 4;
+
+		if (path == "-") {
+			std::vector<uint8_t> pixels((size_t)stride * height);
+			for (long i = 0; i < frames_count; ++i) {
+				DrawSynthetic(pixels, width, height, i);
+				frames.push_back(pixels);
+			}
+		}
+		else {
+			MediaPack media(path);
+			if (!media.SetScaling(width, height)) {
+				std::cout << "Can't set scaling." << std::endl;
+				return 1;
+			}
+
+			std::vector<uint8_t> buffer(media.GetFrameBufferSize());
+			Frame frame;
+			frame.frame_buf = buffer.data();
+
+			for (long i = 0; i < frames_count; ++i) {
+				if (media.DecodeNextFrame(frame, true)) {
+					std::cout << "Can't read frame." << std::endl;
+					return 1;
+				}
+
+				// tightly packed crop of frame
+				width = frame.crop_width;
+				height = frame.crop_height;
+				stride = width * frame.bytes_per_pixel;
+
+				std::vector<uint8_t> pixels((size_t)stride * height);
+				for (long row = 0; row < height; ++row) {
+					std::memcpy(pixels.data() + (size_t)stride * row,
+						frame.frame_buf + (size_t)frame.linesize * (row + frame.y_offset) + frame.x_offset * frame.bytes_per_pixel, stride);
+				}
+
+				frames.push_back(std::move(pixels));
+			}
+		}
+
+		size_t frame_size = (size_t)stride * height;
+		std::vector<uint8_t> surface(frame_size);
+
+		std::cout << "frames: " << frames.size() << ", " << width << "x" << height << std::endl;
+		std::cout << std::left << std::setw(8) << "mode" << std::setw(14) << "ms/frame" << std::setw(14) << "read MB/f"
+			<< std::setw(14) << "written MB/f" << std::setw(14) << "dirty ratio" << "skipped" << std::endl;
+
+		// full copy
+		auto start = std::chrono::steady_clock::now();
+		for (auto& pixels : frames)
+			std::memcpy(surface.data(), pixels.data(), frame_size);
+		ms_d full_ms = std::chrono::steady_clock::now() - start;
+
+		double frame_mb = frame_size / (1024.0 * 1024.0);
+		std::cout << std::left << std::setw(8) << "full" << std::fixed << std::setprecision(3)
+			<< std::setw(14) << full_ms.count() / frames.size()
+			<< std::setw(14) << frame_mb
+			<< std::setw(14) << frame_mb
+			<< std::setw(14) << 1.0 << 0 << std::endl;
+
+		// only dirty tiles, frame is read once for hashing and dirty tiles once more for copying
+		TileDiff tile_diff;
+		tile_diff.Reset(width, height, 4);
+
+		double dirty_ratio = 0.0;
+		long skipped = 0;
+
+		start = std::chrono::steady_clock::now();
+		for (auto& pixels : frames) {
+			if (tile_diff.Update(pixels.data(), stride) == 0) {
+				++skipped;
+				continue;
+			}
+
+			tile_diff.CopyDirty(pixels.data(), stride, surface.data(), stride);
+			dirty_ratio += tile_diff.GetDirtyRatio();
+		}
+		ms_d tiles_ms = std::chrono::steady_clock::now() - start;
+
+		double average_ratio = dirty_ratio / frames.size();
+		std::cout << std::left << std::setw(8) << "tiles"
+			<< std::setw(14) << tiles_ms.count() / frames.size()
+			<< std::setw(14) << frame_mb * (1.0 + average_ratio)
+			<< std::setw(14) << frame_mb * average_ratio
+			<< std::setw(14) << average_ratio << skipped << std::endl;
+
+		// copy must be the same as the last frame
+		if (!frames.empty() && std::memcmp(surface.data(), frames.back().data(), frame_size) != 0) {
+			std::cout << "Surface differs from the last frame." << std::endl;
+			return 1;
+		}
+	}
+	catch (std::exception& exception) {
+		std::cout << path << ": " << exception.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,400 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+#include "MediaPack.h"
+#include "MediaPlayer.h"
+#include "Compositor.h"
+#include "Tracer.h"
+
+// Headless end-to-end benchmark of decode/convert/copy path, it doesn't need any monitor.
+// Media files or lavfi test sources are played into an in-memory sink, result is printed as JSON:
+// fps, per-stage time (demux, decode, convert, copy) and frame latency (from the start of reading
+// a frame till it is copied into the sink) with mean, p50, p99 and max.
+//   fast   - frames are decoded and copied as fast as possible on one thread
+//   player - frames are played in real time by MediaPlayer and drawn by Compositor
+//
+// usage: dw_bench [options] <media_file|lavfi:graph> [...]
+//   --frames N        frames per media (600)
+//   --size WxH        scaling, media resolution by default
+//   --format F        bgra or bgr24
+//   --threads N       decoding threads, 0 - all cores (0)
+//   --demuxer M       thread or inline: packets are read ahead by demuxer thread or by decoder itself (thread)
+//   --mode M          fast or player (fast)
+//   --refresh HZ      compositor refresh rate in player mode (60)
+//   --label TEXT      stored in JSON, e.g. commit hash
+//   --trace PATH      timeline of the whole run in Chrome trace format (needs DW_TRACING)
+// e.g.:  dw_bench --frames 300 --size 1920x1080 lavfi:testsrc2=size=3840x2160:rate=60 clip.mp4
+
+typedef std::chrono::duration<double, std::milli> ms_d;
+
+
+struct FrameRecord {
+	double demux_ms, decode_ms, convert_ms, copy_ms, latency_ms;
+};
+
+// copies frames into its own buffer like monitor copies them into DIB
+class MemorySink : public FrameTarget {
+public:
+	MemorySink(long width, long height, size_t max_frames) :
+		width(width), height(height)
+	{
+		records.reserve(max_frames);
+	}
+
+	bool DrawFrame(Frame& frame) override
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		long row_size = frame.crop_width * frame.bytes_per_pixel;
+		size_t size = (size_t)row_size * frame.crop_height;
+		if (pixels.size() < size)
+			pixels.resize(size);
+
+		const uint8_t* src = frame.frame_buf + (size_t)frame.linesize * frame.y_offset + (size_t)frame.x_offset * frame.bytes_per_pixel;
+		for (long row = 0; row < frame.crop_height; ++row)
+			std::memcpy(pixels.data() + (size_t)row_size * row, src + (size_t)frame.linesize * row, row_size);
+
+		auto end = std::chrono::steady_clock::now();
+
+		if (records.size() < records.capacity()) {
+			records.push_back({ frame.demux_ms, frame.decode_ms, frame.convert_ms,
+				ms_d(end - start).count(), ms_d(end - frame.prepare_start).count() });
+		}
+
+		++frames_count;
+
+		return true;
+	}
+
+	int GetTargetID() override
+	{
+		return 0;
+	}
+
+	bool GetResolution(long& sink_width, long& sink_height) override
+	{
+		sink_width = width;
+		sink_height = height;
+
+		return true;
+	}
+
+	size_t GetFramesCount()
+	{
+		return frames_count;
+	}
+
+	// must be read only after drawing is stopped
+	const std::vector<FrameRecord>& GetRecords()
+	{
+		return records;
+	}
+
+private:
+	long width, height;
+	std::vector<uint8_t> pixels;
+	std::vector<FrameRecord> records;
+	std::atomic<size_t> frames_count{ 0 };
+};
+
+struct Options {
+	size_t frames = 600;
+	long width = 0, height = 0;
+	FrameFormat format = FrameFormat::BGRA;
+	int threads = 0;
+	bool demuxer_thread = true;
+	bool player_mode = false;
+	double refresh_rate = 60.0;
+	std::string label;
+	std::string trace_path;
+	std::vector<std::string> paths;
+};
+
+static std::string EscapeJson(const std::string& text)
+{
+	std::string escaped;
+	for (char symbol : text) {
+		if (symbol == '"' || symbol == '\\')
+			escaped += '\\';
+
+		if ((unsigned char)symbol < 0x20)
+			escaped += ' ';
+		else
+			escaped += symbol;
+	}
+
+	return escaped;
+}
+
+// {"mean_ms": ..., "p50_ms": ..., "p99_ms": ..., "max_ms": ...}
+static std::string StatsJson(std::vector<double> values)
+{
+	std::ostringstream json;
+	json << std::fixed << std::setprecision(3);
+
+	if (values.empty()) {
+		json << "{\"mean_ms\": 0, \"p50_ms\": 0, \"p99_ms\": 0, \"max_ms\": 0}";
+		return json.str();
+	}
+
+	std::sort(values.begin(), values.end());
+
+	double sum = 0.0;
+	for (double value : values)
+		sum += value;
+
+	auto percentile = [&values](double part) {
+		return values[std::min(values.size() - 1, (size_t)(values.size() * part))];
+	};
+
+	json << "{\"mean_ms\": " << sum / values.size() << ", \"p50_ms\": " << percentile(0.5)
+		<< ", \"p99_ms\": " << percentile(0.99) << ", \"max_ms\": " << values.back() << "}";
+
+	return json.str();
+}
+
+static bool PlayFast(MediaPack& media, MemorySink& sink, const Options& options)
+{
+	std::vector<uint8_t> buffer(media.GetFrameBufferSize());
+
+	Frame frame;
+	frame.frame_buf = buffer.data();
+
+	media.GetScaledResolution(frame.crop_width, frame.crop_height);
+
+	for (size_t i = 0; i < options.frames; ++i) {
+		if (media.DecodeNextFrame(frame, true))
+			return i > 0;
+
+		sink.DrawFrame(frame);
+	}
+
+	return true;
+}
+
+static bool PlayRealTime(std::unique_ptr<MediaPack> media, MemorySink& sink, const Options& options, PacketQueue::Stats& demuxer_stats)
+{
+	// media is owned by player, but it lives until player is destroyed
+	MediaPack* media_pack = media.get();
+
+	Compositor compositor;
+	compositor.AddTarget(sink.GetTargetID(), &sink);
+	if (!compositor.Start(options.refresh_rate))
+		return false;
+
+	bool success = true;
+	{
+		MediaPlayer player(sink, compositor);
+		player.SetFrameFormat(options.format);
+
+		if (!player.SetMedia(std::move(media)) || !player.SetScaling(MediaPlayer::ScalingMode::Scale) || !player.StartPlayer(true)) {
+			success = false;
+		}
+		else {
+			while (sink.GetFramesCount() < options.frames && player.IsPlaying())
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		player.StopPlayer();
+		demuxer_stats = media_pack->GetDemuxerStats();
+	}
+
+	compositor.Stop();
+
+	return success && sink.GetFramesCount() > 0;
+}
+
+static bool RunMedia(const std::string& path, const Options& options, std::ostream& json)
+{
+	std::unique_ptr<MediaPack> media = std::make_unique<MediaPack>(path, options.threads);
+
+	long media_width = 0, media_height = 0;
+	media->GetVideoResolution(media_width, media_height);
+
+	long width = options.width > 0 ? options.width : media_width;
+	long height = options.height > 0 ? options.height : media_height;
+
+	media->SetOutputFormat(options.format);
+	media->SetDemuxerThread(options.demuxer_thread);
+	if (!media->SetScaling(width, height)) {
+		std::cerr << path << ": can't set scaling." << std::endl;
+		return false;
+	}
+
+	int decode_threads = media->GetDecodeThreads();
+	MemorySink sink(width, height, options.frames);
+
+	// in player mode media is owned by player, stats are taken before it is stopped
+	PacketQueue::Stats demuxer_stats;
+
+	auto start = std::chrono::steady_clock::now();
+
+	bool success = options.player_mode ? PlayRealTime(std::move(media), sink, options, demuxer_stats) : PlayFast(*media, sink, options);
+	if (!options.player_mode)
+		demuxer_stats = media->GetDemuxerStats();
+	if (!success) {
+		std::cerr << path << ": can't play media." << std::endl;
+		return false;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const std::vector<FrameRecord>& records = sink.GetRecords();
+
+	std::vector<double> demux, decode, convert, copy, latency;
+	for (auto& record : records) {
+		demux.push_back(record.demux_ms);
+		decode.push_back(record.decode_ms);
+		convert.push_back(record.convert_ms);
+		copy.push_back(record.copy_ms);
+		latency.push_back(record.latency_ms);
+	}
+
+	json << "    {\"path\": \"" << EscapeJson(path) << "\", \"mode\": \"" << (options.player_mode ? "player" : "fast")
+		<< "\", \"width\": " << width << ", \"height\": " << height
+		<< ", \"format\": \"" << (options.format == FrameFormat::BGR24 ? "bgr24" : "bgra") << "\""
+		<< ", \"decode_threads\": " << decode_threads << ", \"demuxer\": \"" << (options.demuxer_thread ? "thread" : "inline") << "\""
+		<< ", \"demuxer_underruns\": " << demuxer_stats.underruns << ", \"demuxer_refills\": " << demuxer_stats.refills
+		<< ", \"frames\": " << records.size() << std::fixed << std::setprecision(3)
+		<< ", \"seconds\": " << seconds << ", \"fps\": " << (seconds > 0.0 ? records.size() / seconds : 0.0) << "," << std::endl
+		<< "     \"stages\": {" << std::endl
+		<< "      \"demux\": " << StatsJson(demux) << "," << std::endl
+		<< "      \"decode\": " << StatsJson(decode) << "," << std::endl
+		<< "      \"convert\": " << StatsJson(convert) << "," << std::endl
+		<< "      \"copy\": " << StatsJson(copy) << std::endl
+		<< "     }," << std::endl
+		<< "     \"latency\": " << StatsJson(latency) << "}";
+
+	return true;
+}
+
+static bool ParseOptions(int argc, char* argv[], Options& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		std::string argument = argv[i];
+		bool has_value = i + 1 < argc;
+
+		if (argument == "--frames" && has_value) {
+			options.frames = std::stoul(argv[++i]);
+		}
+		else if (argument == "--size" && has_value) {
+			std::string size = argv[++i];
+			size_t separator = size.find('x');
+			if (separator == std::string::npos)
+				return false;
+
+			options.width = std::stol(size.substr(0, separator));
+			options.height = std::stol(size.substr(separator + 1));
+		}
+		else if (argument == "--format" && has_value) {
+			std::string format = argv[++i];
+			if (format != "bgra" && format != "bgr24")
+				return false;
+
+			options.format = format == "bgr24" ? FrameFormat::BGR24 : FrameFormat::BGRA;
+		}
+		else if (argument == "--threads" && has_value) {
+			options.threads = std::stoi(argv[++i]);
+		}
+		else if (argument == "--demuxer" && has_value) {
+			std::string demuxer = argv[++i];
+			if (demuxer != "thread" && demuxer != "inline")
+				return false;
+
+			options.demuxer_thread = demuxer == "thread";
+		}
+		else if (argument == "--mode" && has_value) {
+			std::string mode = argv[++i];
+			if (mode != "fast" && mode != "player")
+				return false;
+
+			options.player_mode = mode == "player";
+		}
+		else if (argument == "--refresh" && has_value) {
+			options.refresh_rate = std::stod(argv[++i]);
+		}
+		else if (argument == "--label" && has_value) {
+			options.label = argv[++i];
+		}
+		else if (argument == "--trace" && has_value) {
+			options.trace_path = argv[++i];
+		}
+		else if (argument.compare(0, 2, "--") == 0) {
+			return false;
+		}
+		else {
+			options.paths.push_back(argument);
+		}
+	}
+
+	return !options.paths.empty() && options.frames > 0;
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	try {
+		if (!ParseOptions(argc, argv, options)) {
+			std::cerr << "usage: " << argv[0] << " [--frames N] [--size WxH] [--format bgra|bgr24] [--threads N]"
+				" [--demuxer thread|inline] [--mode fast|player] [--refresh HZ] [--label TEXT] [--trace PATH] <media_file|lavfi:graph> [...]" << std::endl;
+			return 1;
+		}
+	}
+	catch (std::exception&) {
+		std::cerr << "Wrong option value." << std::endl;
+		return 1;
+	}
+
+	av_log_set_level(AV_LOG_ERROR);
+
+	if (!options.trace_path.empty())
+		Tracer::Start();
+
+	bool success = true;
+
+	std::cout << "{" << std::endl;
+	std::cout << "  \"label\": \"" << EscapeJson(options.label) << "\"," << std::endl;
+	std::cout << "  \"results\": [" << std::endl;
+
+	bool is_first = true;
+	for (auto& path : options.paths) {
+		std::ostringstream json;
+
+		try {
+			if (!RunMedia(path, options, json)) {
+				success = false;
+				continue;
+			}
+		}
+		catch (std::exception& exception) {
+			std::cerr << path << ": " << exception.what() << std::endl;
+			success = false;
+			continue;
+		}
+
+		std::cout << (is_first ? "" : ",\n") << json.str();
+		is_first = false;
+	}
+
+	std::cout << std::endl << "  ]" << std::endl << "}" << std::endl;
+
+	if (!options.trace_path.empty()) {
+		Tracer::Stop();
+
+		if (!Tracer::WriteChromeTrace(options.trace_path)) {
+			std::cerr << options.trace_path << ": can't write trace." << std::endl;
+			success = false;
+		}
+	}
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+#include "BakedMedia.h"
+#include "MediaPack.h"
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+
+const char BakedMedia::signature[8] = { 'D', 'W', 'B', 'A', 'K', 'E', 'D', '\0' };
+
+BakedMedia::BakedMedia(std::string path)
+{
+	// read-only mapping, so its pages are shared with other players of this file
+	if (!mapped_file.Open(path))
+		throw std::runtime_error("Can't map baked media.");
+
+	view = mapped_file.GetData();
+	file_size = mapped_file.GetSize();
+
+	if (file_size < sizeof(Header)) {
+		Unmap();
+		throw std::runtime_error("Wrong baked media size.");
+	}
+
+	header = (const Header*)view;
+	if (std::memcmp(header->signature, signature, sizeof(signature)) != 0 || header->version != version) {
+		Unmap();
+		throw std::runtime_error("Wrong baked media header.");
+	}
+
+	// every frame and the index must be inside the file
+	uint64_t row_size = (uint64_t)header->width * GetBytesPerPixel((FrameFormat)header->format);
+	uint64_t index_size = (uint64_t)header->frames_count * sizeof(IndexEntry);
+	bool is_valid = header->width > 0 && header->height > 0 && header->frames_count > 0 &&
+		header->format <= (uint32_t)FrameFormat::BGR24 && (uint64_t)header->linesize >= row_size &&
+		header->frame_size >= (uint64_t)header->linesize * header->height &&
+		header->index_offset <= file_size && index_size <= file_size - header->index_offset;
+
+	if (is_valid) {
+		index = (const IndexEntry*)(view + header->index_offset);
+
+		for (uint32_t i = 0; i < header->frames_count && is_valid; ++i)
+			is_valid = index[i].offset <= file_size && header->frame_size <= file_size - index[i].offset;
+	}
+
+	if (!is_valid) {
+		Unmap();
+		throw std::runtime_error("Wrong baked media header.");
+	}
+}
+
+BakedMedia::~BakedMedia()
+{
+	Unmap();
+}
+
+bool BakedMedia::IsBaked(std::string path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	char file_signature[sizeof(signature)];
+	if (!file.read(file_signature, sizeof(file_signature)))
+		return false;
+
+	return std::memcmp(file_signature, signature, sizeof(signature)) == 0;
+}
+
+bool BakedMedia::Bake(MediaPack& media, std::string baked_path, size_t& frames_count)
+{
+	frames_count = 0;
+
+	long width = 0, height = 0;
+	if (!media.GetScaledResolution(width, height))
+		return false;
+
+	FrameFormat format = media.GetOutputFormat();
+
+	// rows are aligned for SIMD copying, frames are aligned to pages for mapping
+	int linesize = (int)((width * GetBytesPerPixel(format) + 63) & ~63);
+	uint64_t frame_size = ((uint64_t)linesize * height + page_size - 1) & ~(uint64_t)(page_size - 1);
+
+	std::vector<uint8_t> frame_buffer(frame_size, 0);
+
+	std::ofstream file(baked_path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	// header is written again when frames count is known
+	Header file_header = {};
+	std::memcpy(file_header.signature, signature, sizeof(signature));
+	file_header.version = version;
+	file_header.format = (uint32_t)format;
+	file_header.width = width;
+	file_header.height = height;
+	file_header.linesize = linesize;
+	file_header.frame_size = frame_size;
+	file_header.frames_offset = page_size;
+	file_header.frame_rate = 1000.0 / media.GetFrameDuration().count();
+
+	std::vector<uint8_t> header_page(page_size, 0);
+	if (!file.write((const char*)header_page.data(), header_page.size()))
+		return false;
+
+	std::vector<IndexEntry> file_index;
+
+	Frame frame;
+	frame.frame_buf = frame_buffer.data();
+	frame.linesize = linesize;
+
+	while (media.DecodeNextFrame(frame) == 0) {
+		IndexEntry entry = { file_header.frames_offset + frame_size * file_index.size(), frame.timestamp, frame.duration };
+
+		if (!file.write((const char*)frame_buffer.data(), frame_size))
+			return false;
+
+		file_index.push_back(entry);
+	}
+
+	if (file_index.empty())
+		return false;
+
+	file_header.frames_count = (uint32_t)file_index.size();
+	file_header.index_offset = file_header.frames_offset + frame_size * file_index.size();
+
+	if (!file.write((const char*)file_index.data(), file_index.size() * sizeof(IndexEntry)))
+		return false;
+
+	file.seekp(0);
+	if (!file.write((const char*)&file_header, sizeof(file_header)))
+		return false;
+
+	file.close();
+	if (file.fail())
+		return false;
+
+	frames_count = file_index.size();
+
+	return true;
+}
+
+int BakedMedia::GetNextFrame(Frame& frame, bool loop_media)
+{
+	const uint8_t* frame_data = NextFrame(frame, loop_media);
+	if (!frame_data)
+		return -1;
+
+	// mapping is read-only, nobody writes into frames
+	frame.frame_buf = const_cast<uint8_t*>(frame_data);
+	frame.linesize = header->linesize;
+
+	return 0;
+}
+
+int BakedMedia::CopyNextFrame(Frame& frame, uint8_t* dst_buf, int dst_stride, bool loop_media)
+{
+	long row_size = header->width * GetBytesPerPixel((FrameFormat)header->format);
+	if (!dst_buf || dst_stride < row_size)
+		return -1;
+
+	const uint8_t* frame_data = NextFrame(frame, loop_media);
+	if (!frame_data)
+		return -1;
+
+	if (dst_stride == header->linesize) {
+		std::memcpy(dst_buf, frame_data, (size_t)dst_stride * header->height);
+	}
+	else {
+		for (long row = 0; row < header->height; ++row)
+			std::memcpy(dst_buf + (size_t)dst_stride * row, frame_data + (size_t)header->linesize * row, row_size);
+	}
+
+	return 0;
+}
+
+int BakedMedia::Seek(double seek_position)
+{
+	if (header->frames_count == 0)
+		return -1;
+
+	// index is sorted by timestamps, the last frame which starts at or before position
+	const IndexEntry* end = index + header->frames_count;
+	const IndexEntry* entry = std::upper_bound(index, end, seek_position,
+		[](double value, const IndexEntry& index_entry) { return value < index_entry.timestamp; });
+	if (entry != index)
+		--entry;
+
+	position = entry - index;
+	loop_offset = next_timestamp - entry->timestamp;
+
+	return 0;
+}
+
+long BakedMedia::GetWidth()
+{
+	return header->width;
+}
+
+long BakedMedia::GetHeight()
+{
+	return header->height;
+}
+
+FrameFormat BakedMedia::GetFormat()
+{
+	return (FrameFormat)header->format;
+}
+
+int BakedMedia::GetLinesize()
+{
+	return header->linesize;
+}
+
+size_t BakedMedia::GetFrameSize()
+{
+	return header->frame_size;
+}
+
+size_t BakedMedia::GetFramesCount()
+{
+	return header->frames_count;
+}
+
+double BakedMedia::GetFrameRate()
+{
+	return header->frame_rate;
+}
+
+const uint8_t* BakedMedia::NextFrame(Frame& frame, bool loop_media)
+{
+	if (position >= header->frames_count) {
+		if (!loop_media)
+			return nullptr;
+
+		// timestamps of the next loop continue after the last frame
+		const IndexEntry& last = index[header->frames_count - 1];
+		loop_offset += last.timestamp + last.duration;
+		position = 0;
+	}
+
+	const IndexEntry& entry = index[position];
+	++position;
+
+	frame.original_width = header->width;
+	frame.original_height = header->height;
+	frame.format = (FrameFormat)header->format;
+	frame.bytes_per_pixel = GetBytesPerPixel(frame.format);
+	frame.timestamp = entry.timestamp + loop_offset;
+	frame.duration = entry.duration;
+	frame.position = entry.timestamp;
+
+	next_timestamp = frame.timestamp + frame.duration;
+
+	return view + entry.offset;
+}
+
+void BakedMedia::Unmap()
+{
+	view = nullptr;
+	header = nullptr;
+	index = nullptr;
+
+	mapped_file.Close();
+}
\ No newline at end of file
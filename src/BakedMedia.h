@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "Frame.h"
+#include "MappedFile.h"
+
+class MediaPack;
+
+
+// Media decoded once and stored already converted at monitor resolution:
+//   header | frames, every one starts at page boundary | frame index
+// Frames are read straight from the read-only file mapping, so playback doesn't
+// decode or convert anything and pages are shared by all processes playing the same file.
+class BakedMedia {
+public:
+	BakedMedia() = delete;
+
+	// maps baked file, throws if it isn't valid
+	BakedMedia(std::string path);
+
+	~BakedMedia();
+
+	BakedMedia(const BakedMedia& obj) = delete;
+	BakedMedia& operator=(const BakedMedia& obj) = delete;
+	BakedMedia(BakedMedia&& obj) = delete;
+	BakedMedia& operator=(BakedMedia&& obj) = delete;
+
+	// check file signature
+	static bool IsBaked(std::string path);
+
+	// decode the rest of media with its current scaling and output format and write it to baked_path
+	static bool Bake(MediaPack& media, std::string baked_path, size_t& frames_count);
+
+	// frame.frame_buf points into the mapping, it is valid while this object exists
+	int GetNextFrame(Frame& frame, bool loop_media = false);
+
+	// copy the next frame into caller's buffer
+	int CopyNextFrame(Frame& frame, uint8_t* dst_buf, int dst_stride, bool loop_media = false);
+
+	// the next frame is the one shown at position (seconds from the beginning),
+	// timestamps continue after the last returned frame
+	int Seek(double seek_position);
+
+	long GetWidth();
+	long GetHeight();
+	FrameFormat GetFormat();
+	int GetLinesize();
+	size_t GetFrameSize();
+	size_t GetFramesCount();
+	double GetFrameRate();
+
+private:
+	// advance to the next frame and fill its timestamps, returns nullptr at the end
+	const uint8_t* NextFrame(Frame& frame, bool loop_media);
+
+	void Unmap();
+
+	// on-disk structures, all offsets are from the beginning of the file
+	struct Header {
+		char signature[8];
+		uint32_t version;
+		uint32_t format;			// FrameFormat
+		int32_t width, height;
+		int32_t linesize;			// row stride in bytes
+		uint32_t frames_count;
+		uint64_t frame_size;		// stride between frames, multiple of page size
+		uint64_t frames_offset;
+		uint64_t index_offset;
+		double frame_rate;
+	};
+
+	struct IndexEntry {
+		uint64_t offset;
+		double timestamp, duration;	// seconds from the beginning
+	};
+
+	static const char signature[8];
+	static const uint32_t version = 1;
+	static const size_t page_size = 4096;
+
+	MappedFile mapped_file;
+	const uint8_t* view = nullptr;
+	uint64_t file_size = 0;
+
+	const Header* header = nullptr;
+	const IndexEntry* index = nullptr;
+
+	// playback position
+	size_t position = 0;
+	double loop_offset = 0.0;
+	double next_timestamp = 0.0;
+};
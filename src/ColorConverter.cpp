@@ -0,0 +1,673 @@
+#include "ColorConverter.h"
+
+extern "C"
+{
+#include <libavutil/cpu.h>
+}
+
+#include <atomic>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DW_X86
+#include <immintrin.h>
+#endif
+
+// MSVC allows intrinsics in any function, GCC and Clang need target for every function
+#if defined(DW_X86) && !defined(_MSC_VER)
+#define DW_TARGET(isa) __attribute__((target(isa)))
+#else
+#define DW_TARGET(isa)
+#endif
+
+
+namespace {
+
+	// integer YUV -> RGB conversion, all kernels use exactly these formulas:
+	//   c = (Y - y_offset) * y_mul + round
+	//   R = (c + rv * (V - uv_offset)) >> shift
+	//   G = (c - gu * (U - uv_offset) - gv * (V - uv_offset)) >> shift
+	//   B = (c + bu * (U - uv_offset)) >> shift
+	struct Coefficients {
+		int y_offset, uv_offset;
+		int y_mul, rv, gu, gv, bu;
+		int shift, round;
+	};
+
+	enum class Matrix {
+		BT601,
+		BT709
+	};
+
+	// unspecified colorspace is BT.601 like in swscale, there are no kernels for the rest
+	bool GetMatrix(AVColorSpace colorspace, Matrix& matrix)
+	{
+		switch (colorspace) {
+		case AVCOL_SPC_UNSPECIFIED:
+		case AVCOL_SPC_BT470BG:
+		case AVCOL_SPC_SMPTE170M:
+			matrix = Matrix::BT601;
+			return true;
+		case AVCOL_SPC_BT709:
+			matrix = Matrix::BT709;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// matrices of swscale (sws_getCoefficients) rounded to 8 bit fractions
+	Coefficients GetCoefficients(int depth, bool full_range, Matrix matrix)
+	{
+		Coefficients k;
+
+		if (matrix == Matrix::BT709)
+			k = full_range ? Coefficients{ 0, 128, 256, 403, 48, 120, 475, 8, 0 } : Coefficients{ 16, 128, 298, 459, 55, 136, 541, 8, 0 };
+		else
+			k = full_range ? Coefficients{ 0, 128, 256, 359, 88, 183, 454, 8, 0 } : Coefficients{ 16, 128, 298, 409, 100, 208, 516, 8, 0 };
+
+		// coefficients keep 8 bit precision, so only offsets and shift depend on depth
+		k.y_offset <<= depth - 8;
+		k.uv_offset <<= depth - 8;
+		k.shift += depth - 8;
+		k.round = 1 << (k.shift - 1);
+
+		return k;
+	}
+
+	enum class SourceLayout {
+		Planar8,
+		SemiPlanar8,
+		Planar16
+	};
+
+	// converts one row, u and v are rows of chroma planes (for semi-planar u is interleaved UV row)
+	typedef void (*RowFunction)(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp);
+
+
+	/* scalar reference */
+
+	inline int Clamp(int value)
+	{
+		return value < 0 ? 0 : (value > 255 ? 255 : value);
+	}
+
+	inline void StorePixel(uint8_t* dst, int y, int u, int v, const Coefficients& k, int dst_bpp)
+	{
+		int c = (y - k.y_offset) * k.y_mul + k.round;
+		int d = u - k.uv_offset;
+		int e = v - k.uv_offset;
+
+		dst[0] = (uint8_t)Clamp((c + k.bu * d) >> k.shift);
+		dst[1] = (uint8_t)Clamp((c - k.gu * d - k.gv * e) >> k.shift);
+		dst[2] = (uint8_t)Clamp((c + k.rv * e) >> k.shift);
+		if (dst_bpp == 4)
+			dst[3] = 0xFF;
+	}
+
+	void RowPlanar8_Scalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		for (; x < width; ++x)
+			StorePixel(dst + x * dst_bpp, y[x], u[x >> 1], v[x >> 1], k, dst_bpp);
+	}
+
+	void RowSemiPlanar8_Scalar(const uint8_t* y, const uint8_t* uv, const uint8_t*, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		for (; x < width; ++x)
+			StorePixel(dst + x * dst_bpp, y[x], uv[(x >> 1) * 2], uv[(x >> 1) * 2 + 1], k, dst_bpp);
+	}
+
+	void RowPlanar16_Scalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		const uint16_t* y16 = reinterpret_cast<const uint16_t*>(y);
+		const uint16_t* u16 = reinterpret_cast<const uint16_t*>(u);
+		const uint16_t* v16 = reinterpret_cast<const uint16_t*>(v);
+
+		for (; x < width; ++x)
+			StorePixel(dst + x * dst_bpp, y16[x], u16[x >> 1], v16[x >> 1], k, dst_bpp);
+	}
+
+
+#ifdef DW_X86
+
+	inline uint16_t Load16(const uint8_t* src)
+	{
+		uint16_t value;
+		std::memcpy(&value, src, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t Load32(const uint8_t* src)
+	{
+		uint32_t value;
+		std::memcpy(&value, src, sizeof(value));
+		return value;
+	}
+
+
+	/* SSE4.1: 4 pixels per iteration */
+
+	struct Constants_SSE41 {
+		__m128i y_offset, uv_offset, y_mul, rv, gu, gv, bu, round, max, alpha, shift;
+	};
+
+	DW_TARGET("sse4.1") inline Constants_SSE41 MakeConstants_SSE41(const Coefficients& k)
+	{
+		Constants_SSE41 c;
+		c.y_offset = _mm_set1_epi32(k.y_offset);
+		c.uv_offset = _mm_set1_epi32(k.uv_offset);
+		c.y_mul = _mm_set1_epi32(k.y_mul);
+		c.rv = _mm_set1_epi32(k.rv);
+		c.gu = _mm_set1_epi32(k.gu);
+		c.gv = _mm_set1_epi32(k.gv);
+		c.bu = _mm_set1_epi32(k.bu);
+		c.round = _mm_set1_epi32(k.round);
+		c.max = _mm_set1_epi32(255);
+		c.alpha = _mm_set1_epi32((int)0xFF000000);
+		c.shift = _mm_cvtsi32_si128(k.shift);
+		return c;
+	}
+
+	// 4 pixels with 32 bit Y, U, V -> 4 BGRA pixels
+	DW_TARGET("sse4.1") inline __m128i YuvToBgra_SSE41(__m128i y, __m128i u, __m128i v, const Constants_SSE41& k)
+	{
+		__m128i c = _mm_add_epi32(_mm_mullo_epi32(_mm_sub_epi32(y, k.y_offset), k.y_mul), k.round);
+		__m128i d = _mm_sub_epi32(u, k.uv_offset);
+		__m128i e = _mm_sub_epi32(v, k.uv_offset);
+
+		__m128i b = _mm_sra_epi32(_mm_add_epi32(c, _mm_mullo_epi32(k.bu, d)), k.shift);
+		__m128i g = _mm_sra_epi32(_mm_sub_epi32(_mm_sub_epi32(c, _mm_mullo_epi32(k.gu, d)), _mm_mullo_epi32(k.gv, e)), k.shift);
+		__m128i r = _mm_sra_epi32(_mm_add_epi32(c, _mm_mullo_epi32(k.rv, e)), k.shift);
+
+		__m128i zero = _mm_setzero_si128();
+		b = _mm_min_epi32(_mm_max_epi32(b, zero), k.max);
+		g = _mm_min_epi32(_mm_max_epi32(g, zero), k.max);
+		r = _mm_min_epi32(_mm_max_epi32(r, zero), k.max);
+
+		return _mm_or_si128(_mm_or_si128(b, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(r, 16), k.alpha));
+	}
+
+	// 4 BGRA pixels -> 12 bytes of BGR24
+	DW_TARGET("sse4.1") inline void StoreBgr24_SSE41(uint8_t* dst, __m128i bgra)
+	{
+		const __m128i mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		__m128i bgr = _mm_shuffle_epi8(bgra, mask);
+
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), bgr);
+		uint32_t tail = (uint32_t)_mm_extract_epi32(bgr, 2);
+		std::memcpy(dst + 8, &tail, sizeof(tail));
+	}
+
+	DW_TARGET("sse4.1") inline void Store_SSE41(uint8_t* dst, __m128i bgra, int dst_bpp)
+	{
+		if (dst_bpp == 4)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), bgra);
+		else
+			StoreBgr24_SSE41(dst, bgra);
+	}
+
+	DW_TARGET("sse4.1") void RowPlanar8_SSE41(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		Constants_SSE41 kv = MakeConstants_SSE41(k);
+
+		for (; x + 4 <= width; x += 4) {
+			__m128i yy = _mm_cvtepu8_epi32(_mm_cvtsi32_si128((int)Load32(y + x)));
+
+			// every chroma sample is used by 2 pixels
+			__m128i uu = _mm_cvtsi32_si128(Load16(u + x / 2));
+			__m128i vv = _mm_cvtsi32_si128(Load16(v + x / 2));
+			uu = _mm_cvtepu8_epi32(_mm_unpacklo_epi8(uu, uu));
+			vv = _mm_cvtepu8_epi32(_mm_unpacklo_epi8(vv, vv));
+
+			Store_SSE41(dst + x * dst_bpp, YuvToBgra_SSE41(yy, uu, vv, kv), dst_bpp);
+		}
+
+		RowPlanar8_Scalar(y, u, v, dst, x, width, k, dst_bpp);
+	}
+
+	DW_TARGET("sse4.1") void RowSemiPlanar8_SSE41(const uint8_t* y, const uint8_t* uv, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		Constants_SSE41 kv = MakeConstants_SSE41(k);
+
+		const __m128i u_mask = _mm_setr_epi8(0, 0, 2, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+		const __m128i v_mask = _mm_setr_epi8(1, 1, 3, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+		for (; x + 4 <= width; x += 4) {
+			__m128i yy = _mm_cvtepu8_epi32(_mm_cvtsi32_si128((int)Load32(y + x)));
+
+			// 2 interleaved UV pairs for 4 pixels
+			__m128i uvuv = _mm_cvtsi32_si128((int)Load32(uv + x));
+			__m128i uu = _mm_cvtepu8_epi32(_mm_shuffle_epi8(uvuv, u_mask));
+			__m128i vv = _mm_cvtepu8_epi32(_mm_shuffle_epi8(uvuv, v_mask));
+
+			Store_SSE41(dst + x * dst_bpp, YuvToBgra_SSE41(yy, uu, vv, kv), dst_bpp);
+		}
+
+		RowSemiPlanar8_Scalar(y, uv, v, dst, x, width, k, dst_bpp);
+	}
+
+	DW_TARGET("sse4.1") void RowPlanar16_SSE41(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		Constants_SSE41 kv = MakeConstants_SSE41(k);
+
+		for (; x + 4 <= width; x += 4) {
+			__m128i yy = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x * 2)));
+
+			__m128i uu = _mm_cvtsi32_si128((int)Load32(u + x));
+			__m128i vv = _mm_cvtsi32_si128((int)Load32(v + x));
+			uu = _mm_cvtepu16_epi32(_mm_unpacklo_epi16(uu, uu));
+			vv = _mm_cvtepu16_epi32(_mm_unpacklo_epi16(vv, vv));
+
+			Store_SSE41(dst + x * dst_bpp, YuvToBgra_SSE41(yy, uu, vv, kv), dst_bpp);
+		}
+
+		RowPlanar16_Scalar(y, u, v, dst, x, width, k, dst_bpp);
+	}
+
+
+	/* AVX2: 8 pixels per iteration */
+
+	struct Constants_AVX2 {
+		__m256i y_offset, uv_offset, y_mul, rv, gu, gv, bu, round, max, alpha;
+		__m128i shift;
+	};
+
+	DW_TARGET("avx2") inline Constants_AVX2 MakeConstants_AVX2(const Coefficients& k)
+	{
+		Constants_AVX2 c;
+		c.y_offset = _mm256_set1_epi32(k.y_offset);
+		c.uv_offset = _mm256_set1_epi32(k.uv_offset);
+		c.y_mul = _mm256_set1_epi32(k.y_mul);
+		c.rv = _mm256_set1_epi32(k.rv);
+		c.gu = _mm256_set1_epi32(k.gu);
+		c.gv = _mm256_set1_epi32(k.gv);
+		c.bu = _mm256_set1_epi32(k.bu);
+		c.round = _mm256_set1_epi32(k.round);
+		c.max = _mm256_set1_epi32(255);
+		c.alpha = _mm256_set1_epi32((int)0xFF000000);
+		c.shift = _mm_cvtsi32_si128(k.shift);
+		return c;
+	}
+
+	DW_TARGET("avx2") inline __m256i YuvToBgra_AVX2(__m256i y, __m256i u, __m256i v, const Constants_AVX2& k)
+	{
+		__m256i c = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(y, k.y_offset), k.y_mul), k.round);
+		__m256i d = _mm256_sub_epi32(u, k.uv_offset);
+		__m256i e = _mm256_sub_epi32(v, k.uv_offset);
+
+		__m256i b = _mm256_sra_epi32(_mm256_add_epi32(c, _mm256_mullo_epi32(k.bu, d)), k.shift);
+		__m256i g = _mm256_sra_epi32(_mm256_sub_epi32(_mm256_sub_epi32(c, _mm256_mullo_epi32(k.gu, d)), _mm256_mullo_epi32(k.gv, e)), k.shift);
+		__m256i r = _mm256_sra_epi32(_mm256_add_epi32(c, _mm256_mullo_epi32(k.rv, e)), k.shift);
+
+		__m256i zero = _mm256_setzero_si256();
+		b = _mm256_min_epi32(_mm256_max_epi32(b, zero), k.max);
+		g = _mm256_min_epi32(_mm256_max_epi32(g, zero), k.max);
+		r = _mm256_min_epi32(_mm256_max_epi32(r, zero), k.max);
+
+		return _mm256_or_si256(_mm256_or_si256(b, _mm256_slli_epi32(g, 8)), _mm256_or_si256(_mm256_slli_epi32(r, 16), k.alpha));
+	}
+
+	DW_TARGET("avx2") inline void Store_AVX2(uint8_t* dst, __m256i bgra, int dst_bpp)
+	{
+		if (dst_bpp == 4) {
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), bgra);
+		}
+		else {
+			StoreBgr24_SSE41(dst, _mm256_castsi256_si128(bgra));
+			StoreBgr24_SSE41(dst + 12, _mm256_extracti128_si256(bgra, 1));
+		}
+	}
+
+	DW_TARGET("avx2") void RowPlanar8_AVX2(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		Constants_AVX2 kv = MakeConstants_AVX2(k);
+
+		for (; x + 8 <= width; x += 8) {
+			__m256i yy = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x)));
+
+			__m128i uu = _mm_cvtsi32_si128((int)Load32(u + x / 2));
+			__m128i vv = _mm_cvtsi32_si128((int)Load32(v + x / 2));
+
+			Store_AVX2(dst + x * dst_bpp, YuvToBgra_AVX2(yy,
+				_mm256_cvtepu8_epi32(_mm_unpacklo_epi8(uu, uu)),
+				_mm256_cvtepu8_epi32(_mm_unpacklo_epi8(vv, vv)), kv), dst_bpp);
+		}
+
+		RowPlanar8_Scalar(y, u, v, dst, x, width, k, dst_bpp);
+	}
+
+	DW_TARGET("avx2") void RowSemiPlanar8_AVX2(const uint8_t* y, const uint8_t* uv, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		Constants_AVX2 kv = MakeConstants_AVX2(k);
+
+		const __m128i u_mask = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, -1, -1, -1, -1, -1, -1, -1, -1);
+		const __m128i v_mask = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+		for (; x + 8 <= width; x += 8) {
+			__m256i yy = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x)));
+
+			__m128i uvuv = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(uv + x));
+
+			Store_AVX2(dst + x * dst_bpp, YuvToBgra_AVX2(yy,
+				_mm256_cvtepu8_epi32(_mm_shuffle_epi8(uvuv, u_mask)),
+				_mm256_cvtepu8_epi32(_mm_shuffle_epi8(uvuv, v_mask)), kv), dst_bpp);
+		}
+
+		RowSemiPlanar8_Scalar(y, uv, v, dst, x, width, k, dst_bpp);
+	}
+
+	DW_TARGET("avx2") void RowPlanar16_AVX2(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		Constants_AVX2 kv = MakeConstants_AVX2(k);
+
+		for (; x + 8 <= width; x += 8) {
+			__m256i yy = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x * 2)));
+
+			__m128i uu = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x));
+			__m128i vv = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x));
+
+			Store_AVX2(dst + x * dst_bpp, YuvToBgra_AVX2(yy,
+				_mm256_cvtepu16_epi32(_mm_unpacklo_epi16(uu, uu)),
+				_mm256_cvtepu16_epi32(_mm_unpacklo_epi16(vv, vv)), kv), dst_bpp);
+		}
+
+		RowPlanar16_Scalar(y, u, v, dst, x, width, k, dst_bpp);
+	}
+
+
+	/* AVX-512: 16 pixels per iteration */
+
+	struct Constants_AVX512 {
+		__m512i y_offset, uv_offset, y_mul, rv, gu, gv, bu, round, max, alpha;
+		__m128i shift;
+	};
+
+	DW_TARGET("avx512f,avx512bw") inline Constants_AVX512 MakeConstants_AVX512(const Coefficients& k)
+	{
+		Constants_AVX512 c;
+		c.y_offset = _mm512_set1_epi32(k.y_offset);
+		c.uv_offset = _mm512_set1_epi32(k.uv_offset);
+		c.y_mul = _mm512_set1_epi32(k.y_mul);
+		c.rv = _mm512_set1_epi32(k.rv);
+		c.gu = _mm512_set1_epi32(k.gu);
+		c.gv = _mm512_set1_epi32(k.gv);
+		c.bu = _mm512_set1_epi32(k.bu);
+		c.round = _mm512_set1_epi32(k.round);
+		c.max = _mm512_set1_epi32(255);
+		c.alpha = _mm512_set1_epi32((int)0xFF000000);
+		c.shift = _mm_cvtsi32_si128(k.shift);
+		return c;
+	}
+
+	DW_TARGET("avx512f,avx512bw") inline __m512i YuvToBgra_AVX512(__m512i y, __m512i u, __m512i v, const Constants_AVX512& k)
+	{
+		__m512i c = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_sub_epi32(y, k.y_offset), k.y_mul), k.round);
+		__m512i d = _mm512_sub_epi32(u, k.uv_offset);
+		__m512i e = _mm512_sub_epi32(v, k.uv_offset);
+
+		__m512i b = _mm512_sra_epi32(_mm512_add_epi32(c, _mm512_mullo_epi32(k.bu, d)), k.shift);
+		__m512i g = _mm512_sra_epi32(_mm512_sub_epi32(_mm512_sub_epi32(c, _mm512_mullo_epi32(k.gu, d)), _mm512_mullo_epi32(k.gv, e)), k.shift);
+		__m512i r = _mm512_sra_epi32(_mm512_add_epi32(c, _mm512_mullo_epi32(k.rv, e)), k.shift);
+
+		__m512i zero = _mm512_setzero_si512();
+		b = _mm512_min_epi32(_mm512_max_epi32(b, zero), k.max);
+		g = _mm512_min_epi32(_mm512_max_epi32(g, zero), k.max);
+		r = _mm512_min_epi32(_mm512_max_epi32(r, zero), k.max);
+
+		return _mm512_or_si512(_mm512_or_si512(b, _mm512_slli_epi32(g, 8)), _mm512_or_si512(_mm512_slli_epi32(r, 16), k.alpha));
+	}
+
+	DW_TARGET("avx512f,avx512bw") inline void Store_AVX512(uint8_t* dst, __m512i bgra, int dst_bpp)
+	{
+		if (dst_bpp == 4) {
+			_mm512_storeu_si512(reinterpret_cast<void*>(dst), bgra);
+		}
+		else {
+			StoreBgr24_SSE41(dst, _mm512_extracti32x4_epi32(bgra, 0));
+			StoreBgr24_SSE41(dst + 12, _mm512_extracti32x4_epi32(bgra, 1));
+			StoreBgr24_SSE41(dst + 24, _mm512_extracti32x4_epi32(bgra, 2));
+			StoreBgr24_SSE41(dst + 36, _mm512_extracti32x4_epi32(bgra, 3));
+		}
+	}
+
+	DW_TARGET("avx512f,avx512bw") void RowPlanar8_AVX512(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		Constants_AVX512 kv = MakeConstants_AVX512(k);
+
+		for (; x + 16 <= width; x += 16) {
+			__m512i yy = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x)));
+
+			__m128i uu = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x / 2));
+			__m128i vv = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x / 2));
+
+			Store_AVX512(dst + x * dst_bpp, YuvToBgra_AVX512(yy,
+				_mm512_cvtepu8_epi32(_mm_unpacklo_epi8(uu, uu)),
+				_mm512_cvtepu8_epi32(_mm_unpacklo_epi8(vv, vv)), kv), dst_bpp);
+		}
+
+		RowPlanar8_Scalar(y, u, v, dst, x, width, k, dst_bpp);
+	}
+
+	DW_TARGET("avx512f,avx512bw") void RowSemiPlanar8_AVX512(const uint8_t* y, const uint8_t* uv, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		Constants_AVX512 kv = MakeConstants_AVX512(k);
+
+		const __m128i u_mask = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14);
+		const __m128i v_mask = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15);
+
+		for (; x + 16 <= width; x += 16) {
+			__m512i yy = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x)));
+
+			__m128i uvuv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + x));
+
+			Store_AVX512(dst + x * dst_bpp, YuvToBgra_AVX512(yy,
+				_mm512_cvtepu8_epi32(_mm_shuffle_epi8(uvuv, u_mask)),
+				_mm512_cvtepu8_epi32(_mm_shuffle_epi8(uvuv, v_mask)), kv), dst_bpp);
+		}
+
+		RowSemiPlanar8_Scalar(y, uv, v, dst, x, width, k, dst_bpp);
+	}
+
+	DW_TARGET("avx512f,avx512bw") void RowPlanar16_AVX512(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst,
+		long x, long width, const Coefficients& k, int dst_bpp)
+	{
+		Constants_AVX512 kv = MakeConstants_AVX512(k);
+
+		for (; x + 16 <= width; x += 16) {
+			__m512i yy = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + x * 2)));
+
+			__m128i uu = _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + x));
+			__m128i vv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + x));
+
+			__m256i uu2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(uu, uu)), _mm_unpackhi_epi16(uu, uu), 1);
+			__m256i vv2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(vv, vv)), _mm_unpackhi_epi16(vv, vv), 1);
+
+			Store_AVX512(dst + x * dst_bpp, YuvToBgra_AVX512(yy,
+				_mm512_cvtepu16_epi32(uu2), _mm512_cvtepu16_epi32(vv2), kv), dst_bpp);
+		}
+
+		RowPlanar16_Scalar(y, u, v, dst, x, width, k, dst_bpp);
+	}
+
+#endif // DW_X86
+
+
+	std::atomic<int> current_level{ -1 };
+
+	RowFunction GetRowFunction(SourceLayout layout, ColorConverter::SimdLevel level)
+	{
+#ifdef DW_X86
+		switch (level) {
+		case ColorConverter::SimdLevel::AVX512:
+			if (layout == SourceLayout::Planar8) return RowPlanar8_AVX512;
+			if (layout == SourceLayout::SemiPlanar8) return RowSemiPlanar8_AVX512;
+			return RowPlanar16_AVX512;
+		case ColorConverter::SimdLevel::AVX2:
+			if (layout == SourceLayout::Planar8) return RowPlanar8_AVX2;
+			if (layout == SourceLayout::SemiPlanar8) return RowSemiPlanar8_AVX2;
+			return RowPlanar16_AVX2;
+		case ColorConverter::SimdLevel::SSE41:
+			if (layout == SourceLayout::Planar8) return RowPlanar8_SSE41;
+			if (layout == SourceLayout::SemiPlanar8) return RowSemiPlanar8_SSE41;
+			return RowPlanar16_SSE41;
+		default:
+			break;
+		}
+#endif
+
+		if (layout == SourceLayout::Planar8) return RowPlanar8_Scalar;
+		if (layout == SourceLayout::SemiPlanar8) return RowSemiPlanar8_Scalar;
+		return RowPlanar16_Scalar;
+	}
+
+	bool GetSourceLayout(AVPixelFormat src_format, SourceLayout& layout, int& depth, bool& full_range)
+	{
+		switch (src_format) {
+		case AV_PIX_FMT_YUVJ420P:
+			full_range = true;
+			// fall through
+		case AV_PIX_FMT_YUV420P:
+			layout = SourceLayout::Planar8;
+			depth = 8;
+			return true;
+		case AV_PIX_FMT_NV12:
+			layout = SourceLayout::SemiPlanar8;
+			depth = 8;
+			return true;
+		case AV_PIX_FMT_YUV420P10LE:
+			layout = SourceLayout::Planar16;
+			depth = 10;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	int GetDstBytesPerPixel(AVPixelFormat dst_format)
+	{
+		switch (dst_format) {
+		case AV_PIX_FMT_BGRA:
+		case AV_PIX_FMT_BGR0:
+			return 4;
+		case AV_PIX_FMT_BGR24:
+			return 3;
+		default:
+			return 0;
+		}
+	}
+}
+
+
+bool ColorConverter::IsSupported(AVPixelFormat src_format, AVPixelFormat dst_format)
+{
+	SourceLayout layout;
+	int depth = 0;
+	bool full_range = false;
+
+	return GetSourceLayout(src_format, layout, depth, full_range) && GetDstBytesPerPixel(dst_format) > 0;
+}
+
+bool ColorConverter::IsSupportedColorspace(AVColorSpace colorspace)
+{
+	Matrix matrix;
+
+	return GetMatrix(colorspace, matrix);
+}
+
+bool ColorConverter::Convert(const uint8_t* const src_data[4], const int src_linesize[4], AVPixelFormat src_format,
+	bool full_range, AVColorSpace colorspace, uint8_t* dst, int dst_stride, AVPixelFormat dst_format, long width, long height)
+{
+	SourceLayout layout;
+	int depth = 0;
+	if (!GetSourceLayout(src_format, layout, depth, full_range))
+		return false;
+
+	Matrix matrix;
+	if (!GetMatrix(colorspace, matrix))
+		return false;
+
+	int dst_bpp = GetDstBytesPerPixel(dst_format);
+	if (dst_bpp == 0 || !dst || width <= 0 || height <= 0)
+		return false;
+
+	Coefficients k = GetCoefficients(depth, full_range, matrix);
+	RowFunction row_function = GetRowFunction(layout, GetSimdLevel());
+
+	for (long row = 0; row < height; ++row) {
+		// 4:2:0 - one chroma row for 2 luma rows
+		long chroma_row = row >> 1;
+
+		const uint8_t* y = src_data[0] + (ptrdiff_t)row * src_linesize[0];
+		const uint8_t* u = src_data[1] + (ptrdiff_t)chroma_row * src_linesize[1];
+		const uint8_t* v = layout == SourceLayout::SemiPlanar8 ? nullptr : src_data[2] + (ptrdiff_t)chroma_row * src_linesize[2];
+
+		row_function(y, u, v, dst + (ptrdiff_t)row * dst_stride, 0, width, k, dst_bpp);
+	}
+
+	return true;
+}
+
+ColorConverter::SimdLevel ColorConverter::GetCpuSimdLevel()
+{
+#ifdef DW_X86
+	int cpu_flags = av_get_cpu_flags();
+
+	if (cpu_flags & AV_CPU_FLAG_AVX512)
+		return SimdLevel::AVX512;
+	if (cpu_flags & AV_CPU_FLAG_AVX2)
+		return SimdLevel::AVX2;
+	if (cpu_flags & AV_CPU_FLAG_SSE4)
+		return SimdLevel::SSE41;
+#endif
+
+	return SimdLevel::Scalar;
+}
+
+ColorConverter::SimdLevel ColorConverter::GetSimdLevel()
+{
+	int level = current_level.load(std::memory_order_relaxed);
+	if (level < 0) {
+		level = (int)GetCpuSimdLevel();
+		current_level.store(level, std::memory_order_relaxed);
+	}
+
+	return (SimdLevel)level;
+}
+
+ColorConverter::SimdLevel ColorConverter::SetSimdLevel(SimdLevel level)
+{
+	// can't use instructions which CPU doesn't have
+	SimdLevel cpu_level = GetCpuSimdLevel();
+	if ((int)level > (int)cpu_level)
+		level = cpu_level;
+
+	current_level.store((int)level, std::memory_order_relaxed);
+
+	return level;
+}
+
+const char* ColorConverter::GetSimdLevelName(SimdLevel level)
+{
+	switch (level) {
+	case SimdLevel::SSE41:
+		return "SSE4.1";
+	case SimdLevel::AVX2:
+		return "AVX2";
+	case SimdLevel::AVX512:
+		return "AVX-512";
+	default:
+		return "scalar";
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+extern "C"
+{
+#include <libavutil/pixfmt.h>
+}
+
+#include <cstdint>
+
+
+// Fast path for the most common conversions without resizing:
+// yuv420p / yuvj420p / nv12 / yuv420p10 -> BGRA, BGR0 or BGR24,
+// BT.601 or BT.709, limited or full range. Chroma isn't interpolated
+// (nearest sample, like unscaled swscale). Kernels are selected at runtime
+// by CPU features, every SIMD variant gives exactly the same result as scalar reference.
+class ColorConverter {
+public:
+	enum class SimdLevel {
+		Scalar = 0,
+		SSE41,
+		AVX2,
+		AVX512
+	};
+
+	ColorConverter() = delete;
+
+	static bool IsSupported(AVPixelFormat src_format, AVPixelFormat dst_format);
+
+	// BT.601 (also unspecified) and BT.709, others like BT.2020 must go through swscale
+	static bool IsSupportedColorspace(AVColorSpace colorspace);
+
+	// convert width x height pixels, src_data must already point to the top left pixel of converted region;
+	// returns false if conversion or colorspace isn't supported, so caller must use swscale
+	static bool Convert(const uint8_t* const src_data[4], const int src_linesize[4], AVPixelFormat src_format,
+		bool full_range, AVColorSpace colorspace, uint8_t* dst, int dst_stride, AVPixelFormat dst_format, long width, long height);
+
+	// the best level supported by CPU
+	static SimdLevel GetCpuSimdLevel();
+
+	// level used by Convert, can be lowered for benchmarks and comparison with scalar reference
+	static SimdLevel GetSimdLevel();
+	static SimdLevel SetSimdLevel(SimdLevel level);
+
+	static const char* GetSimdLevelName(SimdLevel level);
+};
@@ -0,0 +1,225 @@
+#include "Compositor.h"
+#include "Tracer.h"
+
+#include <typeinfo>
+
+
+Compositor::~Compositor()
+{
+	Stop();
+}
+
+bool Compositor::AddTarget(int target_id, FrameTarget* target)
+{
+	if (!target || IsRunning() || FindSlot(target_id))
+		return false;
+
+	slots.emplace_back();
+	slots.back().target_id = target_id;
+	slots.back().target = target;
+
+	return true;
+}
+
+bool Compositor::Start(double refresh_rate)
+{
+	Stop();
+
+	if (refresh_rate <= 0.0)
+		return false;
+
+	tick_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / refresh_rate));
+
+	is_running = true;
+	keep_presenting.test_and_set();
+	present_thread = std::thread(&Compositor::PresentThreadFunction, this);
+
+	return true;
+}
+
+void Compositor::Stop()
+{
+	if (present_thread.joinable()) {
+		keep_presenting.clear();
+		present_thread.join();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(present_mutex);
+		is_running = false;
+
+		// frames which weren't drawn are dropped, their buffers can be freed
+		for (auto& slot : slots)
+			slot.presented = slot.published.load();
+	}
+
+	present_condition.notify_all();
+}
+
+bool Compositor::IsRunning()
+{
+	return is_running;
+}
+
+uint64_t Compositor::Publish(int target_id, const Frame& frame)
+{
+	Slot* slot = FindSlot(target_id);
+	if (!slot || !is_running)
+		return 0;
+
+	// previous frame is already presented, so present thread doesn't read this slot now
+	uint64_t ticket = slot->published.load(std::memory_order_relaxed) + 1;
+	slot->frame = frame;
+	slot->published.store(ticket, std::memory_order_release);
+
+	return ticket;
+}
+
+bool Compositor::IsPresented(int target_id, uint64_t ticket, bool& success)
+{
+	success = false;
+
+	Slot* slot = FindSlot(target_id);
+	if (!slot || ticket == 0)
+		return true;
+
+	if (slot->presented.load(std::memory_order_acquire) >= ticket) {
+		success = slot->success;
+		return true;
+	}
+
+	// nobody will draw it
+	return !is_running;
+}
+
+bool Compositor::WaitPresented(int target_id, uint64_t ticket)
+{
+	bool success = false;
+
+	std::unique_lock<std::mutex> lock(present_mutex);
+	present_condition.wait(lock, [&]() { return IsPresented(target_id, ticket, success); });
+
+	return success;
+}
+
+double Compositor::GetDrawMs(int target_id)
+{
+	Slot* slot = FindSlot(target_id);
+	if (!slot)
+		return 0.0;
+
+	return slot->draw_ns.load(std::memory_order_relaxed) / 1e6;
+}
+
+uint64_t Compositor::GetTicksCount()
+{
+	return ticks_count;
+}
+
+uint64_t Compositor::GetPresentedFrames()
+{
+	return presented_frames;
+}
+
+double Compositor::GetAverageTickMs()
+{
+	uint64_t ticks = ticks_count;
+
+	return ticks > 0 ? total_tick_ns / 1e6 / ticks : 0.0;
+}
+
+double Compositor::GetMaxTickMs()
+{
+	return max_tick_ns / 1e6;
+}
+
+void Compositor::PresentThreadFunction()
+{
+	TRACE_THREAD_NAME("compositor");
+
+	std::chrono::steady_clock::time_point next_tick = std::chrono::steady_clock::now();
+
+	while (keep_presenting.test_and_set()) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		// draw every target with a new frame
+		size_t drawn = 0;
+		for (auto& slot : slots) {
+			uint64_t ticket = slot.published.load(std::memory_order_acquire);
+			if (ticket == slot.presented.load(std::memory_order_relaxed))
+				continue;
+
+			std::chrono::steady_clock::time_point draw_start = std::chrono::steady_clock::now();
+			{
+				TRACE_SCOPE("DrawFrame");
+				slot.success = slot.target->DrawFrame(slot.frame);
+			}
+			slot.draw_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - draw_start).count(),
+				std::memory_order_relaxed);
+			slot.drawing = ticket;
+			++drawn;
+		}
+
+		if (drawn > 0) {
+			TRACE_SCOPE("Flush");
+
+			// buffers go back to decoders, so targets must finish reading them;
+			// one flush covers all targets of a type (GdiFlush flushes the whole thread)
+			for (size_t i = 0; i < slots.size(); ++i) {
+				if (slots[i].drawing == 0)
+					continue;
+
+				bool is_flushed = false;
+				for (size_t j = 0; j < i && !is_flushed; ++j)
+					is_flushed = slots[j].drawing != 0 && typeid(*slots[j].target) == typeid(*slots[i].target);
+
+				if (!is_flushed)
+					slots[i].target->Flush();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(present_mutex);
+				for (auto& slot : slots) {
+					if (slot.drawing != 0) {
+						slot.presented.store(slot.drawing, std::memory_order_release);
+						slot.drawing = 0;
+					}
+				}
+			}
+			present_condition.notify_all();
+
+			uint64_t tick_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			total_tick_ns += tick_ns;
+			if (tick_ns > max_tick_ns)
+				max_tick_ns = tick_ns;
+
+			presented_frames += drawn;
+			++ticks_count;
+		}
+
+		// wait for the next refresh, missed ticks are skipped
+		next_tick += tick_interval;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (next_tick < now)
+			next_tick = now;
+
+		std::this_thread::sleep_until(next_tick);
+	}
+
+	// release publishers which wait for their frames
+	{
+		std::lock_guard<std::mutex> lock(present_mutex);
+		is_running = false;
+	}
+	present_condition.notify_all();
+}
+
+Compositor::Slot* Compositor::FindSlot(int target_id)
+{
+	for (auto& slot : slots) {
+		if (slot.target_id == target_id)
+			return &slot;
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <cstdint>
+
+#include <vector>
+
+#include "Frame.h"
+
+
+// Anything frames can be drawn on, e.g. monitor or in-memory sink. DrawFrame and Flush
+// are called only by compositor thread.
+class FrameTarget {
+public:
+	virtual ~FrameTarget() = default;
+
+	virtual bool DrawFrame(Frame& frame) = 0;
+
+	// called once per tick for every type of drawn targets, after they are drawn and before frame buffers
+	// go back to decoders, so it must finish drawing of all targets of its type
+	virtual void Flush() {}
+
+	virtual int GetTargetID() = 0;
+	virtual bool GetResolution(long& width, long& height) = 0;
+
+	// buffers of target which frames can be decoded directly into, so DrawFrame doesn't copy them
+	virtual bool CreateSurfaces(size_t count, long width, long height, const Frame& frame_template, std::vector<Frame>& frames) { return false; }
+	virtual void ReleaseSurfaces() {}
+
+	// part of the last drawn frame which was changed and frames identical to the previous one,
+	// which weren't presented; targets without tile diff draw every frame whole
+	virtual double GetDirtyRatio() { return 1.0; }
+	virtual uint64_t GetSkippedFrames() { return 0; }
+};
+
+
+// Single present thread for all targets. Players publish their latest frames into
+// per-target slots without locking, and on every display refresh tick compositor draws
+// all targets with new frames in one pass, so players never wait for each other.
+class Compositor {
+public:
+	Compositor() = default;
+
+	~Compositor();
+
+	Compositor(const Compositor& obj) = delete;
+	Compositor& operator=(const Compositor& obj) = delete;
+	Compositor(Compositor&& obj) = delete;
+	Compositor& operator=(Compositor&& obj) = delete;
+
+	// targets can be added only while compositor is stopped
+	bool AddTarget(int target_id, FrameTarget* target);
+
+	bool Start(double refresh_rate = 60.0);
+	void Stop();
+	bool IsRunning();
+
+	// only one thread can publish into a target; frame's buffer must stay valid until frame
+	// is presented, returns ticket for IsPresented or 0 if frame can't be presented
+	uint64_t Publish(int target_id, const Frame& frame);
+
+	// frame was drawn (or compositor was stopped), success is result of drawing
+	bool IsPresented(int target_id, uint64_t ticket, bool& success);
+
+	// blocks until IsPresented is true, present thread wakes up waiting publishers after every tick
+	bool WaitPresented(int target_id, uint64_t ticket);
+
+	// time DrawFrame took for the last presented frame of target
+	double GetDrawMs(int target_id);
+
+	// present statistics of ticks with at least one new frame
+	uint64_t GetTicksCount();
+	uint64_t GetPresentedFrames();
+	double GetAverageTickMs();
+	double GetMaxTickMs();
+
+private:
+	void PresentThreadFunction();
+
+	struct Slot {
+		int target_id;
+		FrameTarget* target;
+
+		// written by publisher before ticket is published
+		Frame frame;
+		std::atomic<uint64_t> published{ 0 };
+
+		// written by present thread
+		std::atomic<uint64_t> presented{ 0 };
+		std::atomic<bool> success{ true };
+		std::atomic<uint64_t> draw_ns{ 0 };
+		uint64_t drawing = 0;
+	};
+
+	Slot* FindSlot(int target_id);
+
+	std::deque<Slot> slots;
+
+	// presented tickets are stored under it, so waiting publishers don't miss a wake-up
+	std::mutex present_mutex;
+	std::condition_variable present_condition;
+
+	std::thread present_thread;
+	std::atomic_flag keep_presenting = ATOMIC_FLAG_INIT;
+	std::atomic<bool> is_running{ false };
+	std::chrono::steady_clock::duration tick_interval{ 0 };
+
+	std::atomic<uint64_t> ticks_count{ 0 };
+	std::atomic<uint64_t> presented_frames{ 0 };
+	std::atomic<uint64_t> total_tick_ns{ 0 };
+	std::atomic<uint64_t> max_tick_ns{ 0 };
+};
@@ -0,0 +1,56 @@
+#include "DecodeBudget.h"
+
+
+std::mutex DecodeBudget::budget_lock;
+int DecodeBudget::players_count = 0;
+std::atomic<unsigned int> DecodeBudget::budget_version{ 0 };
+
+void DecodeBudget::RegisterPlayer()
+{
+	std::lock_guard<std::mutex> locker(budget_lock);
+
+	++players_count;
+	++budget_version;
+}
+
+void DecodeBudget::UnregisterPlayer()
+{
+	std::lock_guard<std::mutex> locker(budget_lock);
+
+	if (players_count > 0) {
+		--players_count;
+		++budget_version;
+	}
+}
+
+int DecodeBudget::GetThreadsPerDecoder()
+{
+	int cores = GetCoreCount();
+	int players = GetPlayersCount();
+
+	// media loaded without any player (e.g. benchmarks) gets all cores
+	if (players <= 0)
+		return cores;
+
+	int threads = cores / players;
+	return threads > 0 ? threads : 1;
+}
+
+unsigned int DecodeBudget::GetVersion()
+{
+	return budget_version;
+}
+
+int DecodeBudget::GetCoreCount()
+{
+	// hardware_concurrency may return 0 if it isn't computable
+	unsigned int cores = std::thread::hardware_concurrency();
+	return cores > 0 ? (int)cores : 1;
+}
+
+int DecodeBudget::GetPlayersCount()
+{
+	std::lock_guard<std::mutex> locker(budget_lock);
+
+	return players_count;
+}
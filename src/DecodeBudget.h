@@ -0,0 +1,30 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+
+// process-wide split of CPU cores between decoders of all media players
+class DecodeBudget {
+public:
+	DecodeBudget() = delete;
+
+	// every MediaPlayer is registered from SetMedia or StartPlayer till StopPlayer
+	static void RegisterPlayer();
+	static void UnregisterPlayer();
+
+	// number of decoding threads for a single decoder, split between registered players
+	static int GetThreadsPerDecoder();
+
+	// changed by every register and unregister, open decoders compare it to take their new share
+	static unsigned int GetVersion();
+
+	static int GetCoreCount();
+	static int GetPlayersCount();
+
+private:
+	static std::mutex budget_lock;
+	static int players_count;
+	static std::atomic<unsigned int> budget_version;
+};
@@ -1,14 +1,42 @@
 #pragma once
 
 #include <cstdint>
+#include <chrono>
+
+// pixel layout of converted frames
+enum class FrameFormat {
+	BGRA,	// 32 bit, default: rows and pixels are aligned for copying and blitting
+	BGR24	// 24 bit, uses less memory
+};
+
+inline int GetBytesPerPixel(FrameFormat format)
+{
+	return format == FrameFormat::BGR24 ? 3 : 4;
+}
 
 struct Frame {
 	// will be changed by MediaPack
 	uint8_t* frame_buf = nullptr;
 	long original_width = 0, original_height = 0;
-	int linesize = 0;
+	FrameFormat format = FrameFormat::BGRA;
+	int bytes_per_pixel = 4;
+	int linesize = 0;	// stride in bytes
+
+	// presentation time and display duration in seconds
+	double timestamp = 0.0;
+	double duration = 0.0;
+
+	// seconds from the beginning of media, it doesn't grow across loops; playback can be resumed from it
+	double position = 0.0;
+
+	// when MediaPack started to read this frame and time of its stages in milliseconds
+	std::chrono::steady_clock::time_point prepare_start;
+	double demux_ms = 0.0, decode_ms = 0.0, convert_ms = 0.0;
 
 	// will be changed by MediaPlayer
 	long x_offset = 0, y_offset = 0;
 	long crop_width = 0, crop_height = 0;
+
+	// the first frame of switched media: when the switch was requested (zero for other frames)
+	std::chrono::steady_clock::time_point switch_requested;
 };
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "FramePool.h"
+
+extern "C"
+{
+#include <libavutil/mem.h>
+}
+
+#include <cstdint>
+
+// FFmpeg 5 changed sizes of buffers from int to size_t
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+typedef size_t BufferSize;
+#else
+typedef int BufferSize;
+#endif
+
+
+namespace {
+
+	// av_malloc aligns only to what FFmpeg was built for, so alignment is done here
+	void FreeAligned(void* opaque, uint8_t* data)
+	{
+		av_free(opaque);
+	}
+
+	AVBufferRef* AllocateAligned(void* opaque, BufferSize size)
+	{
+		uint8_t* memory = (uint8_t*)av_malloc((size_t)size + FramePool::alignment - 1);
+		if (!memory)
+			return nullptr;
+
+		uintptr_t address = ((uintptr_t)memory + FramePool::alignment - 1) & ~(uintptr_t)(FramePool::alignment - 1);
+
+		AVBufferRef* buffer = av_buffer_create((uint8_t*)address, size, FreeAligned, memory, 0);
+		if (!buffer) {
+			av_free(memory);
+			return nullptr;
+		}
+
+		((std::atomic<size_t>*)opaque)->fetch_add(1, std::memory_order_relaxed);
+
+		return buffer;
+	}
+
+	void FreeCounter(void* opaque)
+	{
+		delete (std::atomic<size_t>*)opaque;
+	}
+}
+
+
+FramePool::~FramePool()
+{
+	Release();
+}
+
+FramePool::FramePool(FramePool&& obj) noexcept :
+	pool(obj.pool), buffer_size(obj.buffer_size), allocated_count(obj.allocated_count)
+{
+	obj.pool = nullptr;
+	obj.buffer_size = 0;
+	obj.allocated_count = nullptr;
+}
+
+bool FramePool::SetBufferSize(size_t size)
+{
+	if (size == 0)
+		return false;
+
+	if (pool && size == buffer_size)
+		return true;
+
+	Release();
+
+	allocated_count = new std::atomic<size_t>(0);
+
+	pool = av_buffer_pool_init2((BufferSize)size, allocated_count, AllocateAligned, FreeCounter);
+	if (!pool) {
+		delete allocated_count;
+		allocated_count = nullptr;
+		return false;
+	}
+
+	buffer_size = size;
+
+	return true;
+}
+
+size_t FramePool::GetBufferSize()
+{
+	return buffer_size;
+}
+
+AVBufferRef* FramePool::Acquire()
+{
+	if (!pool)
+		return nullptr;
+
+	return av_buffer_pool_get(pool);
+}
+
+size_t FramePool::GetAllocatedCount()
+{
+	return allocated_count ? allocated_count->load(std::memory_order_relaxed) : 0;
+}
+
+void FramePool::Release()
+{
+	// buffers which are still used keep the pool alive until they are released
+	if (pool)
+		av_buffer_pool_uninit(&pool);
+
+	allocated_count = nullptr;
+	buffer_size = 0;
+}
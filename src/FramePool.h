@@ -0,0 +1,47 @@
+#pragma once
+
+extern "C"
+{
+#include <libavutil/buffer.h>
+}
+
+#include <atomic>
+#include <cstddef>
+
+
+// Pixel buffers of one size aligned to 64 bytes, so SIMD conversion and copying never split
+// a cache line. Released buffers go back to the pool and are taken again, so restarting player
+// or switching scaling to the same size doesn't allocate. It is built on AVBufferPool:
+// buffers can be acquired and released on any thread and can outlive the pool.
+class FramePool {
+public:
+	static const size_t alignment = 64;
+
+	FramePool() = default;
+
+	~FramePool();
+
+	FramePool(const FramePool& obj) = delete;
+	FramePool& operator=(const FramePool& obj) = delete;
+	FramePool(FramePool&& obj) noexcept;
+	FramePool& operator=(FramePool&& obj) = delete;
+
+	// pool is recreated only for another size, buffers of the old size are freed when they are released
+	bool SetBufferSize(size_t size);
+	size_t GetBufferSize();
+
+	// nullptr if memory can't be allocated, buffer is released by av_buffer_unref
+	AVBufferRef* Acquire();
+
+	// buffers which were really allocated, not taken from the pool
+	size_t GetAllocatedCount();
+
+private:
+	void Release();
+
+	AVBufferPool* pool = nullptr;
+	size_t buffer_size = 0;
+
+	// owned by the pool, it is freed after the last buffer of the pool is released
+	std::atomic<size_t>* allocated_count = nullptr;
+};
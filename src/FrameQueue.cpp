@@ -0,0 +1,132 @@
+#include "FrameQueue.h"
+
+#include <stdexcept>
+
+
+FrameQueue::FrameQueue(size_t depth, FramePool& pool, const Frame& frame_template)
+{
+	if (depth == 0 || pool.GetBufferSize() == 0)
+		throw std::runtime_error("Wrong frame queue params.");
+
+	slots.resize(depth, frame_template);
+	buffers.resize(depth, nullptr);
+
+	for (size_t i = 0; i < depth; ++i) {
+		buffers[i] = pool.Acquire();
+		if (!buffers[i]) {
+			for (auto& buffer : buffers)
+				av_buffer_unref(&buffer);
+
+			throw std::runtime_error("Can't allocate frame queue buffers.");
+		}
+
+		slots[i].frame_buf = buffers[i]->data;
+	}
+}
+
+FrameQueue::FrameQueue(const std::vector<Frame>& external_frames) :
+	slots(external_frames)
+{
+	if (slots.empty())
+		throw std::runtime_error("Wrong frame queue params.");
+
+	for (auto& slot : slots) {
+		if (!slot.frame_buf)
+			throw std::runtime_error("Wrong frame queue buffers.");
+	}
+}
+
+FrameQueue::~FrameQueue()
+{
+	for (auto& buffer : buffers)
+		av_buffer_unref(&buffer);
+}
+
+Frame* FrameQueue::BeginWrite()
+{
+	size_t write_idx = write_count.load(std::memory_order_relaxed);
+	size_t read_idx = read_count.load(std::memory_order_acquire);
+
+	// queue is full
+	if (write_idx - read_idx >= slots.size())
+		return nullptr;
+
+	return &slots[write_idx % slots.size()];
+}
+
+void FrameQueue::EndWrite()
+{
+	write_count.fetch_add(1, std::memory_order_release);
+	Notify();
+}
+
+Frame* FrameQueue::BeginRead()
+{
+	size_t read_idx = read_count.load(std::memory_order_relaxed);
+	size_t write_idx = write_count.load(std::memory_order_acquire);
+
+	// queue is empty
+	if (read_idx == write_idx)
+		return nullptr;
+
+	return &slots[read_idx % slots.size()];
+}
+
+void FrameQueue::EndRead()
+{
+	read_count.fetch_add(1, std::memory_order_release);
+	Notify();
+}
+
+bool FrameQueue::WaitWrite(std::chrono::steady_clock::duration timeout)
+{
+	std::unique_lock<std::mutex> lock(wait_mutex);
+
+	// waiter is registered before it checks counters, pairs with the fence in Notify
+	waiters.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	bool is_free = wait_condition.wait_for(lock, timeout, [this]() { return GetSize() < slots.size(); });
+	waiters.fetch_sub(1, std::memory_order_relaxed);
+
+	return is_free;
+}
+
+bool FrameQueue::WaitRead(std::chrono::steady_clock::duration timeout)
+{
+	std::unique_lock<std::mutex> lock(wait_mutex);
+
+	waiters.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	bool is_ready = wait_condition.wait_for(lock, timeout, [this]() { return GetSize() > 0; });
+	waiters.fetch_sub(1, std::memory_order_relaxed);
+
+	return is_ready;
+}
+
+void FrameQueue::Notify()
+{
+	// counter is changed before waiters are checked: either waiter sees the new counter
+	// or it is seen here and woken up
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiters.load(std::memory_order_relaxed) == 0)
+		return;
+
+	// waiter checks counters under the lock, so it is either before the check or already sleeping
+	{
+		std::lock_guard<std::mutex> lock(wait_mutex);
+	}
+
+	wait_condition.notify_all();
+}
+
+size_t FrameQueue::GetDepth()
+{
+	return slots.size();
+}
+
+size_t FrameQueue::GetSize()
+{
+	return write_count.load(std::memory_order_acquire) - read_count.load(std::memory_order_acquire);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <cstddef>
+
+#include "Frame.h"
+#include "FramePool.h"
+
+
+// Bounded lock-free ring of decoded frames for exactly one producer (decoder thread)
+// and one consumer (present thread). Each slot owns its pixel buffer, so a frame
+// can't be overwritten while it is being drawn. A side which has nothing to do can sleep
+// in WaitWrite/WaitRead, the other side wakes it up by EndRead/EndWrite; the lock is taken
+// only while somebody sleeps.
+class FrameQueue {
+public:
+	FrameQueue() = delete;
+	// buffers are taken from pool and given back to it when queue is destroyed
+	FrameQueue(size_t depth, FramePool& pool, const Frame& frame_template);
+
+	// slots use buffers owned by caller (e.g. monitor's DIB sections), they must outlive queue
+	FrameQueue(const std::vector<Frame>& external_frames);
+
+	~FrameQueue();
+
+	FrameQueue(const FrameQueue& obj) = delete;
+	FrameQueue& operator=(const FrameQueue& obj) = delete;
+	FrameQueue(FrameQueue&& obj) = delete;
+	FrameQueue& operator=(FrameQueue&& obj) = delete;
+
+	// producer: get free slot (nullptr if queue is full) and publish it after filling
+	Frame* BeginWrite();
+	void EndWrite();
+
+	// consumer: get the oldest ready frame (nullptr if queue is empty) and release it after drawing
+	Frame* BeginRead();
+	void EndRead();
+
+	// until a slot is free / a frame is ready or timeout has passed, false on timeout
+	bool WaitWrite(std::chrono::steady_clock::duration timeout);
+	bool WaitRead(std::chrono::steady_clock::duration timeout);
+
+	size_t GetDepth();
+	size_t GetSize();
+
+private:
+	// sides sleeping in WaitWrite/WaitRead, nobody is notified while it is zero
+	std::mutex wait_mutex;
+	std::condition_variable wait_condition;
+	std::atomic<int> waiters{ 0 };
+	void Notify();
+
+	std::vector<Frame> slots;
+
+	// buffers from pool (empty for external buffers)
+	std::vector<AVBufferRef*> buffers;
+
+	// monotonic counters, slot index is counter % depth
+	alignas(64) std::atomic<size_t> write_count{ 0 };
+	alignas(64) std::atomic<size_t> read_count{ 0 };
+};
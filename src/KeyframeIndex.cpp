@@ -0,0 +1,108 @@
+#include "KeyframeIndex.h"
+
+#include <algorithm>
+
+// FFmpeg 4.4 hid index entries of a stream behind functions
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+#define INDEX_ENTRIES_COUNT(stream) avformat_index_get_entries_count(stream)
+#define INDEX_ENTRY(stream, i) avformat_index_get_entry(stream, i)
+#else
+#define INDEX_ENTRIES_COUNT(stream) ((stream)->nb_index_entries)
+#define INDEX_ENTRY(stream, i) (&(stream)->index_entries[i])
+#endif
+
+
+void KeyframeIndex::Add(int64_t pts, int64_t pos)
+{
+	// keyframes are mostly read in order
+	if (keyframes.empty() || keyframes.back().pts < pts) {
+		keyframes.push_back({ pts, pos });
+		return;
+	}
+
+	auto it = std::lower_bound(keyframes.begin(), keyframes.end(), pts,
+		[](const Keyframe& keyframe, int64_t value) { return keyframe.pts < value; });
+
+	// keyframe of the next loop or after seek is already known
+	if (it != keyframes.end() && it->pts == pts) {
+		if (it->pos < 0)
+			it->pos = pos;
+
+		return;
+	}
+
+	keyframes.insert(it, { pts, pos });
+}
+
+void KeyframeIndex::Clear()
+{
+	keyframes.clear();
+	is_complete = false;
+}
+
+void KeyframeIndex::AddStreamIndex(AVStream* stream)
+{
+	// index of MP4 is complete after the header, MKV has it if cues were read
+	int entries_count = INDEX_ENTRIES_COUNT(stream);
+	for (int i = 0; i < entries_count; ++i) {
+		const AVIndexEntry* index_entry = INDEX_ENTRY(stream, i);
+		if (index_entry && (index_entry->flags & AVINDEX_KEYFRAME))
+			Add(index_entry->timestamp, index_entry->pos);
+	}
+}
+
+bool KeyframeIndex::FindPreceding(int64_t pts, Keyframe& keyframe)
+{
+	auto it = std::upper_bound(keyframes.begin(), keyframes.end(), pts,
+		[](int64_t value, const Keyframe& keyframe) { return value < keyframe.pts; });
+
+	if (it == keyframes.begin())
+		return false;
+
+	keyframe = *(it - 1);
+
+	return true;
+}
+
+bool KeyframeIndex::GetLast(Keyframe& keyframe)
+{
+	if (keyframes.empty())
+		return false;
+
+	keyframe = keyframes.back();
+
+	return true;
+}
+
+void KeyframeIndex::SetComplete(bool complete)
+{
+	is_complete = complete;
+}
+
+bool KeyframeIndex::IsComplete()
+{
+	return is_complete;
+}
+
+size_t KeyframeIndex::GetCount()
+{
+	return keyframes.size();
+}
+
+const std::vector<KeyframeIndex::Keyframe>& KeyframeIndex::GetKeyframes()
+{
+	return keyframes;
+}
+
+int KeyframeIndex::GetStreamIndexSize(AVStream* stream)
+{
+	return INDEX_ENTRIES_COUNT(stream);
+}
+
+void KeyframeIndex::FillStreamIndex(AVStream* stream, const std::vector<Keyframe>& stream_keyframes)
+{
+	for (const Keyframe& keyframe : stream_keyframes) {
+		if (keyframe.pos >= 0)
+			av_add_index_entry(stream, keyframe.pos, keyframe.pts, 0, 0, AVINDEX_KEYFRAME);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Keyframes of video stream sorted by presentation timestamps, so seek can start decoding from the
+// nearest preceding keyframe. It is filled by keyframes read while playing or by a packet-only scan,
+// complete index of the whole stream is kept in probe cache.
+class KeyframeIndex {
+public:
+	struct Keyframe {
+		int64_t pts;	// in stream time base
+		int64_t pos;	// byte position in the file, -1 if unknown
+	};
+
+	void Add(int64_t pts, int64_t pos);
+	void Clear();
+
+	// keyframes of container's own index of the stream (MP4 sample table, MKV cues)
+	void AddStreamIndex(AVStream* stream);
+
+	// the last keyframe at or before pts, false if there is no such keyframe
+	bool FindPreceding(int64_t pts, Keyframe& keyframe);
+
+	// the last known keyframe, false if index is empty
+	bool GetLast(Keyframe& keyframe);
+
+	// every keyframe of the stream was added
+	void SetComplete(bool complete);
+	bool IsComplete();
+
+	size_t GetCount();
+	const std::vector<Keyframe>& GetKeyframes();
+
+	// entries of container's index, demuxer seeks by them
+	static int GetStreamIndexSize(AVStream* stream);
+
+	// keyframes with known positions are added to container's index, so demuxer seeks to them
+	// without searching the file
+	static void FillStreamIndex(AVStream* stream, const std::vector<Keyframe>& stream_keyframes);
+
+private:
+	std::vector<Keyframe> keyframes;
+	bool is_complete = false;
+};
@@ -0,0 +1,156 @@
+#include "LoopCache.h"
+
+extern "C"
+{
+#include <libavutil/mem.h>
+}
+
+#include <cstring>
+
+
+// size of one arena block
+static const size_t block_size = 64 * 1024 * 1024;
+
+LoopCache::~LoopCache()
+{
+	FreeBlocks();
+}
+
+void LoopCache::Reset(size_t budget, long row_size, long height)
+{
+	Clear();
+
+	this->budget = budget;
+	this->row_size = row_size;
+	this->height = height;
+
+	frame_size = GetFrameSize(row_size, height);
+
+	frames_per_block = frame_size > 0 ? block_size / frame_size : 0;
+	if (frames_per_block == 0)
+		frames_per_block = 1;
+}
+
+size_t LoopCache::GetFrameSize(long row_size, long height)
+{
+	// rows are aligned for fast copying
+	long cached_stride = (row_size + 63) & ~63;
+
+	return (size_t)cached_stride * height;
+}
+
+void LoopCache::Clear()
+{
+	FreeBlocks();
+	entries.clear();
+}
+
+bool LoopCache::AddFrame(const uint8_t* src, int src_stride, const Entry& params)
+{
+	if (frame_size == 0 || !src)
+		return false;
+
+	// new block is needed
+	if (blocks.empty() || last_block_used == blocks.back().capacity) {
+		size_t capacity = (budget - allocated_size) / frame_size;
+		if (capacity > frames_per_block)
+			capacity = frames_per_block;
+
+		// budget is over
+		if (capacity == 0)
+			return false;
+
+		uint8_t* data = (uint8_t*)av_malloc(capacity * frame_size);
+		if (!data)
+			return false;
+
+		blocks.push_back({ data, capacity });
+		allocated_size += capacity * frame_size;
+		last_block_used = 0;
+	}
+
+	Entry entry = params;
+	entry.data = blocks.back().data + last_block_used * frame_size;
+
+	long cached_stride = (row_size + 63) & ~63;
+	for (long row = 0; row < height; ++row)
+		std::memcpy(entry.data + (size_t)cached_stride * row, src + (size_t)src_stride * row, row_size);
+
+	entries.push_back(entry);
+	++last_block_used;
+
+	return true;
+}
+
+bool LoopCache::CopyFrame(size_t index, uint8_t* dst, int dst_stride)
+{
+	if (index >= entries.size() || !dst)
+		return false;
+
+	long cached_stride = (row_size + 63) & ~63;
+	const uint8_t* src = entries[index].data;
+	for (long row = 0; row < height; ++row)
+		std::memcpy(dst + (size_t)dst_stride * row, src + (size_t)cached_stride * row, row_size);
+
+	return true;
+}
+
+bool LoopCache::TrimToLastKeyframe(int64_t& resume_pts)
+{
+	size_t keyframe_idx = 0;
+	for (size_t i = entries.size(); i > 1; --i) {
+		if (entries[i - 1].is_keyframe) {
+			keyframe_idx = i - 1;
+			break;
+		}
+	}
+
+	if (keyframe_idx == 0) {
+		Clear();
+		return false;
+	}
+
+	resume_pts = entries[keyframe_idx].pts;
+	entries.resize(keyframe_idx);
+
+	// free blocks which aren't used anymore
+	size_t kept_frames = 0;
+	size_t used_blocks = 0;
+	while (used_blocks < blocks.size() && kept_frames < entries.size())
+		kept_frames += blocks[used_blocks++].capacity;
+
+	while (blocks.size() > used_blocks) {
+		av_free(blocks.back().data);
+		allocated_size -= blocks.back().capacity * frame_size;
+		blocks.pop_back();
+	}
+
+	last_block_used = blocks.empty() ? 0 : blocks.back().capacity - (kept_frames - entries.size());
+
+	return true;
+}
+
+size_t LoopCache::GetFramesCount()
+{
+	return entries.size();
+}
+
+const LoopCache::Entry& LoopCache::GetFrame(size_t index)
+{
+	return entries[index];
+}
+
+size_t LoopCache::GetUsedMemory()
+{
+	return allocated_size;
+}
+
+void LoopCache::FreeBlocks()
+{
+	for (auto& block : blocks)
+		av_free(block.data);
+
+	blocks.clear();
+	last_block_used = 0;
+	allocated_size = 0;
+}
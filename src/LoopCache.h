@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+
+// Converted frames of the first playback loop, stored in a dedicated arena
+// limited by memory budget. Later loops are played from memory without decoding.
+class LoopCache {
+public:
+	struct Entry {
+		uint8_t* data;
+		double timestamp, duration;	// seconds from loop start
+		int64_t pts;				// stream timestamp, used to resume decoding
+		bool is_keyframe;
+	};
+
+	LoopCache() = default;
+
+	~LoopCache();
+
+	LoopCache(const LoopCache& obj) = delete;
+	LoopCache& operator=(const LoopCache& obj) = delete;
+	LoopCache(LoopCache&& obj) = delete;
+	LoopCache& operator=(LoopCache&& obj) = delete;
+
+	// drop all frames and set frames geometry, row_size is size of pixels row without padding
+	void Reset(size_t budget, long row_size, long height);
+	void Clear();
+
+	// copy frame into arena, returns false if budget is over
+	bool AddFrame(const uint8_t* src, int src_stride, const Entry& params);
+
+	// copy cached frame to destination buffer
+	bool CopyFrame(size_t index, uint8_t* dst, int dst_stride);
+
+	// keep only frames before the last cached keyframe (except the first frame),
+	// so decoding can be resumed from that keyframe; returns false if nothing is left
+	bool TrimToLastKeyframe(int64_t& resume_pts);
+
+	// memory used by one cached frame
+	static size_t GetFrameSize(long row_size, long height);
+
+	size_t GetFramesCount();
+	const Entry& GetFrame(size_t index);
+	size_t GetUsedMemory();
+
+private:
+	void FreeBlocks();
+
+	size_t budget = 0;
+	long row_size = 0, height = 0;
+	size_t frame_size = 0;
+
+	// arena is allocated by blocks of several frames, only when they are needed
+	struct Block {
+		uint8_t* data;
+		size_t capacity;	// in frames
+	};
+	std::vector<Block> blocks;
+	size_t frames_per_block = 0;
+	size_t last_block_used = 0;
+	size_t allocated_size = 0;
+
+	std::vector<Entry> entries;
+};
@@ -4,6 +4,10 @@
 #include <deque>
 
 #include "MediaPlayer.h"
+#include "Monitor.h"
+#include "SystemLoad.h"
+#include "MetricsExporter.h"
+#include "Tracer.h"
 
 // https://github.com/FFMS/ffms2
 // ffmpeg easy lib
@@ -18,9 +22,40 @@ int main()
 		return 1;
 	}
 
+	// the only thread which draws on monitors
+	Compositor compositor;
+	for (auto& monitor : Monitor::monitors) {
+		compositor.AddTarget(monitor.monitor_id, &monitor);
+	}
+
+	if (!compositor.Start(Monitor::GetRefreshRate())) {
+		std::cout << "Can't start compositor." << std::endl;
+		return 1;
+	}
+
 	std::deque<MediaPlayer> media_players;
 	for (auto& monitor : Monitor::monitors) {
-		media_players.emplace_back(monitor);
+		media_players.emplace_back(monitor, compositor);
+	}
+
+	// every player can be paused, other policies are chosen by user
+	std::shared_ptr<SystemLoadSource> system_load = std::make_shared<SystemLoadSource>();
+	std::vector<std::shared_ptr<PausePolicy>> pause_policies;
+	for (auto& player : media_players) {
+		pause_policies.push_back(std::make_shared<PausePolicy>());
+		player.SetPlaybackPolicy(pause_policies.back());
+	}
+
+	// wallpaper continues where it was stopped last time, its cached frame is shown at once
+	for (auto& player : media_players) {
+		player.SetResume(true);
+		player.SetPoster(true);
+	}
+
+	// metrics of all players can be written to a file periodically
+	MetricsExporter metrics_exporter;
+	for (auto& player : media_players) {
+		metrics_exporter.AddSource(player.GetMonitorID(), &player.GetMetrics());
 	}
 
 
@@ -29,6 +64,19 @@ int main()
 		std::cout << "Choose option:" << std::endl;
 		std::cout << "   1. Play video on monitor." << std::endl;
 		std::cout << "   2. Stop playing." << std::endl;
+		std::cout << "   3. Play the same video on all monitors." << std::endl;
+		std::cout << "   4. Bake video for monitor." << std::endl;
+		std::cout << "   5. Limit frame rate for monitor." << std::endl;
+		std::cout << "   6. Pause/resume monitor." << std::endl;
+		std::cout << "   7. Show playback metrics." << std::endl;
+		std::cout << "   8. " << (metrics_exporter.IsRunning() ? "Stop exporting metrics." : "Export metrics to file.") << std::endl;
+#ifdef DW_TRACING
+		std::cout << "   9. " << (Tracer::IsEnabled() ? "Stop tracing and save timeline." : "Start tracing.") << std::endl;
+#endif
+		std::cout << "   11. Play playlist on monitor." << std::endl;
+		std::cout << "   12. Switch video on monitor without stopping." << std::endl;
+		std::cout << "   13. Seek video on monitor." << std::endl;
+		// exit keeps its number, new options are added after the last one
 		std::cout << "   10. Exit." << std::endl;
 
 		int option = 0;
@@ -62,6 +110,17 @@ int main()
 				continue;
 			}
 
+			// monitor can be used by another player as a mirror
+			for (auto& player : media_players) {
+				player.RemoveMirror(input_id);
+			}
+
+			// new media is only for the selected monitor
+			media_players[found_id].StopPlayer();
+			for (auto& monitor : Monitor::monitors) {
+				media_players[found_id].RemoveMirror(monitor.monitor_id);
+			}
+
 			std::cout << std::endl << "Enter path to media file: ";
 
 			std::string path_to_media;
@@ -73,15 +132,31 @@ int main()
 			}
 			catch (std::exception & exception) {
 				std::cout << "Failed to load. " << exception.what() << std::endl;
+				system("pause");
+				continue;
+			}
+
+			if (!media_players[found_id].SetMedia(std::move(media))) {
+				std::cout << "Failed to load." << std::endl;
+				system("pause");
+				continue;
 			}
 
-			media_players[found_id].SetMedia(std::move(media));
 			media_players[found_id].SetScaling();
 
 			std::string loop_choice;
 			std::cout << "Loop video (y/n) ?" << std::endl;
 			std::cin >> loop_choice;
 
+			// short loops can be played from memory without decoding
+			if (loop_choice[0] == 'y') {
+				size_t cache_mb = 0;
+				std::cout << "Loop cache size in MB (0 - disabled):" << std::endl;
+				std::cin >> cache_mb;
+
+				media_players[found_id].SetLoopCache(cache_mb * 1024 * 1024);
+			}
+
 			media_players[found_id].StartPlayer(loop_choice[0] == 'y' ? true : false);
 		}
 
@@ -111,7 +186,403 @@ int main()
 				continue;
 			}
 
+			// stop player which shows its frames on this monitor too
+			for (auto& player : media_players) {
+				if (player.HasMirror(input_id))
+					player.StopPlayer();
+			}
+
+			media_players[found_id].StopPlayer();
+		}
+
+		// play the same media on all monitors, decoding it only once
+		if (option == 3) {
+			if (media_players.empty()) {
+				std::cout << "Can't find player." << std::endl;
+				continue;
+			}
+
+			std::cout << std::endl << "Enter path to media file: ";
+
+			std::string path_to_media;
+			std::cin >> path_to_media;
+
+			std::unique_ptr<MediaPack> media;
+			try {
+				media = std::make_unique<MediaPack>(path_to_media);
+			}
+			catch (std::exception& exception) {
+				std::cout << "Failed to load. " << exception.what() << std::endl;
+				continue;
+			}
+
+			for (auto& player : media_players) {
+				player.StopPlayer();
+
+				for (auto& monitor : Monitor::monitors) {
+					player.RemoveMirror(monitor.monitor_id);
+				}
+			}
+
+			// the first player decodes media, other monitors are its mirrors
+			MediaPlayer& shared_player = media_players[0];
+			for (auto& monitor : Monitor::monitors) {
+				if (monitor.monitor_id != shared_player.GetMonitorID())
+					shared_player.AddMirror(monitor);
+			}
+
+			shared_player.SetMedia(std::move(media));
+			shared_player.SetScaling();
+
+			std::string loop_choice;
+			std::cout << "Loop video (y/n) ?" << std::endl;
+			std::cin >> loop_choice;
+
+			// short loops can be played from memory without decoding
+			if (loop_choice[0] == 'y') {
+				size_t cache_mb = 0;
+				std::cout << "Loop cache size in MB (0 - disabled):" << std::endl;
+				std::cin >> cache_mb;
+
+				shared_player.SetLoopCache(cache_mb * 1024 * 1024);
+			}
+
+			shared_player.StartPlayer(loop_choice[0] == 'y' ? true : false);
+		}
+
+		// decode media once into a file, which is played without decoding
+		if (option == 4) {
+			std::cout << std::endl << "Select monitor by ID." << std::endl;
+
+			for (size_t i = 0; i < Monitor::monitors.size(); i++) {
+				std::cout << "   ID: " << Monitor::monitors[i].monitor_id << ". Is primary: " << (Monitor::monitors[i].is_primary ? "yes" : "no") << std::endl;
+			}
+
+			int input_id = -1;
+			std::cout << std::endl << "ID: ";
+			std::cin >> input_id;
+
+			if (input_id < 0 || input_id >= Monitor::monitors.size()) {
+				std::cout << "Wrong ID." << std::endl;
+				continue;
+			}
+
+			int found_id = -1;
+			for (int i = 0; i < media_players.size(); i++) {
+				if (media_players[i].GetMonitorID() == input_id)
+					found_id = i;
+			}
+
+			if (found_id == -1) {
+				std::cout << "Can't find player." << std::endl;
+				continue;
+			}
+
+			// player of this monitor is used for baking
+			for (auto& player : media_players) {
+				if (player.HasMirror(input_id))
+					player.StopPlayer();
+			}
+
+			media_players[found_id].StopPlayer();
+
+			std::cout << std::endl << "Enter path to media file: ";
+
+			std::string path_to_media;
+			std::cin >> path_to_media;
+
+			std::cout << "Enter path to baked file: ";
+
+			std::string path_to_baked;
+			std::cin >> path_to_baked;
+
+			std::unique_ptr<MediaPack> media;
+			try {
+				media = std::make_unique<MediaPack>(path_to_media);
+			}
+			catch (std::exception& exception) {
+				std::cout << "Failed to load. " << exception.what() << std::endl;
+				continue;
+			}
+
+			media_players[found_id].SetMedia(std::move(media));
+			media_players[found_id].SetScaling();
+
+			size_t frames_count = 0;
+			if (media_players[found_id].BakeMedia(path_to_baked, frames_count))
+				std::cout << "Baked " << frames_count << " frames. Play " << path_to_baked << " as usual media file." << std::endl;
+			else
+				std::cout << "Failed to bake." << std::endl;
+
+			system("pause");
+		}
+
+		// frame rate limits of player
+		if (option == 5 || option == 6) {
+			std::cout << std::endl << "Select monitor by ID." << std::endl;
+
+			for (size_t i = 0; i < Monitor::monitors.size(); i++) {
+				std::cout << "   ID: " << Monitor::monitors[i].monitor_id << ". Is primary: " << (Monitor::monitors[i].is_primary ? "yes" : "no") << std::endl;
+			}
+
+			int input_id = -1;
+			std::cout << std::endl << "ID: ";
+			std::cin >> input_id;
+
+			if (input_id < 0 || input_id >= Monitor::monitors.size()) {
+				std::cout << "Wrong ID." << std::endl;
+				continue;
+			}
+
+			int found_id = -1;
+			for (int i = 0; i < media_players.size(); i++) {
+				if (media_players[i].GetMonitorID() == input_id)
+					found_id = i;
+			}
+
+			if (found_id == -1) {
+				std::cout << "Can't find player." << std::endl;
+				continue;
+			}
+
+			// pause is switched without restarting player
+			if (option == 6) {
+				pause_policies[found_id]->SetPaused(!pause_policies[found_id]->IsPaused());
+				continue;
+			}
+
+			double max_fps = 0.0;
+			std::cout << "Max fps (0 - not limited):" << std::endl;
+			std::cin >> max_fps;
+
+			std::string throttle_choice;
+			std::cout << "Halve frame rate under high CPU load (y/n) ?" << std::endl;
+			std::cin >> throttle_choice;
+
+			std::shared_ptr<CombinedPolicy> policy = std::make_shared<CombinedPolicy>();
+			policy->AddPolicy(pause_policies[found_id]);
+
+			if (max_fps > 0.0)
+				policy->AddPolicy(std::make_shared<FpsCapPolicy>(max_fps));
+
+			if (throttle_choice[0] == 'y')
+				policy->AddPolicy(std::make_shared<LoadThrottlePolicy>(system_load));
+
+			media_players[found_id].SetPlaybackPolicy(policy);
+		}
+
+		// per-stage timing of every player
+		if (option == 7) {
+			for (auto& player : media_players) {
+				MetricsSnapshot snapshot = player.GetMetrics().GetSnapshot();
+
+				std::cout << std::endl << "Monitor ID: " << player.GetMonitorID() << (player.IsPlaying() ? "" : " (stopped)") << std::endl;
+				std::cout << "   frames presented: " << snapshot.presented_frames << ", dropped: " << snapshot.dropped_frames
+					<< ", late: " << snapshot.late_frames << ", duplicated: " << snapshot.duplicated_frames
+					<< ", throttled: " << snapshot.throttled_frames << std::endl;
+				std::cout << "   changed part of frames: " << std::fixed << std::setprecision(3) << snapshot.dirty_ratio
+					<< ", unchanged frames not presented: " << snapshot.skipped_frames << std::endl;
+
+				std::cout << "   " << std::left << std::setw(14) << "stage, ms" << std::setw(10) << "mean" << std::setw(10) << "p50"
+					<< std::setw(10) << "p90" << std::setw(10) << "p99" << "max" << std::endl;
+
+				auto print_stage = [](const char* name, const LatencyHistogram::Snapshot& stage) {
+					std::cout << "   " << std::left << std::setw(14) << name << std::fixed << std::setprecision(3)
+						<< std::setw(10) << stage.mean_ms << std::setw(10) << stage.p50_ms << std::setw(10) << stage.p90_ms
+						<< std::setw(10) << stage.p99_ms << stage.max_ms << std::endl;
+				};
+
+				print_stage("demux", snapshot.demux);
+				print_stage("decode", snapshot.decode);
+				print_stage("convert", snapshot.convert);
+				print_stage("copy/blit", snapshot.copy);
+				print_stage("sleep jitter", snapshot.sleep_jitter);
+				print_stage("packet queue", snapshot.packet_queue);
+
+				print_stage("media switch", snapshot.media_switch);
+
+				std::cout << "   packet queue: " << snapshot.packet_queue_packets << " packets, "
+					<< snapshot.packet_queue_bytes / 1024 << " KB, demuxer underruns: " << snapshot.demuxer_underruns
+					<< ", media switches: " << snapshot.media_switch.count << std::endl;
+			}
+
+			system("pause");
+		}
+
+		// JSON lines with metrics of all players
+		if (option == 8) {
+			if (metrics_exporter.IsRunning()) {
+				metrics_exporter.Stop();
+				continue;
+			}
+
+			std::cout << std::endl << "Enter path to metrics file: ";
+
+			std::string path_to_metrics;
+			std::cin >> path_to_metrics;
+
+			int interval_seconds = 0;
+			std::cout << "Export interval in seconds:" << std::endl;
+			std::cin >> interval_seconds;
+
+			if (!metrics_exporter.Start(path_to_metrics, std::chrono::seconds(interval_seconds))) {
+				std::cout << "Can't export metrics." << std::endl;
+				system("pause");
+			}
+		}
+
+#ifdef DW_TRACING
+		// timeline of all threads for chrome://tracing or ui.perfetto.dev
+		if (option == 9) {
+			if (!Tracer::IsEnabled()) {
+				Tracer::Start();
+				continue;
+			}
+
+			Tracer::Stop();
+
+			std::cout << std::endl << "Enter path to trace file: ";
+
+			std::string path_to_trace;
+			std::cin >> path_to_trace;
+
+			if (!Tracer::WriteChromeTrace(path_to_trace)) {
+				std::cout << "Can't write trace." << std::endl;
+				system("pause");
+			}
+		}
+#endif
+
+		// media files one after another, the next one is opened while the current one is playing
+		if (option == 11 || option == 12) {
+			std::cout << std::endl << "Select monitor by ID." << std::endl;
+
+			for (size_t i = 0; i < Monitor::monitors.size(); i++) {
+				std::cout << "   ID: " << Monitor::monitors[i].monitor_id << ". Is primary: " << (Monitor::monitors[i].is_primary ? "yes" : "no") << std::endl;
+			}
+
+			int input_id = -1;
+			std::cout << std::endl << "ID: ";
+			std::cin >> input_id;
+
+			if (input_id < 0 || input_id >= Monitor::monitors.size()) {
+				std::cout << "Wrong ID." << std::endl;
+				continue;
+			}
+
+			int found_id = -1;
+			for (int i = 0; i < media_players.size(); i++) {
+				if (media_players[i].GetMonitorID() == input_id)
+					found_id = i;
+			}
+
+			if (found_id == -1) {
+				std::cout << "Can't find player." << std::endl;
+				continue;
+			}
+
+			// media is replaced at a frame boundary, the wallpaper isn't blanked
+			if (option == 12) {
+				std::cout << std::endl << "Enter path to media file: ";
+
+				std::string path_to_media;
+				std::cin >> path_to_media;
+
+				bool was_playing = media_players[found_id].IsPlaying();
+				if (!media_players[found_id].SwitchMedia(path_to_media)) {
+					std::cout << "Failed to load." << std::endl;
+					system("pause");
+					continue;
+				}
+
+				if (!was_playing)
+					media_players[found_id].StartPlayer(true);
+
+				continue;
+			}
+
+			size_t items_count = 0;
+			std::cout << std::endl << "Number of media files:" << std::endl;
+			std::cin >> items_count;
+
+			Playlist playlist;
+			for (size_t i = 0; i < items_count; i++) {
+				std::cout << "Enter path to media file " << i + 1 << ": ";
+
+				std::string path_to_media;
+				std::cin >> path_to_media;
+
+				playlist.AddItem(path_to_media);
+			}
+
+			double rotation_seconds = 0.0;
+			size_t rotation_loops = 0;
+			std::cout << "Switch after seconds (0 - not limited):" << std::endl;
+			std::cin >> rotation_seconds;
+			std::cout << "Switch after loops (0 - not limited):" << std::endl;
+			std::cin >> rotation_loops;
+
+			if (!playlist.SetRotation(rotation_seconds, rotation_loops)) {
+				std::cout << "Wrong rotation." << std::endl;
+				system("pause");
+				continue;
+			}
+
+			// monitor can be used by another player as a mirror
+			for (auto& player : media_players) {
+				player.RemoveMirror(input_id);
+			}
+
 			media_players[found_id].StopPlayer();
+			for (auto& monitor : Monitor::monitors) {
+				media_players[found_id].RemoveMirror(monitor.monitor_id);
+			}
+
+			if (!media_players[found_id].SetPlaylist(playlist)) {
+				std::cout << "Failed to load." << std::endl;
+				system("pause");
+				continue;
+			}
+
+			media_players[found_id].SetScaling();
+			media_players[found_id].StartPlayer(true);
+		}
+
+		if (option == 13) {
+			std::cout << std::endl << "Select monitor by ID." << std::endl;
+
+			for (size_t i = 0; i < Monitor::monitors.size(); i++) {
+				std::cout << "   ID: " << Monitor::monitors[i].monitor_id << ". Is primary: " << (Monitor::monitors[i].is_primary ? "yes" : "no") << std::endl;
+			}
+
+			int input_id = -1;
+			std::cout << std::endl << "ID: ";
+			std::cin >> input_id;
+
+			if (input_id < 0 || input_id >= Monitor::monitors.size()) {
+				std::cout << "Wrong ID." << std::endl;
+				continue;
+			}
+
+			int found_id = -1;
+			for (int i = 0; i < media_players.size(); i++) {
+				if (media_players[i].GetMonitorID() == input_id)
+					found_id = i;
+			}
+
+			if (found_id == -1) {
+				std::cout << "Can't find player." << std::endl;
+				continue;
+			}
+
+			double position = 0.0;
+			std::cout << "Position in seconds:" << std::endl;
+			std::cin >> position;
+
+			if (!media_players[found_id].Seek(position)) {
+				std::cout << "Failed to seek." << std::endl;
+				system("pause");
+			}
 		}
 
 		// exit
@@ -120,6 +591,19 @@ int main()
 		}
 	}
 
+	// exporter reads metrics of players, players must stop before compositor
+	metrics_exporter.Stop();
+	media_players.clear();
+	compositor.Stop();
+
+#ifdef DW_TRACING
+	// tracing wasn't stopped by user - timeline is saved next to the application
+	if (Tracer::IsEnabled()) {
+		Tracer::Stop();
+		Tracer::WriteChromeTrace("trace.json");
+	}
+#endif
+
 	Monitor::Finilize();
 
 	return 0;
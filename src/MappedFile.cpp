@@ -0,0 +1,123 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	file_handle = file;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0) {
+		Close();
+		return false;
+	}
+
+	mapping_handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping_handle) {
+		Close();
+		return false;
+	}
+
+	data = (const uint8_t*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		Close();
+		return false;
+	}
+
+	size = file_size.QuadPart;
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	data = nullptr;
+	size = 0;
+
+	if (mapping_handle)
+		CloseHandle(mapping_handle);
+	mapping_handle = nullptr;
+
+	if (file_handle)
+		CloseHandle(file_handle);
+	file_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	file_descriptor = open(path.c_str(), O_RDONLY);
+	if (file_descriptor < 0)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(file_descriptor, &file_stat) != 0 || file_stat.st_size <= 0) {
+		Close();
+		return false;
+	}
+
+	void* view = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+	if (view == MAP_FAILED) {
+		Close();
+		return false;
+	}
+
+	data = (const uint8_t*)view;
+	size = (uint64_t)file_stat.st_size;
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		munmap(const_cast<uint8_t*>(data), (size_t)size);
+	data = nullptr;
+	size = 0;
+
+	if (file_descriptor >= 0)
+		close(file_descriptor);
+	file_descriptor = -1;
+}
+
+#endif
+
+bool MappedFile::IsOpen()
+{
+	return data != nullptr;
+}
+
+const uint8_t* MappedFile::GetData()
+{
+	return data;
+}
+
+uint64_t MappedFile::GetSize()
+{
+	return size;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+
+// Read-only memory mapping of a whole file: file mapping object on Windows, mmap elsewhere.
+// Pages of the same file are shared by all processes which map it.
+class MappedFile {
+public:
+	MappedFile() = default;
+
+	~MappedFile();
+
+	MappedFile(const MappedFile& obj) = delete;
+	MappedFile& operator=(const MappedFile& obj) = delete;
+	MappedFile(MappedFile&& obj) = delete;
+	MappedFile& operator=(MappedFile&& obj) = delete;
+
+	// empty files can't be mapped
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen();
+	const uint8_t* GetData();
+	uint64_t GetSize();
+
+private:
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#else
+	int file_descriptor = -1;
+#endif
+
+	const uint8_t* data = nullptr;
+	uint64_t size = 0;
+};
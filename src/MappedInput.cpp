@@ -0,0 +1,202 @@
+#include "MappedInput.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+// buffer of AVIOContext, bigger reads of packets go around it straight from view
+static const size_t context_buffer_size = 64 * 1024;
+
+// allocation granularity of Windows, a multiple of page size everywhere
+static const size_t view_alignment = 64 * 1024;
+static const size_t page_size = 4096;
+
+
+MappedInput::~MappedInput()
+{
+	Close();
+}
+
+bool MappedInput::Open(const std::string& path, size_t view_size, size_t prefetch_size)
+{
+	Close();
+
+	if (view_size == 0)
+		return false;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	file_handle = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+		Close();
+		return false;
+	}
+
+	file_size = (uint64_t)size.QuadPart;
+
+	mapping_handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping_handle) {
+		Close();
+		return false;
+	}
+#else
+	file_descriptor = open(path.c_str(), O_RDONLY);
+	if (file_descriptor < 0)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(file_descriptor, &file_stat) != 0 || file_stat.st_size <= 0) {
+		Close();
+		return false;
+	}
+
+	file_size = (uint64_t)file_stat.st_size;
+#endif
+
+	max_view_size = (view_size + view_alignment - 1) / view_alignment * view_alignment;
+	this->prefetch_size = prefetch_size;
+
+	// the first view is mapped here, so a file which can't be mapped falls back to other input
+	if (!MapView(0) || !CreateContext(context_buffer_size)) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+int MappedInput::Read(uint8_t* buffer, int size)
+{
+	if (position < view_start || position >= view_start + view_size) {
+		if (!MapView(position))
+			return AVERROR(EIO);
+	}
+
+	Prefetch();
+
+	size_t available = (size_t)(view_start + view_size - position);
+	size_t copied = std::min((size_t)size, available);
+	std::memcpy(buffer, view + (position - view_start), copied);
+
+	bytes_read += copied;
+
+	return (int)copied;
+}
+
+bool MappedInput::Seek(uint64_t new_position)
+{
+	// view is moved only when position leaves it
+	return new_position <= file_size;
+}
+
+void MappedInput::Close()
+{
+	UnmapView();
+
+#ifdef _WIN32
+	if (mapping_handle)
+		CloseHandle(mapping_handle);
+	mapping_handle = nullptr;
+
+	if (file_handle)
+		CloseHandle(file_handle);
+	file_handle = nullptr;
+#else
+	if (file_descriptor >= 0)
+		close(file_descriptor);
+	file_descriptor = -1;
+#endif
+}
+
+bool MappedInput::MapView(uint64_t offset)
+{
+	UnmapView();
+
+	uint64_t start = offset - offset % view_alignment;
+	if (start >= file_size)
+		return false;
+
+	size_t size = (size_t)std::min<uint64_t>(max_view_size, file_size - start);
+
+#ifdef _WIN32
+	view = (const uint8_t*)MapViewOfFile(mapping_handle, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)start, size);
+	if (!view)
+		return false;
+#else
+	void* mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, file_descriptor, (off_t)start);
+	if (mapped == MAP_FAILED)
+		return false;
+
+	view = (const uint8_t*)mapped;
+
+	// kernel reads ahead more aggressively and drops pages behind
+	madvise(mapped, size, MADV_SEQUENTIAL);
+#endif
+
+	view_start = start;
+	view_size = size;
+	++read_calls;
+
+	return true;
+}
+
+void MappedInput::UnmapView()
+{
+	if (view) {
+#ifdef _WIN32
+		UnmapViewOfFile(view);
+#else
+		munmap(const_cast<uint8_t*>(view), view_size);
+#endif
+	}
+
+	view = nullptr;
+	view_start = 0;
+	view_size = 0;
+	prefetched_start = 0;
+	prefetched_end = 0;
+}
+
+void MappedInput::Prefetch()
+{
+	if (prefetch_size == 0)
+		return;
+
+	uint64_t view_end = view_start + view_size;
+
+	// the next range is requested when less than half of it is left ahead of position
+	bool inside = position >= prefetched_start && position < prefetched_end;
+	if (inside && (prefetched_end >= view_end || prefetched_end - position > prefetch_size / 2))
+		return;
+
+	uint64_t start = inside ? prefetched_end : position - position % page_size;
+	uint64_t end = std::min(view_end, (position + prefetch_size + page_size - 1) / page_size * page_size);
+	if (start >= end)
+		return;
+
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<uint8_t*>(view + (start - view_start));
+	range.NumberOfBytes = (SIZE_T)(end - start);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	madvise(const_cast<uint8_t*>(view + (start - view_start)), (size_t)(end - start), MADV_WILLNEED);
+#endif
+
+	if (!inside)
+		prefetched_start = start;
+	prefetched_end = end;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "MediaInput.h"
+
+
+// Local file read through a memory mapped view: data is copied straight from page cache without
+// read syscalls and pages are shared by all players of the same file. Only a view of the file is
+// mapped at once, it slides forward (or back after a seek) when position leaves it, so files
+// bigger than address space can be played. OS is asked to prefetch pages ahead of position.
+class MappedInput : public MediaInput {
+public:
+	MappedInput() = default;
+
+	~MappedInput() override;
+
+	// view_size is rounded up to 64 KB (mapping offsets must be aligned to it on Windows),
+	// prefetch_size - how far ahead of position pages are prefetched
+	bool Open(const std::string& path, size_t view_size, size_t prefetch_size);
+
+protected:
+	int Read(uint8_t* buffer, int size) override;
+	bool Seek(uint64_t new_position) override;
+
+private:
+	void Close();
+
+	// view which starts at aligned offset before position
+	bool MapView(uint64_t offset);
+	void UnmapView();
+
+	// pages of view from position to position + prefetch_size are going to be read soon
+	void Prefetch();
+
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#else
+	int file_descriptor = -1;
+#endif
+
+	size_t max_view_size = 0;
+	size_t prefetch_size = 0;
+
+	const uint8_t* view = nullptr;
+	uint64_t view_start = 0;
+	size_t view_size = 0;
+
+	// part of view already prefetched
+	uint64_t prefetched_start = 0;
+	uint64_t prefetched_end = 0;
+};
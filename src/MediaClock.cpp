@@ -0,0 +1,56 @@
+#include "MediaClock.h"
+
+using namespace std::chrono;
+
+typedef duration<double> seconds_d;
+
+
+MediaClock::MediaClock(double max_lag) :
+	max_lag(max_lag)
+{
+
+}
+
+void MediaClock::Reset()
+{
+	is_started = false;
+}
+
+bool MediaClock::IsStarted()
+{
+	return is_started;
+}
+
+void MediaClock::Start(double timestamp, time_point now)
+{
+	origin = now - duration_cast<steady_clock::duration>(seconds_d{ timestamp });
+	is_started = true;
+}
+
+MediaClock::time_point MediaClock::GetDeadline(double timestamp)
+{
+	// without rounding to milliseconds, so the error doesn't accumulate
+	return origin + duration_cast<steady_clock::duration>(seconds_d{ timestamp });
+}
+
+bool MediaClock::IsLate(double timestamp, double duration, time_point now)
+{
+	return now >= GetDeadline(timestamp + duration);
+}
+
+bool MediaClock::CorrectDrift(double timestamp, time_point now)
+{
+	seconds_d lag = now - GetDeadline(timestamp);
+	if (lag.count() <= max_lag)
+		return false;
+
+	Start(timestamp, now);
+	++resync_count;
+
+	return true;
+}
+
+uint64_t MediaClock::GetResyncCount()
+{
+	return resync_count;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+
+// Maps frame timestamps (seconds of media time) to steady_clock deadlines.
+// Current time is passed in by caller, so the clock doesn't depend on real time.
+class MediaClock {
+public:
+	typedef std::chrono::steady_clock::time_point time_point;
+
+	// resync if presentation is behind by more than max_lag (e.g. after system sleep)
+	MediaClock(double max_lag = 0.5);
+
+	void Reset();
+	bool IsStarted();
+
+	// anchor media time 'timestamp' to 'now'
+	void Start(double timestamp, time_point now);
+
+	time_point GetDeadline(double timestamp);
+
+	// frame's display interval is already over
+	bool IsLate(double timestamp, double duration, time_point now);
+
+	// re-anchor clock if it's too far behind, returns true if clock was moved
+	bool CorrectDrift(double timestamp, time_point now);
+
+	uint64_t GetResyncCount();
+
+private:
+	bool is_started = false;
+	double max_lag = 0.5;
+
+	// steady_clock time which corresponds to media time 0
+	time_point origin;
+
+	uint64_t resync_count = 0;
+};
@@ -0,0 +1,133 @@
+#include "MediaInput.h"
+#include "ReadAheadInput.h"
+#include "MappedInput.h"
+
+extern "C"
+{
+#include <libavutil/mem.h>
+}
+
+#include <cstdio>
+
+
+MediaInput::~MediaInput()
+{
+	// buffer could be reallocated by FFmpeg, so it is taken from context
+	if (io_ctx) {
+		av_freep(&io_ctx->buffer);
+		avio_context_free(&io_ctx);
+	}
+}
+
+std::unique_ptr<MediaInput> MediaInput::Open(const std::string& path, const InputOptions& options)
+{
+	if (!IsLocalFile(path))
+		return nullptr;
+
+	std::unique_ptr<MediaInput> input;
+
+	if (options.mode == InputMode::ReadAhead) {
+		std::unique_ptr<ReadAheadInput> read_ahead = std::make_unique<ReadAheadInput>();
+		if (read_ahead->Open(path, options.block_size, options.read_ahead_blocks))
+			input = std::move(read_ahead);
+	}
+	else if (options.mode == InputMode::Mapped) {
+		std::unique_ptr<MappedInput> mapped = std::make_unique<MappedInput>();
+		if (mapped->Open(path, options.map_view_size, options.block_size * options.read_ahead_blocks))
+			input = std::move(mapped);
+	}
+
+	return input;
+}
+
+bool MediaInput::IsLocalFile(const std::string& path)
+{
+	if (path.empty())
+		return false;
+
+	// "C:\..." on Windows, protocols have at least two letters
+	size_t colon = path.find(':');
+	if (colon != std::string::npos && colon != 1)
+		return false;
+
+	return true;
+}
+
+AVIOContext* MediaInput::GetContext()
+{
+	return io_ctx;
+}
+
+uint64_t MediaInput::GetSize()
+{
+	return file_size;
+}
+
+InputStats MediaInput::GetStats()
+{
+	InputStats stats;
+	stats.read_calls = read_calls;
+	stats.bytes_read = bytes_read;
+	stats.seeks = seeks;
+
+	return stats;
+}
+
+bool MediaInput::CreateContext(size_t buffer_size)
+{
+	uint8_t* buffer = (uint8_t*)av_malloc(buffer_size);
+	if (!buffer)
+		return false;
+
+	io_ctx = avio_alloc_context(buffer, (int)buffer_size, 0, this, ReadCallback, NULL, SeekCallback);
+	if (!io_ctx) {
+		av_free(buffer);
+		return false;
+	}
+
+	return true;
+}
+
+int MediaInput::ReadCallback(void* opaque, uint8_t* buffer, int size)
+{
+	MediaInput* input = (MediaInput*)opaque;
+
+	if (input->position >= input->file_size)
+		return AVERROR_EOF;
+
+	int read = input->Read(buffer, size);
+	if (read > 0)
+		input->position += read;
+
+	return read;
+}
+
+int64_t MediaInput::SeekCallback(void* opaque, int64_t offset, int whence)
+{
+	MediaInput* input = (MediaInput*)opaque;
+
+	if (whence & AVSEEK_SIZE)
+		return (int64_t)input->file_size;
+
+	int64_t position = offset;
+	switch (whence & ~AVSEEK_FORCE) {
+	case SEEK_SET:
+		break;
+	case SEEK_CUR:
+		position += (int64_t)input->position;
+		break;
+	case SEEK_END:
+		position += (int64_t)input->file_size;
+		break;
+	default:
+		return -1;
+	}
+
+	if (position < 0 || !input->Seek((uint64_t)position))
+		return -1;
+
+	input->position = (uint64_t)position;
+	++input->seeks;
+
+	return position;
+}
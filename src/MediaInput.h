@@ -0,0 +1,92 @@
+#pragma once
+
+extern "C"
+{
+#include <libavformat/avio.h>
+}
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+
+// how local media files are read
+enum class InputMode {
+	Default,	// FFmpeg's file protocol
+	ReadAhead,	// large aligned blocks, see ReadAheadInput
+	Mapped		// memory mapped file, see MappedInput
+};
+
+struct InputOptions {
+	InputMode mode = InputMode::ReadAhead;
+
+	// read-ahead window is read_ahead_blocks blocks, every read starts at block boundary;
+	// mapped input asks OS to prefetch the same amount ahead of position
+	size_t block_size = 1024 * 1024;
+	size_t read_ahead_blocks = 4;
+
+	// mapped input maps a view of this size which slides over bigger files
+	size_t map_view_size = 64 * 1024 * 1024;
+
+	// audio, subtitle and data packets aren't even parsed
+	bool discard_other_streams = true;
+
+	// stream layout of local files is kept in ProbeCache, media opened before isn't probed again
+	bool use_probe_cache = true;
+};
+
+struct InputStats {
+	uint64_t read_calls = 0;	// reads from OS, mappings of a view for mapped input
+	uint64_t bytes_read = 0;
+	uint64_t seeks = 0;			// seeks requested by demuxer
+};
+
+
+// Custom input of libavformat for local files. The AVIOContext created here calls Read and Seek
+// of derived class, which reads the file its own way. Context is used by one thread at a time.
+class MediaInput {
+public:
+	virtual ~MediaInput();
+
+	MediaInput(const MediaInput& obj) = delete;
+	MediaInput& operator=(const MediaInput& obj) = delete;
+
+	// nullptr for Default mode, URLs, devices or if the file can't be opened
+	static std::unique_ptr<MediaInput> Open(const std::string& path, const InputOptions& options);
+
+	// not an URL of another protocol, e.g. "C:\video.mp4" or "/home/video.mp4"
+	static bool IsLocalFile(const std::string& path);
+
+	// for AVFormatContext::pb with AVFMT_FLAG_CUSTOM_IO, owned by input
+	AVIOContext* GetContext();
+
+	uint64_t GetSize();
+	InputStats GetStats();
+
+protected:
+	MediaInput() = default;
+
+	// buffer of AVIOContext, data is copied into it by Read
+	bool CreateContext(size_t buffer_size);
+
+	// bytes copied into buffer from position, it is never called at the end of file
+	virtual int Read(uint8_t* buffer, int size) = 0;
+
+	// position of the next Read is changed, false if it can't be read
+	virtual bool Seek(uint64_t new_position) = 0;
+
+	uint64_t file_size = 0;
+	uint64_t position = 0;
+
+	std::atomic<uint64_t> read_calls{ 0 };
+	std::atomic<uint64_t> bytes_read{ 0 };
+	std::atomic<uint64_t> seeks{ 0 };
+
+private:
+	static int ReadCallback(void* opaque, uint8_t* buffer, int size);
+	static int64_t SeekCallback(void* opaque, int64_t offset, int whence);
+
+	AVIOContext* io_ctx = nullptr;
+};
@@ -1,16 +1,39 @@
 #include "MediaPack.h"
+#include "Tracer.h"
 
+#include <stdexcept>
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+
+#ifdef _MSC_VER
 #pragma comment(lib, "avcodec.lib")
 #pragma comment(lib, "avformat.lib")
 #pragma comment(lib, "swscale.lib")
 #pragma comment(lib, "avutil.lib")
+#pragma comment(lib, "avdevice.lib")
+#endif
+
+// FFmpeg 5 made input formats const and FFmpeg 6 renamed frame's packet duration
+#if LIBAVFORMAT_VERSION_MAJOR >= 59
+typedef const AVInputFormat* InputFormatPointer;
+#else
+typedef AVInputFormat* InputFormatPointer;
+#endif
 
+#if LIBAVUTIL_VERSION_MAJOR >= 58
+#define FRAME_DURATION(frame) ((frame)->duration)
+#else
+#define FRAME_DURATION(frame) ((frame)->pkt_duration)
+#endif
 
-MediaPack::MediaPack(std::string path) :
-	path_to_media(path), frame_duration(0)
+
+MediaPack::MediaPack(std::string path, int decode_threads, const InputOptions& input_options) :
+	path_to_media(path), decode_threads(decode_threads), use_budget_share(decode_threads <= 0), input_options(input_options),
+	frame_duration(0)
 {
 	if (!LoadMedia(path_to_media))
-		throw std::exception("Can't load media.");
+		throw std::runtime_error("Can't load media.");
 }
 
 MediaPack::~MediaPack()
@@ -19,21 +42,32 @@ MediaPack::~MediaPack()
 }
 
 MediaPack::MediaPack(const MediaPack& obj) :
-	frame_duration(0)
+	path_to_media(obj.path_to_media), output_format(obj.output_format), decode_threads(obj.decode_threads),
+	use_budget_share(obj.use_budget_share), input_options(obj.input_options), frame_duration(0)
 {
 	if (obj.is_loaded) {
 		if (!LoadMedia(path_to_media))
-			throw std::exception("Can't copy media object.");
+			throw std::runtime_error("Can't copy media object.");
 	}
 }
 
 
+// demuxer thread of moved object must be stopped by caller
 MediaPack::MediaPack(MediaPack&& obj) noexcept :
 	path_to_media(std::move(obj.path_to_media)), is_loaded(obj.is_loaded), scaling_width(obj.scaling_width),
-	scaling_height(obj.scaling_height), video_stream_idx(obj.video_stream_idx), audio_stream_idx(obj.audio_stream_idx),
-	video_linesize(obj.video_linesize), sws_buffer_size(obj.sws_buffer_size), frame_width(obj.frame_width),
+	scaling_height(obj.scaling_height), output_format(obj.output_format), crop_x(obj.crop_x), crop_y(obj.crop_y), crop_width(obj.crop_width),
+	crop_height(obj.crop_height), video_stream_idx(obj.video_stream_idx), audio_stream_idx(obj.audio_stream_idx),
+	decode_threads(obj.decode_threads), use_budget_share(obj.use_budget_share), budget_version(obj.budget_version),
+	reopen_pending(obj.reopen_pending), baked_media(std::move(obj.baked_media)),
+	input_options(obj.input_options), media_input(std::move(obj.media_input)), probe_cached(obj.probe_cached),
+	video_buffer_size(obj.video_buffer_size), frame_pool(std::move(obj.frame_pool)), video_linesize(obj.video_linesize), use_fast_convert(obj.use_fast_convert),
+	frame_width(obj.frame_width),
 	frame_height(obj.frame_height), frame_rate(obj.frame_rate), base_time(obj.base_time), duration(obj.duration),
-	frame_duration(obj.frame_duration)
+	frame_duration(obj.frame_duration), start_pts(obj.start_pts), loop_offset(obj.loop_offset),
+	last_timestamp(obj.last_timestamp), last_duration(obj.last_duration), loop_cache_budget(obj.loop_cache_budget),
+	at_loop_start(obj.at_loop_start), preroll_frames(obj.preroll_frames), use_demuxer_thread(obj.use_demuxer_thread),
+	packet_queue(std::move(obj.packet_queue)), keyframe_index(std::move(obj.keyframe_index)),
+	indexing_from_start(obj.indexing_from_start)
 {
 	media_ctx = obj.media_ctx;
 	obj.media_ctx = nullptr;
@@ -53,23 +87,45 @@ MediaPack::MediaPack(MediaPack&& obj) noexcept :
 	video_frame_rgb = obj.video_frame_rgb;
 	obj.video_frame_rgb = nullptr;
 
+	video_packet = obj.video_packet;
+	obj.video_packet = nullptr;
+
 	video_buffer = obj.video_buffer;
 	obj.video_buffer = nullptr;
 
 	sws_ctx = obj.sws_ctx;
 	obj.sws_ctx = nullptr;
-
-	sws_buffer = obj.sws_buffer;
-	obj.sws_buffer = nullptr;
+	sws_colorspace = obj.sws_colorspace;
+	sws_range = obj.sws_range;
 
 	obj.is_loaded = false;
 }
 
+bool MediaPack::SetOutputFormat(FrameFormat format)
+{
+	// baked frames are already converted
+	if (baked_media)
+		return format == output_format;
+
+	output_format = format;
+
+	return true;
+}
+
+FrameFormat MediaPack::GetOutputFormat()
+{
+	return output_format;
+}
+
 bool MediaPack::SetScaling(long width, long height)
 {
 	if (!is_loaded)
 		return false;
 
+	// baked frames are already scaled
+	if (baked_media)
+		return (width == 0 && height == 0) || (width == scaling_width && height == scaling_height);
+
 	// don't scale frames
 	if (width == 0 || height == 0) {
 		// exactly 2 must be zero
@@ -80,42 +136,106 @@ bool MediaPack::SetScaling(long width, long height)
 		height = video_codec_ctx->height;
 	}
 
+	// convert the whole frame
+	return SetScaling(width, height, 0, 0, video_codec_ctx->width, video_codec_ctx->height);
+}
+
+bool MediaPack::SetScaling(long width, long height, long src_x, long src_y, long src_width, long src_height)
+{
+	if (!is_loaded)
+		return false;
+
+	if (baked_media)
+		return width == scaling_width && height == scaling_height && src_x == 0 && src_y == 0 &&
+			src_width == frame_width && src_height == frame_height;
+
+	if (width <= 0 || height <= 0 || src_width <= 0 || src_height <= 0 || src_x < 0 || src_y < 0)
+		return false;
+
+	if (src_x + src_width > video_codec_ctx->width || src_y + src_height > video_codec_ctx->height)
+		return false;
+
+	const AVPixFmtDescriptor* pix_desc = av_pix_fmt_desc_get(video_codec_ctx->pix_fmt);
+	if (!pix_desc)
+		return false;
+
+	// paletted and bit packed frames can't be cropped by moving plane pointers
+	bool is_cropped = src_x != 0 || src_y != 0 || src_width != video_codec_ctx->width || src_height != video_codec_ctx->height;
+	if (is_cropped && (pix_desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL)))
+		return false;
+
+	// pointers to the region can be moved only by whole chroma samples
+	long chroma_w = 1L << pix_desc->log2_chroma_w;
+	long chroma_h = 1L << pix_desc->log2_chroma_h;
+	src_x -= src_x % chroma_w;
+	src_y -= src_y % chroma_h;
+
+	// crop params
+	crop_x = src_x;
+	crop_y = src_y;
+	crop_width = src_width;
+	crop_height = src_height;
 	
 	// scaling params
 	scaling_width = width;
 	scaling_height = height;
 
-	video_frame_raw = av_frame_alloc();
+	// frames and buffer are kept between calls, scaling can be changed any number of times
 	if (!video_frame_raw) {
-		return false;
+		video_frame_raw = av_frame_alloc();
+		if (!video_frame_raw)
+			return false;
 	}
-	video_frame_rgb = av_frame_alloc();
+
 	if (!video_frame_rgb) {
-		return false;
+		video_frame_rgb = av_frame_alloc();
+		if (!video_frame_rgb)
+			return false;
 	}
 
-	// determine required buffer size and allocate buffer for converted frame
-	video_buffer_size = av_image_get_buffer_size(AV_PIX_FMT_BGR24, width, height, 32);
-	video_buffer = (uint8_t*)av_malloc(video_buffer_size);
-	if (!video_buffer)
+	// determine required buffer size, buffer for converted frame is changed only for another size
+	int buffer_size = av_image_get_buffer_size(GetOutputPixelFormat(), width, height, FramePool::alignment);
+	if (buffer_size <= 0)
 		return false;
 
-	int ret_code = av_image_fill_arrays(video_frame_rgb->data, video_frame_rgb->linesize, video_buffer,
-		AV_PIX_FMT_BGR24, width, height, 32);
+	if (!video_buffer || frame_pool.GetBufferSize() != (size_t)buffer_size) {
+		av_buffer_unref(&video_buffer);
+
+		if (!frame_pool.SetBufferSize(buffer_size))
+			return false;
+
+		video_buffer = frame_pool.Acquire();
+		if (!video_buffer)
+			return false;
+	}
+
+	video_buffer_size = buffer_size;
+
+	int ret_code = av_image_fill_arrays(video_frame_rgb->data, video_frame_rgb->linesize, video_buffer->data,
+		GetOutputPixelFormat(), width, height, FramePool::alignment);
 	if (ret_code < 0) {
 		return false;
 	}
 
 	video_linesize = video_frame_rgb->linesize[0];
 
-	// initialize SWS context for software scaling
-	sws_ctx = sws_getContext(
-		video_codec_ctx->width,
-		video_codec_ctx->height,
+	// cached frames have the old size
+	ResetLoopCache();
+
+	// swscale is still needed for resizing and unsupported pixel formats
+	use_fast_convert = scaling_width == crop_width && scaling_height == crop_height &&
+		ColorConverter::IsSupported(video_codec_ctx->pix_fmt, GetOutputPixelFormat());
+
+	// SWS context for software scaling, source is only the cropped region;
+	// the old context is reused when params are the same, otherwise it is freed
+	sws_ctx = sws_getCachedContext(
+		sws_ctx,
+		crop_width,
+		crop_height,
 		video_codec_ctx->pix_fmt,
 		scaling_width,
 		scaling_height,
-		AV_PIX_FMT_BGR24,
+		GetOutputPixelFormat(),
 		SWS_BICUBIC,
 		NULL,
 		NULL,
@@ -125,82 +245,311 @@ bool MediaPack::SetScaling(long width, long height)
 		return false;
 	}
 
+	// context may be a new one
+	sws_colorspace = sws_range = -1;
+
 	return true;
 }
 
 int MediaPack::GetNextFrame(Frame& frame, bool loop_media)
+{
+	if (is_loaded && baked_media) {
+		// nothing is decoded or converted
+		frame.prepare_start = std::chrono::steady_clock::now();
+		frame.demux_ms = frame.decode_ms = frame.convert_ms = 0.0;
+
+		return baked_media->GetNextFrame(frame, loop_media);
+	}
+
+	if (!is_loaded || !video_buffer)
+		return -1;
+
+	int ret_code = ReadFrame(frame, video_buffer->data, video_linesize, loop_media);
+	if (ret_code < 0)
+		return ret_code;
+
+	// because we convert frame to packed BGR(A) format - we can send to output buffer only the first plane
+	frame.frame_buf = video_frame_rgb->data[0];
+	frame.original_width = scaling_width;
+	frame.original_height = scaling_height;
+	frame.format = output_format;
+	frame.bytes_per_pixel = GetBytesPerPixel(output_format);
+	frame.linesize = video_linesize;
+
+	return 0;
+}
+
+int MediaPack::DecodeNextFrame(Frame& frame, bool loop_media)
+{
+	if (!is_loaded || !frame.frame_buf)
+		return -1;
+
+	// caller's buffer can have its own stride, but it must fit the whole row
+	int dst_stride = frame.linesize > 0 ? frame.linesize : video_linesize;
+	if (dst_stride < scaling_width * GetBytesPerPixel(output_format))
+		return -1;
+
+	if (baked_media) {
+		frame.prepare_start = std::chrono::steady_clock::now();
+		frame.demux_ms = frame.decode_ms = frame.convert_ms = 0.0;
+
+		if (baked_media->CopyNextFrame(frame, frame.frame_buf, dst_stride, loop_media))
+			return -1;
+
+		frame.linesize = dst_stride;
+
+		return 0;
+	}
+
+	int ret_code = ReadFrame(frame, frame.frame_buf, dst_stride, loop_media);
+	if (ret_code < 0)
+		return ret_code;
+
+	frame.original_width = scaling_width;
+	frame.original_height = scaling_height;
+	frame.format = output_format;
+	frame.bytes_per_pixel = GetBytesPerPixel(output_format);
+	frame.linesize = dst_stride;
+
+	return 0;
+}
+
+bool MediaPack::SetLoopCache(size_t budget)
+{
+	// baked frames are already in memory
+	if (baked_media)
+		return false;
+
+	loop_cache_budget = budget;
+
+	if (scaling_width > 0 && scaling_height > 0)
+		ResetLoopCache();
+
+	return true;
+}
+
+bool MediaPack::SetLoopPreroll(size_t frames)
+{
+	// baked media is looped without decoder
+	if (baked_media)
+		return false;
+
+	preroll_frames = frames;
+
+	if (scaling_width > 0 && scaling_height > 0)
+		ResetLoopCache();
+
+	return true;
+}
+
+size_t MediaPack::GetLoopsCount()
+{
+	return loops_count;
+}
+
+ms MediaPack::GetLastLoopLatency()
+{
+	return last_loop_latency;
+}
+
+ms MediaPack::GetMaxLoopLatency()
+{
+	return max_loop_latency;
+}
+
+size_t MediaPack::GetLoopCacheFrames()
+{
+	return loop_cache.GetFramesCount();
+}
+
+size_t MediaPack::GetLoopCacheMemory()
+{
+	return loop_cache.GetUsedMemory();
+}
+
+void MediaPack::SetReducedDecoding(bool reduced)
+{
+	reduced_decoding = reduced;
+}
+
+bool MediaPack::IsReducedDecoding()
+{
+	return reduced_decoding;
+}
+
+bool MediaPack::SetDemuxerThread(bool enabled)
+{
+	if (baked_media)
+		return !enabled;
+
+	use_demuxer_thread = enabled;
+	if (!enabled)
+		StopDemuxer();
+
+	return true;
+}
+
+InputStats MediaPack::GetInputStats()
+{
+	if (!media_input)
+		return InputStats();
+
+	return media_input->GetStats();
+}
+
+PacketQueue::Stats MediaPack::GetDemuxerStats()
+{
+	if (!packet_queue)
+		return PacketQueue::Stats();
+
+	return packet_queue->GetStats();
+}
+
+bool MediaPack::IsProbeCached()
+{
+	return probe_cached;
+}
+
+int MediaPack::Seek(double position)
 {
 	if (!is_loaded)
 		return -1;
 
-	// packet with undecoded frame
-	AVPacket packet;
+	if (position < 0.0)
+		position = 0.0;
 
-	int ret_code = 0;
+	if (baked_media)
+		return baked_media->Seek(position);
 
-	while (true) {
-		ret_code = av_read_frame(media_ctx, &packet);
-		if (ret_code < 0) {
-			// seek to the first frame if looping is enabled
-			if (ret_code == AVERROR_EOF && loop_media) {
-				av_seek_frame(media_ctx, video_stream_idx, 0, AVSEEK_FLAG_ANY);
-				return 0;
-			}
-			else
-				return ret_code;
+	preroll_playing = false;
+	preroll_filling = false;
 
-		}
+	// frames at position are in memory, decoder isn't used
+	if (SeekCachedFrame(position))
+		return 0;
 
-		if (packet.stream_index == video_stream_idx) {
-			// send packet to codec decoder
-			ret_code = avcodec_send_packet(video_codec_ctx, &packet);
-			if (ret_code < 0) {
-				av_packet_unref(&packet);
-				return ret_code;
-			}
-
-			while (ret_code >= 0) {
-				ret_code = avcodec_receive_frame(video_codec_ctx, video_frame_raw);
-				if (ret_code == AVERROR(EAGAIN) || ret_code == AVERROR_EOF) {
-					av_packet_unref(&packet);
-					break;
-				}
-				else if (ret_code < 0) {
-					av_packet_unref(&packet);
-					return ret_code;
-				}
-
-				if (ret_code >= 0) {
-					int slice_height = sws_scale(sws_ctx, video_frame_raw->data,
-						video_frame_raw->linesize, 0, video_codec_ctx->height,
-						video_frame_rgb->data, video_frame_rgb->linesize);
-
-					// because we convert frame to BGR format - we can send to output buffer only the first plane
-					frame.frame_buf = video_frame_rgb->data[0];
-					frame.original_width = scaling_width;
-					frame.original_height = scaling_height;
-					frame.linesize = video_linesize;
-
-					av_frame_unref(video_frame_raw);
-					av_packet_unref(&packet);
-
-					return 0;
-				}
-			}
-		}
+	AVStream* stream = media_ctx->streams[video_stream_idx];
+	int64_t target_pts = start_pts + (int64_t)std::floor(position / base_time + 1e-6);
+
+	// keyframes after the last indexed one aren't known, demuxer looks for them itself
+	int64_t keyframe_pts = target_pts;
+	seek_retry = true;
+
+	KeyframeIndex::Keyframe keyframe, last_keyframe;
+	if (keyframe_index.FindPreceding(target_pts, keyframe) && keyframe_index.GetLast(last_keyframe) &&
+		(keyframe_index.IsComplete() || last_keyframe.pts >= target_pts)) {
+		keyframe_pts = keyframe.pts;
+		seek_retry = false;
+
+		// demuxers without own index (MKV without cues, MPEG-TS) seek by known positions instead of searching
+		if (KeyframeIndex::GetStreamIndexSize(stream) == 0)
+			KeyframeIndex::FillStreamIndex(stream, keyframe_index.GetKeyframes());
+	}
+
+	int ret_code = SeekDemuxer(keyframe_pts);
+	if (ret_code < 0)
+		return ret_code;
+
+	avcodec_flush_buffers(video_codec_ctx);
+
+	seek_pts = target_pts;
+	seek_keyframe_wait = true;
+	seek_continue = true;
+
+	// frames can be stored and indexed only from the beginning of the loop
+	at_loop_start = target_pts <= start_pts;
+	indexing_from_start = at_loop_start && !keyframe_index.IsComplete();
+
+	if (cache_state == CacheState::Filling) {
+		loop_cache.Reset(loop_cache_budget, scaling_width * GetBytesPerPixel(output_format), scaling_height);
+		cache_state = CacheState::Waiting;
+	}
 
-		// Free the packet that was allocated by av_read_frame
-		av_packet_unref(&packet);
+	// cached prefix is skipped, decoder is already after it
+	if (cache_state == CacheState::Prefix) {
+		cache_position = loop_cache.GetFramesCount();
+		decoder_positioned = true;
 	}
 
 	return 0;
 }
 
+bool MediaPack::ScanKeyframes()
+{
+	if (!is_loaded || baked_media)
+		return false;
+
+	if (keyframe_index.IsComplete())
+		return true;
+
+	// devices and test sources aren't files
+	if (media_ctx->iformat->flags & AVFMT_NOFILE)
+		return false;
+
+	// packets are read by another context, so playback position isn't changed
+	AVFormatContext* scan_ctx = NULL;
+	if (avformat_open_input(&scan_ctx, path_to_media.c_str(), media_ctx->iformat, NULL) < 0)
+		return false;
+
+	// streams must be declared in the header, they aren't probed
+	if (scan_ctx->nb_streams != media_ctx->nb_streams) {
+		avformat_close_input(&scan_ctx);
+		return false;
+	}
+
+	for (unsigned int i = 0; i < scan_ctx->nb_streams; i++) {
+		if ((int)i != video_stream_idx)
+			scan_ctx->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	AVPacket* packet = av_packet_alloc();
+	int ret_code = packet ? 0 : AVERROR(ENOMEM);
+
+	while (ret_code >= 0) {
+		ret_code = av_read_frame(scan_ctx, packet);
+		if (ret_code < 0)
+			break;
+
+		if (packet->stream_index == video_stream_idx && (packet->flags & AV_PKT_FLAG_KEY)) {
+			int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+			if (pts != AV_NOPTS_VALUE)
+				keyframe_index.Add(pts, packet->pos);
+		}
+
+		av_packet_unref(packet);
+	}
+
+	av_packet_free(&packet);
+	avformat_close_input(&scan_ctx);
+
+	if (ret_code != AVERROR_EOF)
+		return false;
+
+	CompleteKeyframeIndex();
+
+	return true;
+}
+
+size_t MediaPack::GetKeyframesCount()
+{
+	return keyframe_index.GetCount();
+}
+
+bool MediaPack::IsKeyframeIndexComplete()
+{
+	return keyframe_index.IsComplete();
+}
+
 bool MediaPack::IsLoaded()
 {
 	return is_loaded;
 }
 
+bool MediaPack::IsBaked()
+{
+	return baked_media != nullptr;
+}
+
 bool MediaPack::GetVideoResolution(long& width, long& height)
 {
 	if (!is_loaded)
@@ -212,30 +561,106 @@ bool MediaPack::GetVideoResolution(long& width, long& height)
 	return true;
 }
 
+bool MediaPack::GetScaledResolution(long& width, long& height)
+{
+	if (!is_loaded || scaling_width == 0 || scaling_height == 0)
+		return false;
+
+	width = scaling_width;
+	height = scaling_height;
+
+	return true;
+}
+
 ms MediaPack::GetFrameDuration()
 {
 	return frame_duration;
 }
 
+size_t MediaPack::GetFrameBufferSize()
+{
+	return video_buffer_size;
+}
+
 std::string MediaPack::GetMediaPath()
 {
 	return path_to_media;
 }
 
+int MediaPack::GetDecodeThreads()
+{
+	return decode_threads;
+}
+
 bool MediaPack::LoadMedia(std::string path)
 {
 	if (path.empty())
 		return false;
 
+	if (BakedMedia::IsBaked(path))
+		return LoadBakedMedia(path);
+
 	int ret_code = 0;
 
+	// test sources of libavfilter are opened through lavfi device
+	static const std::string lavfi_prefix = "lavfi:";
+	InputFormatPointer input_format = NULL;
+	std::string url = path;
+
+	if (path.compare(0, lavfi_prefix.size(), lavfi_prefix) == 0) {
+		static std::once_flag devices_registered;
+		std::call_once(devices_registered, []() { avdevice_register_all(); });
+
+		input_format = av_find_input_format("lavfi");
+		if (!input_format)
+			return false;
+
+		url = path.substr(lavfi_prefix.size());
+	}
+
+	// local files are read in big blocks by our own input, FFmpeg's file protocol is a fallback
+	if (!input_format && input_options.mode != InputMode::Default) {
+		media_input = MediaInput::Open(path, input_options);
+		if (media_input) {
+			media_ctx = avformat_alloc_context();
+			if (!media_ctx)
+				return false;
+
+			media_ctx->pb = media_input->GetContext();
+			media_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+		}
+	}
+
+	// format of media probed before is known, so it isn't detected from the first bytes
+	ProbeCache::Entry probe_entry;
+	bool use_probe_cache = !input_format && input_options.use_probe_cache;
+	bool has_probe_entry = use_probe_cache && ProbeCache::Load(path, probe_entry);
+	if (has_probe_entry)
+		input_format = av_find_input_format(probe_entry.format_name.c_str());
+
 	// read media container header
-	ret_code = avformat_open_input(&media_ctx, path.c_str(), NULL, NULL);
+	ret_code = avformat_open_input(&media_ctx, url.c_str(), input_format, NULL);
 	if (ret_code) {
 		return false;
 	}
 
-	if (avformat_find_stream_info(media_ctx, NULL) < 0) {
+	// the header is completed from probe cache, otherwise the beginning of media is read and decoded
+	probe_cached = has_probe_entry && input_format && ProbeCache::Apply(probe_entry, media_ctx);
+	if (!probe_cached && avformat_find_stream_info(media_ctx, NULL) < 0) {
+		return false;
+	}
+
+	video_packet = av_packet_alloc();
+	if (!video_packet)
+		return false;
+
+	// queue isn't replaced while media is open, so player can read its stats during decoding;
+	// it is aborted while demuxer thread doesn't run
+	try {
+		packet_queue = std::make_unique<PacketQueue>(PacketQueue::Limits());
+		packet_queue->Abort();
+	}
+	catch (std::exception&) {
 		return false;
 	}
 
@@ -254,6 +679,28 @@ bool MediaPack::LoadMedia(std::string path)
 		return false;
 	}
 
+	// probed once, opened from cache next time
+	if (use_probe_cache && !probe_cached) {
+		if (ProbeCache::Capture(media_ctx, video_stream_idx, probe_entry))
+			ProbeCache::Store(path, probe_entry);
+	}
+
+	// complete index of an earlier run, container's own index (decoding timestamps of MP4) is used only by demuxer
+	if (probe_cached && probe_entry.keyframes_complete) {
+		for (const KeyframeIndex::Keyframe& keyframe : probe_entry.keyframes)
+			keyframe_index.Add(keyframe.pts, keyframe.pos);
+
+		keyframe_index.SetComplete(true);
+	}
+
+	// demuxer skips packets of other streams without reading them into packets
+	if (input_options.discard_other_streams) {
+		for (unsigned int i = 0; i < media_ctx->nb_streams; i++) {
+			if ((int)i != video_stream_idx)
+				media_ctx->streams[i]->discard = AVDISCARD_ALL;
+		}
+	}
+
 	// get a pointer to the codec params for the video stream
 	video_codec_params = media_ctx->streams[video_stream_idx]->codecpar;
 
@@ -263,25 +710,11 @@ bool MediaPack::LoadMedia(std::string path)
 		return false;
 	}
 	
-	// get codec context
-	video_codec_ctx = avcodec_alloc_context3(video_codec);
+	// get codec context and open codec for decoding video stream
+	video_codec_ctx = OpenDecoder();
 	if (!video_codec_ctx) {
 		return false;
 	}
-	if (avcodec_parameters_to_context(video_codec_ctx, video_codec_params) < 0) {
-		return false;
-	}
-
-	// TODO: add multithreading suport (std::thread::hardware_concurrency)
-
-	// multithreading decoding options
-	//video_codec_ctx->thread_count = 3;
-	//video_codec_ctx->thread_type = FF_THREAD_SLICE;
-
-	// open codec for decoding video stream
-	if (avcodec_open2(video_codec_ctx, video_codec, NULL) < 0) {
-		return false;
-	}
 
 	// get needed info about video stream
 	frame_width = video_codec_params->width;
@@ -300,19 +733,130 @@ bool MediaPack::LoadMedia(std::string path)
 		frame_rate = av_q2d(media_ctx->streams[video_stream_idx]->avg_frame_rate);
 	}
 
+	// average frame rate is correct for variable frame rate media too
+	AVRational avg_frame_rate = media_ctx->streams[video_stream_idx]->avg_frame_rate;
+	if (avg_frame_rate.num > 0 && avg_frame_rate.den > 0)
+		frame_rate = av_q2d(avg_frame_rate);
+
+	if (frame_rate <= 0.0)
+		frame_rate = 25.0;
+
 	typedef std::chrono::duration<double> sec;
-	sec seconds_c{ (double)media_ctx->streams[video_stream_idx]->r_frame_rate.den / media_ctx->streams[video_stream_idx]->r_frame_rate.num };
+	sec seconds_c{ 1.0 / frame_rate };
 	frame_duration = std::chrono::duration_cast<ms>(seconds_c);
 
+	// first timestamp of video stream
+	start_pts = media_ctx->streams[video_stream_idx]->start_time;
+	if (start_pts == AV_NOPTS_VALUE)
+		start_pts = 0;
+
 	is_loaded = true;
 
 	return true;
 }
 
+bool MediaPack::LoadBakedMedia(std::string path)
+{
+	try {
+		baked_media = std::make_unique<BakedMedia>(path);
+	}
+	catch (std::exception&) {
+		return false;
+	}
+
+	// frames are stored already scaled and converted
+	frame_width = scaling_width = baked_media->GetWidth();
+	frame_height = scaling_height = baked_media->GetHeight();
+	crop_width = frame_width;
+	crop_height = frame_height;
+	output_format = baked_media->GetFormat();
+	video_linesize = baked_media->GetLinesize();
+	video_buffer_size = (size_t)video_linesize * scaling_height;
+
+	frame_rate = baked_media->GetFrameRate();
+	if (frame_rate <= 0.0)
+		frame_rate = 25.0;
+
+	typedef std::chrono::duration<double> sec;
+	sec seconds_c{ 1.0 / frame_rate };
+	frame_duration = std::chrono::duration_cast<ms>(seconds_c);
+
+	is_loaded = true;
+
+	return true;
+}
+
+AVCodecContext* MediaPack::OpenDecoder()
+{
+	AVCodecContext* codec_ctx = avcodec_alloc_context3(video_codec);
+	if (!codec_ctx)
+		return NULL;
+
+	// multithreading decoding options
+	// cores are shared between all players, so each decoder gets only its part
+	int threads = decode_threads;
+	if (use_budget_share) {
+		budget_version = DecodeBudget::GetVersion();
+		threads = DecodeBudget::GetThreadsPerDecoder();
+	}
+
+	codec_ctx->thread_count = threads;
+	codec_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+	if (avcodec_parameters_to_context(codec_ctx, video_codec_params) < 0 ||
+		avcodec_open2(codec_ctx, video_codec, NULL) < 0) {
+		avcodec_free_context(&codec_ctx);
+		return NULL;
+	}
+
+	decode_threads = threads;
+
+	return codec_ctx;
+}
+
+void MediaPack::ReopenDecoder()
+{
+	AVCodecContext* codec_ctx = OpenDecoder();
+	if (!codec_ctx) {
+		// old decoder leaves draining mode
+		avcodec_flush_buffers(video_codec_ctx);
+		return;
+	}
+
+	avcodec_close(video_codec_ctx);
+	avcodec_free_context(&video_codec_ctx);
+	video_codec_ctx = codec_ctx;
+
+	// new context decodes every frame
+	is_skipping_frames = false;
+}
+
+bool MediaPack::IsShareChanged()
+{
+	unsigned int version = DecodeBudget::GetVersion();
+	if (!use_budget_share || version == budget_version)
+		return false;
+
+	if (DecodeBudget::GetThreadsPerDecoder() != decode_threads)
+		return true;
+
+	// players changed, but the share is the same
+	budget_version = version;
+
+	return false;
+}
+
 void MediaPack::FreeMedia()
 {
-	if (video_buffer)
-		av_freep(&video_buffer);
+	StopDemuxer();
+	packet_queue.reset();
+
+	baked_media.reset();
+
+	if (video_packet)
+		av_packet_free(&video_packet);
+
+	av_buffer_unref(&video_buffer);
 
 	if (video_frame_raw)
 		av_frame_free(&video_frame_raw);
@@ -320,8 +864,10 @@ void MediaPack::FreeMedia()
 	if (video_frame_rgb)
 		av_frame_free(&video_frame_rgb);
 
-	if (sws_ctx)
+	if (sws_ctx) {
 		sws_freeContext(sws_ctx);
+		sws_ctx = NULL;
+	}
 
 
 	if (video_codec_ctx) {
@@ -331,4 +877,661 @@ void MediaPack::FreeMedia()
 
 	if (media_ctx)
 		avformat_close_input(&media_ctx);
+
+	media_input.reset();
+}
+
+int MediaPack::ReadFrame(Frame& frame, uint8_t* dst_buf, int dst_stride, bool loop_media)
+{
+	auto start = std::chrono::steady_clock::now();
+	double previous_offset = loop_offset;
+	bool is_seeking = seek_continue;
+
+	demux_time = decode_time = convert_time = std::chrono::steady_clock::duration::zero();
+
+	int ret_code = NextFrame(frame, dst_buf, dst_stride, loop_media);
+
+	typedef std::chrono::duration<double, std::milli> ms_d;
+	frame.prepare_start = start;
+	frame.demux_ms = ms_d(demux_time).count();
+	frame.decode_ms = ms_d(decode_time).count();
+	frame.convert_ms = ms_d(convert_time).count();
+
+	// the first frame of the next loop, seek moves timestamps too
+	if (ret_code == 0 && loop_offset != previous_offset && !is_seeking) {
+		last_loop_latency = std::chrono::duration_cast<ms>(std::chrono::steady_clock::now() - start);
+		if (last_loop_latency > max_loop_latency)
+			max_loop_latency = last_loop_latency;
+
+		++loops_count;
+	}
+
+	return ret_code;
+}
+
+int MediaPack::NextFrame(Frame& frame, uint8_t* dst_buf, int dst_stride, bool loop_media)
+{
+	if (!sws_ctx)
+		return -1;
+
+	// output frame is packed BGR(A), so it has only the first plane
+	uint8_t* dst_data[4] = { dst_buf, NULL, NULL, NULL };
+	int dst_linesize[4] = { dst_stride, 0, 0, 0 };
+
+	int ret_code = 0;
+
+	// later loops are played from memory
+	if (cache_state == CacheState::Complete || (cache_state == CacheState::Prefix && cache_position < loop_cache.GetFramesCount()))
+		return ReadCachedFrame(frame, dst_buf, dst_stride);
+
+	// after cached prefix decoding continues from the first not cached keyframe
+	if (cache_state == CacheState::Prefix && !decoder_positioned) {
+		ret_code = SeekDemuxer(resume_pts);
+		if (ret_code < 0)
+			return ret_code;
+
+		avcodec_flush_buffers(video_codec_ctx);
+		decoder_positioned = true;
+		indexing_from_start = false;
+	}
+
+	// beginning of the loop is shown from memory while decoder catches up
+	if (preroll_playing)
+		return ReadPrerollFrame(frame, dst_buf, dst_stride);
+
+	ret_code = DecodeFrame();
+
+	// frames before seek position are decoded only as references, they aren't converted
+	while (seek_pts != AV_NOPTS_VALUE) {
+		int64_t pts = video_frame_raw->best_effort_timestamp;
+		int64_t pts_duration = FRAME_DURATION(video_frame_raw) > 0 ? FRAME_DURATION(video_frame_raw) :
+			(int64_t)(std::chrono::duration<double>(frame_duration).count() / base_time);
+
+		// index of demuxer can have decoding timestamps (MP4), so it lands on the keyframe after position
+		// if position is between decoding and presentation timestamp of the keyframe
+		int64_t dts = video_frame_raw->pkt_dts;
+		bool is_late = ret_code == 0 && pts != AV_NOPTS_VALUE && pts > seek_pts && dts != AV_NOPTS_VALUE && dts > start_pts;
+		if (seek_retry && is_late) {
+			seek_retry = false;
+			av_frame_unref(video_frame_raw);
+
+			ret_code = SeekDemuxer(dts - 1);
+			if (ret_code < 0)
+				return ret_code;
+
+			avcodec_flush_buffers(video_codec_ctx);
+			seek_keyframe_wait = true;
+
+			ret_code = DecodeFrame();
+			continue;
+		}
+		seek_retry = false;
+
+		if (ret_code < 0 || pts == AV_NOPTS_VALUE || pts + pts_duration > seek_pts) {
+			seek_pts = AV_NOPTS_VALUE;
+			break;
+		}
+
+		av_frame_unref(video_frame_raw);
+		ret_code = DecodeFrame();
+	}
+
+	// all frames are shown, start the next loop
+	if (ret_code == AVERROR_EOF && loop_media) {
+		// timestamps of the next loop continue after the last frame
+		loop_offset = last_timestamp + last_duration;
+		seek_continue = false;
+
+		// the whole loop is in memory now
+		if (cache_state == CacheState::Filling)
+			cache_state = loop_cache.GetFramesCount() > 0 ? CacheState::Complete : CacheState::Off;
+
+		// loop cache is used instead of preroll
+		if (cache_state == CacheState::Complete || cache_state == CacheState::Prefix) {
+			preroll_cache.Clear();
+
+			cache_position = 0;
+			decoder_positioned = false;
+			return ReadCachedFrame(frame, dst_buf, dst_stride);
+		}
+
+		ret_code = RestartDecoder();
+		if (ret_code < 0)
+			return ret_code;
+
+		if (preroll_cache.GetFramesCount() > 0) {
+			preroll_playing = true;
+			preroll_position = 0;
+			return ReadPrerollFrame(frame, dst_buf, dst_stride);
+		}
+
+		ret_code = DecodeFrame();
+	}
+
+	if (ret_code < 0)
+		return ret_code;
+
+	// only visible region is converted
+	const uint8_t* src_data[4] = { NULL, NULL, NULL, NULL };
+	GetCropPlanes(video_frame_raw, src_data);
+
+	bool full_range = video_frame_raw->color_range == AVCOL_RANGE_JPEG;
+
+	auto convert_start = std::chrono::steady_clock::now();
+
+	bool converted = false;
+	if (use_fast_convert) {
+		TRACE_SCOPE("ColorConverter::Convert");
+		converted = ColorConverter::Convert(src_data, video_frame_raw->linesize,
+			(AVPixelFormat)video_frame_raw->format, full_range, video_frame_raw->colorspace, dst_buf, dst_stride,
+			GetOutputPixelFormat(), crop_width, crop_height);
+	}
+
+	// resized frames, unsupported formats and colorspaces
+	if (!converted) {
+		TRACE_SCOPE("sws_scale");
+		SetSwsColorspace(video_frame_raw->colorspace, full_range);
+		sws_scale(sws_ctx, src_data,
+			video_frame_raw->linesize, 0, crop_height,
+			dst_data, dst_linesize);
+	}
+
+	convert_time += std::chrono::steady_clock::now() - convert_start;
+
+	// use real frame timestamps, so variable frame rate media is played correctly
+	double nominal_duration = std::chrono::duration<double>(frame_duration).count();
+	double frame_time = last_timestamp + last_duration;
+
+	int64_t pts = video_frame_raw->best_effort_timestamp;
+
+	// the first frame after seek is shown right after the last one
+	if (seek_continue && pts != AV_NOPTS_VALUE)
+		loop_offset = frame_time - (pts - start_pts) * base_time;
+	seek_continue = false;
+
+	if (pts != AV_NOPTS_VALUE)
+		frame_time = (pts - start_pts) * base_time + loop_offset;
+
+	double frame_time_duration = nominal_duration;
+	if (FRAME_DURATION(video_frame_raw) > 0)
+		frame_time_duration = FRAME_DURATION(video_frame_raw) * base_time;
+
+	last_timestamp = frame_time;
+	last_duration = frame_time_duration;
+
+	frame.timestamp = frame_time;
+	frame.duration = frame_time_duration;
+	frame.position = frame_time - loop_offset;
+
+	// the first full loop is stored to be played from memory later
+	if (at_loop_start) {
+		if (cache_state == CacheState::Waiting)
+			cache_state = CacheState::Filling;
+
+		preroll_filling = preroll_frames > 0 && preroll_cache.GetFramesCount() == 0;
+	}
+	at_loop_start = false;
+
+	bool is_keyframe = video_frame_raw->key_frame != 0;
+
+	if (cache_state == CacheState::Filling)
+		CacheFrame(dst_buf, dst_stride, pts, is_keyframe);
+
+	if (preroll_filling)
+		AddPrerollFrame(dst_buf, dst_stride, pts, is_keyframe);
+
+	av_frame_unref(video_frame_raw);
+
+	return 0;
+}
+
+int MediaPack::DecodeFrame()
+{
+	while (true) {
+		// decoder can return several frames for one packet and keeps frames in its threads
+		auto start = std::chrono::steady_clock::now();
+		int ret_code = 0;
+		{
+			TRACE_SCOPE("avcodec_receive_frame");
+			ret_code = avcodec_receive_frame(video_codec_ctx, video_frame_raw);
+		}
+		auto received = std::chrono::steady_clock::now();
+		decode_time += received - start;
+
+		// frames of the old decoder are drained, the held keyframe is the first packet of the new one
+		if (ret_code == AVERROR_EOF && reopen_pending) {
+			reopen_pending = false;
+			ReopenDecoder();
+
+			ret_code = SendVideoPacket();
+			if (ret_code < 0)
+				return ret_code;
+
+			continue;
+		}
+
+		if (ret_code != AVERROR(EAGAIN))
+			return ret_code;
+
+		{
+			TRACE_SCOPE("ReadPacket");
+			ret_code = ReadPacket(video_packet);
+		}
+		auto demuxed = std::chrono::steady_clock::now();
+		demux_time += demuxed - received;
+
+		if (ret_code == AVERROR_EOF) {
+			// every keyframe was read
+			if (indexing_from_start)
+				CompleteKeyframeIndex();
+
+			// no more packets - get all frames buffered by decoder
+			ret_code = avcodec_send_packet(video_codec_ctx, NULL);
+			if (ret_code < 0)
+				return ret_code;
+
+			continue;
+		}
+		else if (ret_code < 0)
+			return ret_code;
+
+		bool is_video = video_packet->stream_index == video_stream_idx;
+
+		// frames after seek can't be decoded before the first keyframe
+		if (is_video && seek_keyframe_wait) {
+			seek_keyframe_wait = !(video_packet->flags & AV_PKT_FLAG_KEY);
+			is_video = !seek_keyframe_wait;
+		}
+
+		if (!is_video) {
+			// packet struct is reused, only its data is freed
+			av_packet_unref(video_packet);
+			continue;
+		}
+
+		// players started or stopped, decoder takes its new share of cores from a keyframe
+		if ((video_packet->flags & AV_PKT_FLAG_KEY) && IsShareChanged() &&
+			avcodec_send_packet(video_codec_ctx, NULL) >= 0) {
+			reopen_pending = true;
+			continue;
+		}
+
+		ret_code = SendVideoPacket();
+		if (ret_code < 0)
+			return ret_code;
+	}
+}
+
+int MediaPack::SendVideoPacket()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	IndexKeyframe(video_packet);
+	ApplyReducedDecoding(video_packet);
+
+	// send packet to codec decoder
+	int ret_code = 0;
+	{
+		TRACE_SCOPE("avcodec_send_packet");
+		ret_code = avcodec_send_packet(video_codec_ctx, video_packet);
+	}
+	decode_time += std::chrono::steady_clock::now() - start;
+
+	// packet struct is reused, only its data is freed
+	av_packet_unref(video_packet);
+
+	return ret_code == AVERROR(EAGAIN) ? 0 : ret_code;
+}
+
+void MediaPack::ApplyReducedDecoding(const AVPacket* packet)
+{
+	// stored frames are shown in every loop, so none of them can be missed
+	bool is_storing = at_loop_start || preroll_filling || preroll_playing ||
+		(cache_state != CacheState::Off && cache_state != CacheState::Prefix);
+
+	// frames before seek position aren't shown at all
+	bool before_seek = seek_pts != AV_NOPTS_VALUE && packet->pts != AV_NOPTS_VALUE &&
+		packet->pts + std::max<int64_t>(packet->duration, 1) <= seek_pts;
+
+	bool skip_frames = (reduced_decoding && !is_storing) || before_seek;
+	if (skip_frames == is_skipping_frames)
+		return;
+
+	// B-frames nobody refers to aren't decoded at all
+	video_codec_ctx->skip_frame = skip_frames ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+	is_skipping_frames = skip_frames;
+}
+
+int MediaPack::RestartDecoder()
+{
+	// seek to keyframe, so the first frames aren't decoded from missing references
+	int ret_code = SeekDemuxer(start_pts);
+	if (ret_code < 0)
+		return ret_code;
+
+	// drop frames of the previous loop and leave draining mode
+	avcodec_flush_buffers(video_codec_ctx);
+
+	at_loop_start = true;
+	indexing_from_start = !keyframe_index.IsComplete();
+
+	return 0;
+}
+
+void MediaPack::IndexKeyframe(const AVPacket* packet)
+{
+	if (!indexing_from_start || !(packet->flags & AV_PKT_FLAG_KEY))
+		return;
+
+	// MP4 index has decoding timestamps, they are the same for keyframes without reordering
+	int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+	if (pts != AV_NOPTS_VALUE)
+		keyframe_index.Add(pts, packet->pos);
+}
+
+void MediaPack::CompleteKeyframeIndex()
+{
+	keyframe_index.SetComplete(true);
+	indexing_from_start = false;
+
+	// index is kept with stream params of media, it isn't built again next time
+	ProbeCache::Entry entry;
+	if (!input_options.use_probe_cache || !ProbeCache::Load(path_to_media, entry) || entry.keyframes_complete)
+		return;
+
+	entry.keyframes = keyframe_index.GetKeyframes();
+	entry.keyframes_complete = true;
+	ProbeCache::Store(path_to_media, entry);
+}
+
+int MediaPack::ReadPacket(AVPacket* packet)
+{
+	if (use_demuxer_thread && !demuxer_thread.joinable()) {
+		// new demuxer continues after packets which are left in queue
+		packet_queue->Resume();
+
+		try {
+			demuxer_thread = std::thread(&MediaPack::DemuxerThreadFunction, this);
+		}
+		catch (std::exception&) {
+			packet_queue->Abort();
+			use_demuxer_thread = false;
+		}
+	}
+
+	// packets read ahead are decoded first, even after demuxer is stopped
+	int ret_code = packet_queue->Read(packet);
+	if (ret_code != AVERROR_EXIT)
+		return ret_code;
+
+	return av_read_frame(media_ctx, packet);
+}
+
+int MediaPack::SeekDemuxer(int64_t pts)
+{
+	// packets after the old position are useless, decoder is reopened from the next keyframe
+	StopDemuxer();
+	packet_queue->Reset();
+
+	if (reopen_pending) {
+		av_packet_unref(video_packet);
+		reopen_pending = false;
+	}
+
+	return av_seek_frame(media_ctx, video_stream_idx, pts, AVSEEK_FLAG_BACKWARD);
+}
+
+void MediaPack::StopDemuxer()
+{
+	if (!demuxer_thread.joinable())
+		return;
+
+	packet_queue->Abort();
+	demuxer_thread.join();
+}
+
+void MediaPack::DemuxerThreadFunction()
+{
+	TRACE_THREAD_NAME("demuxer");
+
+	double default_duration = std::chrono::duration<double>(frame_duration).count();
+
+	while (true) {
+		// waits while queue is above watermark
+		AVPacket* packet = packet_queue->BeginWrite();
+		if (!packet)
+			return;
+
+		int ret_code = 0;
+		{
+			TRACE_SCOPE("av_read_frame");
+			ret_code = av_read_frame(media_ctx, packet);
+		}
+
+		if (ret_code < 0) {
+			packet_queue->Finish(ret_code);
+			return;
+		}
+
+		// other streams aren't decoded
+		if (packet->stream_index != video_stream_idx) {
+			av_packet_unref(packet);
+			continue;
+		}
+
+		packet_queue->EndWrite(packet->duration > 0 ? packet->duration * base_time : default_duration);
+	}
+}
+
+void MediaPack::ResetLoopCache()
+{
+	// preroll has frames of the old size too
+	long row_size = scaling_width * GetBytesPerPixel(output_format);
+	preroll_cache.Reset(preroll_frames * LoopCache::GetFrameSize(row_size, scaling_height), row_size, scaling_height);
+	preroll_position = 0;
+	preroll_filling = false;
+	preroll_playing = false;
+
+	if (loop_cache_budget == 0) {
+		loop_cache.Clear();
+		cache_state = CacheState::Off;
+		return;
+	}
+
+	loop_cache.Reset(loop_cache_budget, row_size, scaling_height);
+
+	// frames can be cached only from the beginning of the loop
+	cache_state = CacheState::Waiting;
+	cache_position = 0;
+	decoder_positioned = true;
+}
+
+void MediaPack::CacheFrame(const uint8_t* src, int src_stride, int64_t pts, bool is_keyframe)
+{
+	// decoding can't be resumed without timestamps
+	if (pts == AV_NOPTS_VALUE) {
+		loop_cache.Clear();
+		cache_state = CacheState::Off;
+		return;
+	}
+
+	LoopCache::Entry entry = { nullptr, last_timestamp - loop_offset, last_duration, pts, is_keyframe };
+	if (loop_cache.AddFrame(src, src_stride, entry))
+		return;
+
+	// budget is over - keep frames before a keyframe, the rest of the loop will be decoded from it
+	if (is_keyframe && loop_cache.GetFramesCount() > 0) {
+		resume_pts = pts;
+	}
+	else if (!loop_cache.TrimToLastKeyframe(resume_pts)) {
+		cache_state = CacheState::Off;
+		return;
+	}
+
+	cache_state = CacheState::Prefix;
+
+	// in this loop decoder is already after the prefix
+	cache_position = loop_cache.GetFramesCount();
+	decoder_positioned = true;
+}
+
+bool MediaPack::SeekCachedFrame(double position)
+{
+	if (cache_state != CacheState::Complete && cache_state != CacheState::Prefix)
+		return false;
+
+	size_t frames_count = loop_cache.GetFramesCount();
+	if (frames_count == 0)
+		return false;
+
+	// cached timestamps are relative to the loop start, the last frame which starts at or before position
+	size_t first = 0, count = frames_count;
+	while (count > 0) {
+		size_t step = count / 2;
+		if (loop_cache.GetFrame(first + step).timestamp <= position) {
+			first += step + 1;
+			count -= step + 1;
+		}
+		else
+			count = step;
+	}
+	size_t index = first > 0 ? first - 1 : 0;
+
+	// position is after the cached prefix
+	const LoopCache::Entry& entry = loop_cache.GetFrame(index);
+	if (cache_state == CacheState::Prefix && index + 1 == frames_count && position >= entry.timestamp + entry.duration)
+		return false;
+
+	cache_position = index;
+	loop_offset = last_timestamp + last_duration - entry.timestamp;
+
+	// decoder seek which wasn't read yet is replaced
+	seek_pts = AV_NOPTS_VALUE;
+	seek_keyframe_wait = false;
+	seek_continue = false;
+	seek_retry = false;
+
+	// after the prefix decoding continues from its end
+	if (cache_state == CacheState::Prefix)
+		decoder_positioned = false;
+
+	return true;
+}
+
+int MediaPack::ReadCachedFrame(Frame& frame, uint8_t* dst_buf, int dst_stride)
+{
+	// the whole loop is cached - just start it again
+	if (cache_state == CacheState::Complete && cache_position >= loop_cache.GetFramesCount()) {
+		loop_offset = last_timestamp + last_duration;
+		cache_position = 0;
+	}
+
+	int ret_code = CopyCachedFrame(loop_cache, cache_position, frame, dst_buf, dst_stride);
+	if (ret_code < 0)
+		return ret_code;
+
+	++cache_position;
+
+	return 0;
+}
+
+int MediaPack::CopyCachedFrame(LoopCache& cache, size_t index, Frame& frame, uint8_t* dst_buf, int dst_stride)
+{
+	if (!cache.CopyFrame(index, dst_buf, dst_stride))
+		return -1;
+
+	const LoopCache::Entry& entry = cache.GetFrame(index);
+
+	last_timestamp = entry.timestamp + loop_offset;
+	last_duration = entry.duration;
+
+	frame.timestamp = last_timestamp;
+	frame.duration = last_duration;
+	frame.position = entry.timestamp;
+
+	return 0;
+}
+
+void MediaPack::AddPrerollFrame(const uint8_t* src, int src_stride, int64_t pts, bool is_keyframe)
+{
+	LoopCache::Entry entry = { nullptr, last_timestamp - loop_offset, last_duration, pts, is_keyframe };
+	if (!preroll_cache.AddFrame(src, src_stride, entry) || preroll_cache.GetFramesCount() >= preroll_frames)
+		preroll_filling = false;
+}
+
+int MediaPack::ReadPrerollFrame(Frame& frame, uint8_t* dst_buf, int dst_stride)
+{
+	int ret_code = CopyCachedFrame(preroll_cache, preroll_position, frame, dst_buf, dst_stride);
+	if (ret_code < 0) {
+		preroll_playing = false;
+		return ret_code;
+	}
+
+	const LoopCache::Entry& entry = preroll_cache.GetFrame(preroll_position);
+	++preroll_position;
+
+	// frames of the loop beginning aren't converted again, so loop cache takes them from preroll
+	if (at_loop_start && cache_state == CacheState::Waiting)
+		cache_state = CacheState::Filling;
+	at_loop_start = false;
+
+	if (cache_state == CacheState::Filling)
+		CacheFrame(dst_buf, dst_stride, entry.pts, entry.is_keyframe);
+
+	// decoder goes through the same frame in the meantime, it is already shown
+	ret_code = DecodeFrame();
+	if (ret_code == 0)
+		av_frame_unref(video_frame_raw);
+
+	if (ret_code < 0 || preroll_position >= preroll_cache.GetFramesCount())
+		preroll_playing = false;
+
+	return 0;
+}
+
+AVPixelFormat MediaPack::GetOutputPixelFormat()
+{
+	return output_format == FrameFormat::BGR24 ? AV_PIX_FMT_BGR24 : AV_PIX_FMT_BGRA;
+}
+
+void MediaPack::SetSwsColorspace(AVColorSpace colorspace, bool full_range)
+{
+	if (sws_colorspace == (int)colorspace && sws_range == (int)full_range)
+		return;
+
+	// unknown colorspaces get the default BT.601 matrix, destination range is only used for YUV output
+	sws_setColorspaceDetails(sws_ctx, sws_getCoefficients(colorspace), full_range ? 1 : 0,
+		sws_getCoefficients(SWS_CS_DEFAULT), 0, 0, 1 << 16, 1 << 16);
+
+	sws_colorspace = colorspace;
+	sws_range = full_range;
+}
+
+void MediaPack::GetCropPlanes(AVFrame* src_frame, const uint8_t* src_data[4])
+{
+	for (int plane = 0; plane < 4; ++plane)
+		src_data[plane] = src_frame->data[plane];
+
+	if (crop_x == 0 && crop_y == 0)
+		return;
+
+	const AVPixFmtDescriptor* pix_desc = av_pix_fmt_desc_get((AVPixelFormat)src_frame->format);
+	if (!pix_desc)
+		return;
+
+	// every plane is moved only once, by the first component stored in it
+	bool moved[4] = { false, false, false, false };
+	for (int c = 0; c < pix_desc->nb_components; ++c) {
+		int plane = pix_desc->comp[c].plane;
+		if (plane >= 4 || moved[plane] || !src_data[plane])
+			continue;
+
+		// chroma planes of YUV formats are subsampled
+		bool is_chroma = (c == 1 || c == 2) && pix_desc->nb_components >= 3 && !(pix_desc->flags & AV_PIX_FMT_FLAG_RGB);
+		long plane_x = is_chroma ? (crop_x >> pix_desc->log2_chroma_w) : crop_x;
+		long plane_y = is_chroma ? (crop_y >> pix_desc->log2_chroma_h) : crop_y;
+
+		src_data[plane] += (ptrdiff_t)plane_y * src_frame->linesize[plane] + (ptrdiff_t)plane_x * pix_desc->comp[c].step;
+		moved[plane] = true;
+	}
 }
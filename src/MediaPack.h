@@ -4,23 +4,40 @@ extern "C"
 {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libavdevice/avdevice.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 }
 
 #include <iostream>
 #include <string>
 #include <chrono>
 #include <thread>
+#include <memory>
+#include <atomic>
 
 #include "Frame.h"
+#include "DecodeBudget.h"
+#include "ColorConverter.h"
+#include "LoopCache.h"
+#include "BakedMedia.h"
+#include "FramePool.h"
+#include "PacketQueue.h"
+#include "MediaInput.h"
+#include "ProbeCache.h"
+#include "KeyframeIndex.h"
 
 typedef std::chrono::duration<float, std::milli> ms;
 
 
 class MediaPack {
 public:
-	MediaPack(std::string path);
+	// path is media file, baked file or "lavfi:<filtergraph>" test source,
+	// e.g. "lavfi:testsrc2=size=1920x1080:rate=60:duration=10";
+	// decode_threads == 0 - take a share from DecodeBudget, decoder is reopened at a keyframe when it changes;
+	// input_options - how local files are read, other streams than video are discarded by default
+	MediaPack(std::string path, int decode_threads = 0, const InputOptions& input_options = InputOptions());
 
 	~MediaPack();
 
@@ -29,43 +46,195 @@ public:
 	MediaPack(MediaPack&& obj) noexcept;
 	MediaPack& operator=(MediaPack&& obj) = delete;
 
+	// format of converted frames, SetScaling must be called after changing it
+	bool SetOutputFormat(FrameFormat format);
+	FrameFormat GetOutputFormat();
+
 	bool SetScaling(long width = 0, long height = 0);
 
+	// convert only the source region (src_x, src_y, src_width, src_height) and scale it to width x height
+	bool SetScaling(long width, long height, long src_x, long src_y, long src_width, long src_height);
+
 	int GetNextFrame(Frame &frame, bool loop_media = false);
 
+	// keep converted frames of the first loop in memory (budget in bytes, 0 - disabled),
+	// if the whole loop doesn't fit - only its beginning is cached
+	bool SetLoopCache(size_t budget);
+	size_t GetLoopCacheFrames();
+	size_t GetLoopCacheMemory();
+
+	// first frames of the loop kept in memory, they are shown while decoder is restarted
+	// at the loop boundary (0 - disabled)
+	bool SetLoopPreroll(size_t frames);
+
+	// loop boundaries passed and time taken to read the first frame of a loop
+	size_t GetLoopsCount();
+	ms GetLastLoopLatency();
+	ms GetMaxLoopLatency();
+
+	// decode next frame directly into memory owned by caller (e.g. monitor's DIB section):
+	// frame.frame_buf with row stride frame.linesize (0 - default stride), which must hold
+	// scaled frame (at least GetFrameBufferSize() bytes for default stride)
+	int DecodeNextFrame(Frame& frame, bool loop_media = false);
+
+	// decoder skips non-reference frames to save CPU under load, can be called from any thread;
+	// frames stored into loop cache or preroll are always decoded fully
+	void SetReducedDecoding(bool reduced);
+	bool IsReducedDecoding();
+
+	// packets are read ahead by a separate demuxer thread, so slow disks don't stall decoding
+	// (enabled by default); can be changed only while frames aren't read
+	bool SetDemuxerThread(bool enabled);
+	PacketQueue::Stats GetDemuxerStats();
+
+	// reads of custom input, zeros when file is read by FFmpeg itself
+	InputStats GetInputStats();
+
+	// stream params were taken from ProbeCache instead of probing the file
+	bool IsProbeCached();
+
+	// the next frame is the one shown at position (seconds from the beginning of media): decoding
+	// starts at the preceding keyframe and earlier frames aren't returned, timestamps continue
+	// after the last returned frame; can be called only while frames aren't read
+	int Seek(double position);
+
+	// read packets of the whole file without decoding to index every keyframe, the index is kept
+	// in probe cache; otherwise it is completed when media is played to the end
+	bool ScanKeyframes();
+	size_t GetKeyframesCount();
+	bool IsKeyframeIndexComplete();
+
 	bool IsLoaded();
 
+	// media is a file made by BakedMedia::Bake: it can't be scaled and GetNextFrame
+	// returns pointers into the file mapping without decoding
+	bool IsBaked();
+
 	bool GetVideoResolution(long& width, long& height);
+	bool GetScaledResolution(long& width, long& height);
 	ms GetFrameDuration();
+	size_t GetFrameBufferSize();
 	std::string GetMediaPath();
+	int GetDecodeThreads();
 
 private:
 	bool LoadMedia(std::string path);
+	bool LoadBakedMedia(std::string path);
 	void FreeMedia();
 
+	// decode next frame, convert it into dst_buf and fill frame's timestamps
+	int ReadFrame(Frame& frame, uint8_t* dst_buf, int dst_stride, bool loop_media);
+	int NextFrame(Frame& frame, uint8_t* dst_buf, int dst_stride, bool loop_media);
+
+	// next decoded frame in video_frame_raw, AVERROR_EOF after all buffered frames are drained
+	int DecodeFrame();
+
+	// index, send and unref packet of video stream in video_packet
+	int SendVideoPacket();
+
+	// new decoder context with decode_threads or the current share of DecodeBudget, NULL on failure
+	AVCodecContext* OpenDecoder();
+
+	// drained decoder is replaced by a new one, the old one is kept if it can't be opened
+	void ReopenDecoder();
+
+	// share of DecodeBudget differs from threads of the open decoder
+	bool IsShareChanged();
+
+	// time spent on the frame which is being read, copied into Frame
+	std::chrono::steady_clock::duration demux_time{ 0 }, decode_time{ 0 }, convert_time{ 0 };
+
+	// switch decoder's skip_frame for the packet when frames aren't stored or shown
+	void ApplyReducedDecoding(const AVPacket* packet);
+
+	// seek served by loop cache, false if frames at position aren't cached
+	bool SeekCachedFrame(double position);
+
+	// keyframes of packets read from the beginning of media, complete index is stored into probe cache
+	void IndexKeyframe(const AVPacket* packet);
+	void CompleteKeyframeIndex();
+
+	// seek to the first keyframe and drop decoder state
+	int RestartDecoder();
+
+	// next packet of video stream from demuxer thread or directly from the file
+	int ReadPacket(AVPacket* packet);
+
+	// demuxer thread is stopped, it is started again by the next ReadPacket
+	int SeekDemuxer(int64_t pts);
+	void StopDemuxer();
+	void DemuxerThreadFunction();
+
+	// loop cache
+	void ResetLoopCache();
+	void CacheFrame(const uint8_t* src, int src_stride, int64_t pts, bool is_keyframe);
+	int ReadCachedFrame(Frame& frame, uint8_t* dst_buf, int dst_stride);
+	int CopyCachedFrame(LoopCache& cache, size_t index, Frame& frame, uint8_t* dst_buf, int dst_stride);
+
+	// loop preroll
+	void AddPrerollFrame(const uint8_t* src, int src_stride, int64_t pts, bool is_keyframe);
+	int ReadPrerollFrame(Frame& frame, uint8_t* dst_buf, int dst_stride);
+
 	std::string path_to_media;
 
 	bool is_loaded = false;
 	long scaling_width = 0, scaling_height = 0;
 
+	// converted frames format
+	FrameFormat output_format = FrameFormat::BGRA;
+	AVPixelFormat GetOutputPixelFormat();
+
+	// source region which is converted, offsets are aligned to chroma subsampling
+	long crop_x = 0, crop_y = 0;
+	long crop_width = 0, crop_height = 0;
+
+	// byte offsets of the crop region in every plane of decoded frame
+	void GetCropPlanes(AVFrame* src_frame, const uint8_t* src_data[4]);
+
 	int video_stream_idx = -1, audio_stream_idx = -1;
 
+	// number of threads used by decoder
+	int decode_threads = 0;
+
+	// threads follow share of DecodeBudget: old decoder is drained before a keyframe and reopened,
+	// the keyframe is held in video_packet meanwhile
+	bool use_budget_share = false;
+	unsigned int budget_version = 0;
+	bool reopen_pending = false;
+
+	// already decoded and converted frames, FFmpeg contexts aren't used
+	std::unique_ptr<BakedMedia> baked_media;
+
+	// local file is read by our input instead of FFmpeg's file protocol, it must outlive media_ctx
+	InputOptions input_options;
+	std::unique_ptr<MediaInput> media_input;
+	bool probe_cached = false;
+
 	// media contexts
 	AVFormatContext* media_ctx = NULL;
 	AVCodecParameters* video_codec_params = NULL;
-	AVCodec* video_codec = NULL;
+	const AVCodec* video_codec = NULL;
 	AVCodecContext* video_codec_ctx = NULL;
 
 	// video decoding params
 	AVFrame* video_frame_raw = NULL, * video_frame_rgb = NULL;
-	uint8_t* video_buffer = NULL;
+	AVPacket* video_packet = NULL;
+	AVBufferRef* video_buffer = NULL;
 	size_t video_buffer_size = 0;
+	FramePool frame_pool;
 	int video_linesize = 0;
 
 	// video scaling/conversion context
 	SwsContext* sws_ctx = NULL;
-	uint8_t* sws_buffer = NULL;
-	size_t sws_buffer_size = 0;
+
+	// matrix and range swscale is set up for, -1 - defaults of a new context
+	int sws_colorspace = -1, sws_range = -1;
+
+	// swscale assumes BT.601 limited range, so it is given matrix and range of every frame
+	void SetSwsColorspace(AVColorSpace colorspace, bool full_range);
+
+	// frames aren't resized, so fast ColorConverter can be used instead of swscale
+	bool use_fast_convert = false;
 
 	// video stream
 	long frame_width = 0, frame_height = 0;
@@ -73,4 +242,61 @@ private:
 	double base_time = 0.0;
 	int64_t duration = 0;
 	ms frame_duration;
+
+	// timestamps of decoded frames
+	int64_t start_pts = 0;
+	double loop_offset = 0.0;
+	double last_timestamp = 0.0, last_duration = 0.0;
+
+	// converted frames of the first loop
+	enum class CacheState {
+		Off,
+		Waiting,	// for the start of the next loop
+		Filling,	// the first loop is being cached
+		Complete,	// the whole loop is cached
+		Prefix		// beginning of the loop is cached, the rest is decoded
+	};
+	LoopCache loop_cache;
+	size_t loop_cache_budget = 0;
+	CacheState cache_state = CacheState::Off;
+	size_t cache_position = 0;
+	bool at_loop_start = true;
+
+	// after cached prefix decoding continues from this keyframe
+	int64_t resume_pts = 0;
+	bool decoder_positioned = true;
+
+	// beginning of the loop, decoder goes through the same frames while they are shown
+	LoopCache preroll_cache;
+	size_t preroll_frames = 4;
+	size_t preroll_position = 0;
+	bool preroll_filling = false;
+	bool preroll_playing = false;
+
+	// requested by player and currently used by decoder
+	std::atomic<bool> reduced_decoding{ false };
+	bool is_skipping_frames = false;
+
+	// demuxer thread owns media_ctx while it runs, queue is created with media and never replaced
+	bool use_demuxer_thread = true;
+	std::unique_ptr<PacketQueue> packet_queue;
+	std::thread demuxer_thread;
+
+	// keyframes of video stream, packets are indexed while they are read without jumps from the start
+	KeyframeIndex keyframe_index;
+	bool indexing_from_start = true;
+
+	// frames which end before this timestamp are decoded only as references after seek,
+	// AV_NOPTS_VALUE - no seek
+	int64_t seek_pts = AV_NOPTS_VALUE;
+	// packets are dropped until keyframe, demuxer can land between keyframes without an index
+	bool seek_keyframe_wait = false;
+	// timestamp of the first frame after seek continues after the last returned frame
+	bool seek_continue = false;
+	// demuxer looked for the keyframe itself, it is sought once more if it is after position
+	bool seek_retry = false;
+
+	// loop boundary latency
+	size_t loops_count = 0;
+	ms last_loop_latency{ 0 }, max_loop_latency{ 0 };
 };
\ No newline at end of file
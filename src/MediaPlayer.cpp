@@ -1,92 +1,497 @@
 #include "MediaPlayer.h"
+#include "PlaybackPositions.h"
+#include "Tracer.h"
 
-MediaPlayer::MediaPlayer(Monitor& monitor) :
-	monitor(monitor)
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// pixels and timing of preloaded frame into a slot of frame queue, slot keeps its buffer and crop params
+static void CopyFrame(const Frame& src, Frame& dst)
+{
+	int dst_stride = dst.linesize > 0 ? dst.linesize : src.linesize;
+	size_t row_size = (size_t)src.original_width * src.bytes_per_pixel;
+
+	for (long row = 0; row < src.original_height; ++row)
+		std::memcpy(dst.frame_buf + (size_t)dst_stride * row, src.frame_buf + (size_t)src.linesize * row, row_size);
+
+	dst.original_width = src.original_width;
+	dst.original_height = src.original_height;
+	dst.format = src.format;
+	dst.bytes_per_pixel = src.bytes_per_pixel;
+	dst.linesize = dst_stride;
+
+	dst.timestamp = src.timestamp;
+	dst.duration = src.duration;
+	dst.position = src.position;
+
+	dst.prepare_start = src.prepare_start;
+	dst.demux_ms = src.demux_ms;
+	dst.decode_ms = src.decode_ms;
+	dst.convert_ms = src.convert_ms;
+}
+
+// frames of both media fit the same queue slots and are drawn with the same crop params
+static bool IsSameGeometry(const Frame& frame, const Frame& other)
 {
+	return frame.format == other.format && frame.x_offset == other.x_offset && frame.y_offset == other.y_offset &&
+		frame.crop_width == other.crop_width && frame.crop_height == other.crop_height;
+}
 
+MediaPlayer::MediaPlayer(FrameTarget& monitor, Compositor& compositor) :
+	monitor(monitor), compositor(compositor),
+	preloader([this](MediaPack& media, Frame& media_frame) { return PrepareMedia(media, media_frame); })
+{
 }
 
 MediaPlayer::~MediaPlayer()
 {
 	StopPlayer();
+
+	// preloader uses scaling of this player
+	preloader.Stop();
+
+	if (poster_thread.joinable())
+		poster_thread.join();
 }
 
 bool MediaPlayer::SetMedia(std::unique_ptr<MediaPack> new_media)
 {
-	if (!new_media.get()->IsLoaded())
+	if (!new_media || !new_media->IsLoaded())
 		return false;
 
 	StopPlayer();
 
+	// media chosen by user replaces playlist
+	playlist.Clear();
+
 	current_media = std::unique_ptr(std::move(new_media));
 
+	// media was opened before this player was counted, its decoder is reopened from the first keyframe
+	SetBudgetRegistered(true);
+
+	// position stored for this monitor is checked by the next start
+	resume_pending = true;
+	media_position = -1.0;
+
 	return true;
 }
 
-bool MediaPlayer::SetScaling()
+void MediaPlayer::SetBudgetRegistered(bool registered)
+{
+	if (registered == budget_registered)
+		return;
+
+	if (registered)
+		DecodeBudget::RegisterPlayer();
+	else
+		DecodeBudget::UnregisterPlayer();
+
+	budget_registered = registered;
+}
+
+bool MediaPlayer::SwitchMedia(const std::string& path)
+{
+	if (!player_thread.joinable() || !is_playing) {
+		std::unique_ptr<MediaPack> media;
+		try {
+			media = std::make_unique<MediaPack>(path);
+		}
+		catch (std::exception& exception) {
+			std::cout << path << ": " << exception.what() << std::endl;
+			return false;
+		}
+
+		return SetMedia(std::move(media)) && ApplyScaling(scaling_mode);
+	}
+
+	// decoder thread checks manual switch before it requests the next playlist item
+	std::lock_guard<std::mutex> lock(media_mutex);
+	switch_request_id = preloader.Request(path);
+
+	return true;
+}
+
+bool MediaPlayer::SetPlaylist(Playlist new_playlist)
+{
+	// the first item which can be opened
+	for (size_t i = 0; i < new_playlist.GetItemsCount(); i++) {
+		std::string path = new_playlist.GetItem(i);
+
+		std::unique_ptr<MediaPack> media;
+		try {
+			media = std::make_unique<MediaPack>(path);
+		}
+		catch (std::exception& exception) {
+			std::cout << path << ": " << exception.what() << std::endl;
+			continue;
+		}
+
+		if (!SetMedia(std::move(media)))
+			continue;
+
+		playlist = new_playlist;
+		playlist_index = i;
+		preload_index = i;
+
+		return true;
+	}
+
+	return false;
+}
+
+bool MediaPlayer::PrepareMedia(MediaPack& media, Frame& media_frame)
+{
+	// nobody can answer on preloader thread, so media is scaled like media smaller than monitor
+	ScalingMode mode = scaling_mode;
+	if (mode == ScalingMode::Ask)
+		mode = ScalingMode::Scale;
+
+	if (!ApplyScaling(media, media_frame, mode))
+		return false;
+
+	size_t budget = loop_cache_budget;
+	if (budget > 0)
+		media.SetLoopCache(budget);
+
+	return true;
+}
+
+bool MediaPlayer::SetScaling(ScalingMode mode)
 {
 	if (!current_media)
 		return false;
 
+	// decoder converts frames with scaling of media, so it can't be changed under it
+	bool was_playing = player_thread.joinable();
+	StopPlayer();
+
+	bool success = ApplyScaling(mode);
+
+	if (was_playing && success)
+		success = StartPlayer(loop_media);
+
+	return success;
+}
+
+bool MediaPlayer::ApplyScaling(ScalingMode mode)
+{
+	if (!ApplyScaling(*current_media, frame, mode))
+		return false;
+
+	// the same choice is used for switched media
+	scaling_mode = mode;
+
+	UpdateMirrorsScaling(*current_media);
+
+	return true;
+}
+
+bool MediaPlayer::ApplyScaling(MediaPack& media, Frame& media_frame, ScalingMode& mode)
+{
 	long monitor_width, monitor_height;
 	if (!monitor.GetResolution(monitor_width, monitor_height)) {
 		return false;
 	}
 
 	long media_width, media_height;
-	if (!current_media->GetVideoResolution(media_width, media_height)) {
+	if (!media.GetVideoResolution(media_width, media_height)) {
 		return false;
 	}
 
 
+	// baked media keeps its own format
+	media.SetOutputFormat(frame_format);
+	media_frame.format = media.GetOutputFormat();
+	media_frame.bytes_per_pixel = GetBytesPerPixel(media_frame.format);
+
 	// set frame params to default
-	frame.x_offset = 0;
-	frame.y_offset = 0;
-	frame.crop_width = monitor_width;
-	frame.crop_height = monitor_height;
+	media_frame.x_offset = 0;
+	media_frame.y_offset = 0;
+	media_frame.crop_width = monitor_width;
+	media_frame.crop_height = monitor_height;
+
+	// baked media is already scaled, monitor only stretches it if resolution is different
+	if (media.IsBaked()) {
+		media_frame.crop_width = media_width;
+		media_frame.crop_height = media_height;
+
+		return true;
+	}
 
 	// check resolutions
 	if (monitor_width == media_width && monitor_height == media_height) {
 		// same resolution
 
-		current_media->SetScaling(monitor_width, monitor_height);
+		media.SetScaling(monitor_width, monitor_height);
 	} 
 	else if (monitor_width < media_width || monitor_height < media_height) {
 		// media is bigger
 
-		std::cout << "Crop (1) or scale (2) image?" << std::endl;
-
-		int option = -1;
-		std::cin >> option;
+		int option = (int)mode;
+		if (mode == ScalingMode::Ask) {
+			std::cout << "Crop (1), scale (2) or fill (3) image?" << std::endl;
+			std::cin >> option;
+		}
 
 		if (option == 1) {
 			// crop
 
-			current_media->SetScaling();
+			long visible_width = (media_width > monitor_width) ? (monitor_width) : media_width;
+			long visible_height = (media_height > monitor_height) ? (monitor_height) : media_height;
+			long crop_x = (media_width - visible_width) / 2;
+			long crop_y = (media_height - visible_height) / 2;
+
+			media_frame.crop_width = visible_width;
+			media_frame.crop_height = visible_height;
 
-			frame.x_offset = (media_width - monitor_width) / 2;
-			frame.y_offset = (media_height - monitor_height) / 2;
+			// only visible region is converted
+			if (!media.SetScaling(visible_width, visible_height, crop_x, crop_y, visible_width, visible_height)) {
+				// this pixel format can't be cropped by scaler - convert whole frame and crop it while drawing
+				media.SetScaling();
 
-			frame.crop_width = (media_width > monitor_width) ? (monitor_width) : media_width;
-			frame.crop_height = (media_height > monitor_height) ? (monitor_height) : media_height;
+				media_frame.x_offset = crop_x;
+				media_frame.y_offset = crop_y;
+			}
 		}
 		else if (option == 2) {
 			// scale
 
-			current_media->SetScaling(monitor_width, monitor_height);
+			media.SetScaling(monitor_width, monitor_height);
+		}
+		else if (option == 3) {
+			// crop to monitor's aspect ratio and scale
+
+			SetFillScaling(media, monitor_width, monitor_height, media_width, media_height);
 		}
 		else {
 			std::cout << "Wrong option." << std::endl;
 			return false;
 		}
+
+		mode = (ScalingMode)option;
 	}
 	else {
 		// media is smaller
-		// just scale it to monitor resolution
+		// just scale it to monitor resolution, or fill monitor if aspect ratios are different
+
+		int option = mode == ScalingMode::Fill ? 3 : 2;
+		if (mode == ScalingMode::Ask && monitor_width * media_height != media_width * monitor_height) {
+			std::cout << "Scale (2) or fill (3) image?" << std::endl;
+			std::cin >> option;
+		}
+
+		if (option == 3)
+			SetFillScaling(media, monitor_width, monitor_height, media_width, media_height);
+		else
+			media.SetScaling(monitor_width, monitor_height);
+
+		if (mode == ScalingMode::Ask)
+			mode = (ScalingMode)option;
+	}
+
+	return true;
+}
+
+bool MediaPlayer::SetFrameFormat(FrameFormat format)
+{
+	frame_format = format;
+
+	return true;
+}
+
+bool MediaPlayer::SetFillScaling(MediaPack& media, long monitor_width, long monitor_height, long media_width, long media_height)
+{
+	// the biggest centered region of media with monitor's aspect ratio,
+	// e.g. the middle of 21:9 video on 16:9 monitor
+	long fill_width = media_width, fill_height = media_height;
+	if (media_width * monitor_height > monitor_width * media_height)
+		fill_width = media_height * monitor_width / monitor_height;
+	else
+		fill_height = media_width * monitor_height / monitor_width;
+
+	long crop_x = (media_width - fill_width) / 2;
+	long crop_y = (media_height - fill_height) / 2;
+
+	if (media.SetScaling(monitor_width, monitor_height, crop_x, crop_y, fill_width, fill_height))
+		return true;
+
+	// can't crop this pixel format in scaler, so just scale whole frame
+	return media.SetScaling(monitor_width, monitor_height);
+}
+
+bool MediaPlayer::AddMirror(FrameTarget& mirror_monitor)
+{
+	if (mirror_monitor.GetTargetID() == monitor.GetTargetID() || HasMirror(mirror_monitor.GetTargetID()))
+		return false;
+
+	// mirrors list is used by player thread
+	bool was_playing = player_thread.joinable();
+	StopPlayer();
+
+	mirrors.push_back({ &mirror_monitor, frame, 0 });
+	if (current_media)
+		UpdateMirrorsScaling(*current_media);
+
+	if (was_playing)
+		StartPlayer(loop_media);
+
+	return true;
+}
+
+bool MediaPlayer::RemoveMirror(int monitor_id)
+{
+	if (!HasMirror(monitor_id))
+		return false;
+
+	bool was_playing = player_thread.joinable();
+	StopPlayer();
 
-		current_media->SetScaling(monitor_width, monitor_height);
+	for (auto it = mirrors.begin(); it != mirrors.end(); ++it) {
+		if (it->monitor->GetTargetID() == monitor_id) {
+			mirrors.erase(it);
+			break;
+		}
 	}
-	
+
+	if (was_playing)
+		StartPlayer(loop_media);
+
+	return true;
+}
+
+bool MediaPlayer::HasMirror(int monitor_id)
+{
+	for (auto& mirror : mirrors) {
+		if (mirror.monitor->GetTargetID() == monitor_id)
+			return true;
+	}
+
+	return false;
+}
+
+void MediaPlayer::UpdateMirrorsScaling(MediaPack& media)
+{
+	long monitor_width, monitor_height;
+	if (!monitor.GetResolution(monitor_width, monitor_height))
+		return;
+
+	long scaled_width, scaled_height;
+	if (!media.GetScaledResolution(scaled_width, scaled_height))
+		return;
+
+	for (auto& mirror : mirrors) {
+		long mirror_width, mirror_height;
+		if (!mirror.monitor->GetResolution(mirror_width, mirror_height))
+			continue;
+
+		if (mirror_width == monitor_width && mirror_height == monitor_height) {
+			// same resolution - show exactly the same region without any scaling
+			mirror.frame = frame;
+		}
+		else {
+			// different resolution - monitor stretches the whole frame
+			mirror.frame.x_offset = 0;
+			mirror.frame.y_offset = 0;
+			mirror.frame.crop_width = scaled_width;
+			mirror.frame.crop_height = scaled_height;
+		}
+	}
+}
+
+bool MediaPlayer::SetLoopCache(size_t budget)
+{
+	if (!current_media)
+		return false;
+
+	// media is used by decoder thread
+	if (player_thread.joinable())
+		return false;
+
+	// switched media gets the same budget
+	loop_cache_budget = budget;
+
+	return current_media->SetLoopCache(budget);
+}
+
+bool MediaPlayer::BakeMedia(std::string baked_path, size_t& frames_count)
+{
+	frames_count = 0;
+
+	if (!current_media || current_media->IsBaked())
+		return false;
+
+	// region cropped only while drawing can't be baked
+	if (frame.x_offset != 0 || frame.y_offset != 0)
+		return false;
+
+	StopPlayer();
+
+	bool success = BakedMedia::Bake(*current_media, baked_path, frames_count);
+
+	// media was read till the end
+	current_media.reset();
+
+	return success;
+}
+
+bool MediaPlayer::Seek(double position)
+{
+	if (!current_media || position < 0.0)
+		return false;
+
+	// decoder reads media, so it can't be moved under it
+	bool was_playing = player_thread.joinable();
+	StopPlayer();
+
+	bool success = current_media->Seek(position) == 0;
+	if (success) {
+		media_position = position;
+		resume_pending = false;
+	}
+
+	if (was_playing)
+		success = StartPlayer(loop_media) && success;
+
+	return success;
+}
+
+bool MediaPlayer::SetResume(bool enabled)
+{
+	resume_enabled = enabled;
+
+	return true;
+}
+
+bool MediaPlayer::SetPoster(bool enabled)
+{
+	poster_enabled = enabled;
+
+	return true;
+}
+
+bool MediaPlayer::SetQueueDepth(size_t depth)
+{
+	if (depth == 0)
+		return false;
+
+	// will be applied on the next start
+	queue_depth = depth;
+
+	return true;
+}
+
+bool MediaPlayer::SetPlaybackPolicy(std::shared_ptr<PlaybackPolicy> policy)
+{
+	// policy is used by player thread
+	bool was_playing = player_thread.joinable();
+	StopPlayer();
+
+	playback_policy = policy;
+
+	if (was_playing)
+		StartPlayer(loop_media);
+
 	return true;
 }
 
@@ -94,66 +499,715 @@ bool MediaPlayer::StartPlayer(bool loop)
 {
 	StopPlayer();
 
+	if (!current_media)
+		return false;
+
+	// media is played from where it was stopped last time on this monitor
+	bool first_start = resume_pending;
+	double start_position = 0.0;
+	if (resume_pending && resume_enabled) {
+		std::string stored_path;
+		double stored_position = 0.0;
+		if (PlaybackPositions::Load(monitor.GetTargetID(), stored_path, stored_position) &&
+			stored_path == current_media->GetMediaPath() && stored_position > 0.0 && current_media->Seek(stored_position) == 0) {
+			media_position = stored_position;
+			start_position = stored_position;
+		}
+	}
+	resume_pending = false;
+
+	if (!CreateFrameQueue(*current_media))
+		return false;
+
+	// monitor isn't blank while the first frame is decoded, a missing poster is taken from it
+	show_poster = false;
+	capture_poster = false;
+	if (poster_enabled && first_start && MediaInput::IsLocalFile(current_media->GetMediaPath())) {
+		poster_path = current_media->GetMediaPath();
+		poster_layout = GetPosterLayout();
+		poster_position = start_position;
+
+		show_poster = PosterCache::IsStored(poster_path, poster_layout, poster_position);
+		capture_poster = !show_poster;
+	}
+
 	loop_media = loop;
+	decoding_finished = false;
+
+	// timestamps of switched media continue from here
+	timestamp_offset = 0.0;
+	next_timestamp = 0.0;
+	item_started = false;
+	rotation_due = false;
+
+	shown_position = -1.0;
+
+	// decoders of other players and the next item share cores with this player too
+	SetBudgetRegistered(true);
+
+	// player is started with the current scaling, so the next item is prepared with it
+	RequestNextItem();
+
+	// player thread clears it when it stops by itself
+	is_playing = true;
+
+	decoder_paused = false;
+	keep_decoding.test_and_set();
+	decoder_thread = std::thread(&MediaPlayer::DecoderThreadFunction, this);
+
 	keep_drawing.test_and_set();
 	player_thread = std::thread(&MediaPlayer::PlayerThreadFunction, this);
 
 	return true;
 }
 
+bool MediaPlayer::CreateFrameQueue(MediaPack& media)
+{
+	try {
+		long scaled_width = 0, scaled_height = 0;
+		media.GetScaledResolution(scaled_width, scaled_height);
+
+		// whole frame is shown - decode straight into monitor's DIB sections
+		std::vector<Frame> surface_frames;
+		bool whole_frame = frame.x_offset == 0 && frame.y_offset == 0 &&
+			frame.crop_width == scaled_width && frame.crop_height == scaled_height;
+
+		// baked frames are taken straight from the file mapping, so surfaces aren't needed
+		if (media.IsBaked())
+			whole_frame = false;
+
+		if (whole_frame && monitor.CreateSurfaces(queue_depth, scaled_width, scaled_height, frame, surface_frames))
+			frame_queue = std::make_unique<FrameQueue>(surface_frames);
+		else if (frame_pool.SetBufferSize(media.GetFrameBufferSize()))
+			frame_queue = std::make_unique<FrameQueue>(queue_depth, frame_pool, frame);
+		else
+			throw std::runtime_error("Can't allocate frame queue buffers.");
+	}
+	catch (std::exception& exception) {
+		std::cout << exception.what() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
 void MediaPlayer::StopPlayer()
 {
+	bool was_running = player_thread.joinable() || decoder_thread.joinable();
+
+	// player thread is stopped first, it wakes up paused decoder
 	if (player_thread.joinable()) {
 		keep_drawing.clear();
 		player_thread.join();
 	}
 
+	if (decoder_thread.joinable()) {
+		keep_decoding.clear();
+		decoder_thread.join();
+	}
+
+	SetBudgetRegistered(false);
+
+	const Frame* next_frame = nullptr;
+	if (was_running)
+		media_position = GetStopPosition(next_frame);
+
+	// crop params were already changed for switching media, so it becomes current
+	if (switching_media && !rebuild_queue) {
+		current_media = std::move(switching_media->media);
+		media_position = switching_media->frame.position;
+		next_frame = &switching_media->frame;
+	}
+
+	if (was_running && resume_enabled && current_media && media_position >= 0.0) {
+		PlaybackPositions::Store(monitor.GetTargetID(), current_media->GetMediaPath(), media_position);
+
+		// the next start is resumed from this frame, so it is its poster
+		if (poster_enabled && next_frame && MediaInput::IsLocalFile(current_media->GetMediaPath())) {
+			poster_path = current_media->GetMediaPath();
+			poster_layout = GetPosterLayout();
+			StorePoster(*next_frame, media_position);
+		}
+	}
+
+	frame_queue.reset();
+	monitor.ReleaseSurfaces();
+
+	// switch which isn't done yet is dropped, scaling can be changed before the next start
+	preloader.Cancel();
+	switch_request_id = 0;
+	switching_media.reset();
+	rebuild_queue = false;
+
 	return;
 }
 
+double MediaPlayer::GetStopPosition(const Frame*& next_frame)
+{
+	double position = shown_position >= 0.0 ? shown_position.load() : media_position;
+	next_frame = nullptr;
+
+	// playing is resumed from the first frame which wasn't shown, the first frame of switched media
+	// starts current media; slots keep their pixels until queue is released
+	if (frame_queue) {
+		for (Frame* unread = frame_queue->BeginRead(); unread; unread = frame_queue->BeginRead()) {
+			if (!next_frame || unread->switch_requested != steady_clock::time_point()) {
+				next_frame = unread;
+				position = unread->position;
+			}
+
+			frame_queue->EndRead();
+		}
+	}
+
+	return position;
+}
+
+std::string MediaPlayer::GetPosterLayout()
+{
+	long monitor_width = 0, monitor_height = 0;
+	monitor.GetResolution(monitor_width, monitor_height);
+
+	// the same media with these params is drawn with the same pixels
+	return std::to_string((int)scaling_mode.load()) + " " + std::to_string(monitor_width) + "x" +
+		std::to_string(monitor_height) + " " + std::to_string((int)frame.format);
+}
+
+bool MediaPlayer::ShowPoster()
+{
+	TRACE_SCOPE("ShowPoster");
+
+	PosterCache::Poster poster;
+	if (!PosterCache::Load(poster_path, poster_layout, poster_position, poster))
+		return false;
+
+	// decoder was faster, the real frame is shown instead
+	if (frame_queue->GetSize() > 0)
+		return false;
+
+	// poster is the drawn region, so it is drawn whole
+	Frame poster_frame = frame;
+	poster_frame.frame_buf = poster.pixels.data();
+	poster_frame.original_width = poster.width;
+	poster_frame.original_height = poster.height;
+	poster_frame.format = poster.format;
+	poster_frame.bytes_per_pixel = GetBytesPerPixel(poster.format);
+	poster_frame.linesize = poster.linesize;
+	poster_frame.position = poster.position;
+	poster_frame.x_offset = 0;
+	poster_frame.y_offset = 0;
+	poster_frame.crop_width = poster.width;
+	poster_frame.crop_height = poster.height;
+
+	// mirrors wait for decoded frames, their regions can be different
+	uint64_t ticket = compositor.Publish(monitor.GetTargetID(), poster_frame);
+
+	return WaitPresented(monitor.GetTargetID(), ticket);
+}
+
+void MediaPlayer::StorePoster(const Frame& poster_frame, double position)
+{
+	PosterCache::Poster poster;
+	if (!PosterCache::Capture(poster_frame, position, poster))
+		return;
+
+	// the previous poster is written first
+	if (poster_thread.joinable())
+		poster_thread.join();
+
+	poster_thread = std::thread([path = poster_path, layout = poster_layout, poster = std::move(poster)]() {
+		TRACE_THREAD_NAME("poster");
+		PosterCache::Store(path, layout, poster);
+	});
+}
+
 void MediaPlayer::PlayerThreadFunction()
 {
-	is_playing = true;
+	TRACE_THREAD_NAME("player " + std::to_string(monitor.GetTargetID()));
+
+	// media clock is anchored to the first presented frame
+	media_clock.Reset();
+	frame_limiter.Reset();
+	metrics.Reset();
 
-	// timings
-	ms frame_duration = GetFrameDuration();
-	ms wait_duration, elapsed;
-	steady_clock::time_point start, end;
+	// the last presented frame stays on monitor until this time
+	steady_clock::time_point shown_until;
+	double shown_duration = 0.0;
+
+	double media_fps = 0.0;
+	bool reduced_decoding = false;
+
+	// underruns of demuxer are counted by media since it was opened, skipped frames by monitor since it was created
+	uint64_t demuxer_underruns = 0;
+	uint64_t monitor_skipped = monitor.GetSkippedFrames();
+
+	// drawn while decoder opens codec and decodes the first GOP
+	if (show_poster)
+		ShowPoster();
+
+	// media can be switched by decoder thread
+	uint64_t generation = 0;
+	bool media_known = false;
 
 	while (keep_drawing.test_and_set()) {
-		start = steady_clock::now();
+		if (!media_known || generation != media_generation) {
+			std::lock_guard<std::mutex> lock(media_mutex);
 
-		int code = current_media->GetNextFrame(frame, loop_media);
-		if (code)
-			break;
+			generation = media_generation;
+			media_known = true;
+
+			float frame_ms = current_media->GetFrameDuration().count();
+			media_fps = frame_ms > 0.0f ? 1000.0 / frame_ms : 0.0;
+			demuxer_underruns = current_media->GetDemuxerStats().underruns;
+		}
+
+		PlaybackDecision decision;
+		if (playback_policy)
+			decision = playback_policy->Decide(media_fps, steady_clock::now());
+
+		// the last frame stays on monitor, decoder doesn't use CPU
+		if (decision.pause) {
+			if (!is_paused) {
+				PauseDecoder();
+				is_paused = true;
+			}
+
+			std::this_thread::sleep_for(milliseconds(10));
+			continue;
+		}
+
+		if (is_paused) {
+			// playing continues from the next frame, not from the paused time
+			media_clock.Reset();
+			frame_limiter.Reset();
+
+			ResumeDecoder();
+			is_paused = false;
+		}
+
+		if (decision.reduce_decoding != reduced_decoding) {
+			std::lock_guard<std::mutex> lock(media_mutex);
+			current_media->SetReducedDecoding(decision.reduce_decoding);
+			reduced_decoding = decision.reduce_decoding;
+		}
+
+		Frame* ready_frame = frame_queue->BeginRead();
+		if (!ready_frame) {
+			// frames of the old media are drawn, queue can be replaced for switched media
+			if (rebuild_queue) {
+				if (!RebuildQueue())
+					break;
+
+				continue;
+			}
+
+			// nothing more will be decoded
+			if (decoding_finished)
+				break;
+
+			// decoder is behind, the previous frame is shown once more
+			if (media_clock.IsStarted() && shown_duration > 0.0 && steady_clock::now() > shown_until) {
+				++metrics.duplicated_frames;
+				shown_until += duration_cast<steady_clock::duration>(duration<double>(shown_duration));
+			}
+
+			// wait for the next frame
+			frame_queue->WaitRead(max_wait);
+			continue;
+		}
+
+		// playing is resumed after frames which were dropped too
+		shown_position = ready_frame->position;
+
+		// decoding time is spent for dropped frames too
+		metrics.demux.RecordMs(ready_frame->demux_ms);
+		metrics.decode.RecordMs(ready_frame->decode_ms);
+		metrics.convert.RecordMs(ready_frame->convert_ms);
+
+		PacketQueue::Stats demuxer_stats;
+		{
+			std::lock_guard<std::mutex> lock(media_mutex);
+			demuxer_stats = current_media->GetDemuxerStats();
+		}
+		metrics.packet_queue.RecordMs(demuxer_stats.seconds * 1000.0);
+		metrics.packet_queue_packets.store(demuxer_stats.packets, std::memory_order_relaxed);
+		metrics.packet_queue_bytes.store(demuxer_stats.bytes, std::memory_order_relaxed);
+		metrics.demuxer_underruns.fetch_add(demuxer_stats.underruns - demuxer_underruns, std::memory_order_relaxed);
+		demuxer_underruns = demuxer_stats.underruns;
+
+		steady_clock::time_point now = steady_clock::now();
+
+		if (!media_clock.IsStarted())
+			media_clock.Start(ready_frame->timestamp, now);
+
+		// we are too far behind (system was suspended, decoder stalled...) - start from this frame
+		media_clock.CorrectDrift(ready_frame->timestamp, now);
+
+		// frame's time is over and the next one is ready - drop it to catch up
+		if (media_clock.IsLate(ready_frame->timestamp, ready_frame->duration, now) && frame_queue->GetSize() > 1) {
+			frame_queue->EndRead();
+			++metrics.dropped_frames;
+			continue;
+		}
+
+		// frame rate is limited by policy - frame isn't drawn
+		if (!frame_limiter.ShouldPresent(ready_frame->timestamp, ready_frame->duration, decision.max_fps)) {
+			frame_queue->EndRead();
+			++metrics.throttled_frames;
+			continue;
+		}
+
+		// slot can be reused by decoder after reading, so duration is kept
+		double frame_duration = ready_frame->duration;
+		steady_clock::time_point switch_requested = ready_frame->switch_requested;
+
+		// how late the thread wakes up after sleeping till the deadline
+		steady_clock::time_point deadline = media_clock.GetDeadline(ready_frame->timestamp);
+		if (deadline > now) {
+			TRACE_SCOPE("sleep_until");
+			std::this_thread::sleep_until(deadline);
+			metrics.sleep_jitter.Record(steady_clock::now() - deadline);
+		}
+
+		// compositor draws frame at its next tick
+		uint64_t ticket = compositor.Publish(monitor.GetTargetID(), *ready_frame);
+
+		// the same decoded frame for other monitors, driven by the same clock
+		for (auto& mirror : mirrors) {
+			mirror.frame.frame_buf = ready_frame->frame_buf;
+			mirror.frame.original_width = ready_frame->original_width;
+			mirror.frame.original_height = ready_frame->original_height;
+			mirror.frame.linesize = ready_frame->linesize;
+
+			mirror.ticket = compositor.Publish(mirror.monitor->GetTargetID(), mirror.frame);
+		}
+
+		bool success = WaitPresented(monitor.GetTargetID(), ticket);
+		for (auto& mirror : mirrors) {
+			success = WaitPresented(mirror.monitor->GetTargetID(), mirror.ticket) && success;
+		}
+
+		// slot can be reused by decoder only after drawing on all monitors
+		frame_queue->EndRead();
 
-		bool success = monitor.DrawFrame(frame);
 		if (!success)
 			break;
 
-		end = steady_clock::now();
+		now = steady_clock::now();
+		steady_clock::duration display_interval = duration_cast<steady_clock::duration>(duration<double>(frame_duration));
+
+		metrics.copy.RecordMs(compositor.GetDrawMs(monitor.GetTargetID()));
+		++metrics.presented_frames;
+
+		// monitor was drawn by compositor thread before the frame was presented
+		metrics.dirty_ppm_total.fetch_add((uint64_t)(monitor.GetDirtyRatio() * 1e6 + 0.5), std::memory_order_relaxed);
+		uint64_t skipped = monitor.GetSkippedFrames();
+		metrics.skipped_frames.fetch_add(skipped - monitor_skipped, std::memory_order_relaxed);
+		monitor_skipped = skipped;
+
+		// the first frame of switched media is on monitor
+		if (switch_requested != steady_clock::time_point())
+			metrics.media_switch.Record(now - switch_requested);
+
+		if (now - deadline > display_interval)
+			++metrics.late_frames;
+
+		shown_until = std::max(now, deadline + display_interval);
+		shown_duration = frame_duration;
+	}
+
+	// stop decoder too if drawing was broken, paused decoder wakes up to see it
+	keep_decoding.clear();
+	ResumeDecoder();
+
+	if (reduced_decoding) {
+		std::lock_guard<std::mutex> lock(media_mutex);
+		current_media->SetReducedDecoding(false);
+	}
+
+	is_paused = false;
+	is_playing = false;
+
+	return;
+}
 
-		elapsed = end - start;
-		if (elapsed > frame_duration) {
-			wait_duration = ms{ 0 };
-			elapsed -= frame_duration;
-			//std::cout << "Warning! Frame was delayed by " << elapsed.count() << " ms." << std::endl;
+void MediaPlayer::DecoderThreadFunction()
+{
+	TRACE_THREAD_NAME("decoder " + std::to_string(monitor.GetTargetID()));
+
+	while (keep_decoding.test_and_set()) {
+		// player is paused, decoding stops on a frame boundary
+		{
+			std::unique_lock<std::mutex> lock(decoder_mutex);
+			if (decoder_paused) {
+				decoder_condition.wait(lock, [this]() { return !decoder_paused; });
+				continue;
+			}
 		}
-		else {
-			wait_duration = frame_duration - elapsed;
+
+		// player thread replaces frame queue for switched media
+		if (rebuild_queue) {
+			std::unique_lock<std::mutex> lock(decoder_mutex);
+			decoder_condition.wait_for(lock, max_wait, [this]() { return !rebuild_queue; });
+			continue;
+		}
+
+		Frame* free_frame = frame_queue->BeginWrite();
+		if (!free_frame) {
+			// queue is full, wait until player draws something
+			frame_queue->WaitWrite(max_wait);
+			continue;
+		}
+
+		// the first frame of new media is already decoded
+		if (TrySwitchMedia(free_frame) || rebuild_queue)
+			continue;
+
+		free_frame->switch_requested = steady_clock::time_point();
+
+		// items of playlist are looped until they are switched
+		bool loop = loop_media || playlist.GetItemsCount() > 1;
+
+		// baked media gives pointers into its file mapping, nothing is copied
+		int code = 0;
+		{
+			TRACE_SCOPE("DecodeNextFrame");
+			code = current_media->IsBaked() ? current_media->GetNextFrame(*free_frame, loop) :
+				current_media->DecodeNextFrame(*free_frame, loop);
+		}
+		if (code)
+			break;
+
+		double media_timestamp = free_frame->timestamp;
+		if (!item_started) {
+			item_start_timestamp = media_timestamp;
+			item_start_loops = current_media->GetLoopsCount();
+			item_started = true;
 		}
 
-		std::this_thread::sleep_for(duration_cast<milliseconds>(wait_duration));
+		free_frame->timestamp += timestamp_offset;
+
+		// the frame which ends time or loops of the item is replaced by the first frame of the next one
+		if (!rotation_due && playlist.GetItemsCount() > 1 &&
+			playlist.IsRotationDue(media_timestamp - item_start_timestamp, current_media->GetLoopsCount() - item_start_loops)) {
+			rotation_due = true;
+			rotation_time = steady_clock::now();
+
+			if (TrySwitchMedia(free_frame) || rebuild_queue)
+				continue;
+		}
+
+		// the first frame of this start is poster of the next one
+		if (capture_poster) {
+			capture_poster = false;
+			StorePoster(*free_frame, poster_position);
+		}
+
+		next_timestamp = free_frame->timestamp + free_frame->duration;
+		frame_queue->EndWrite();
 	}
 
-	is_playing = false;
+	decoding_finished = true;
 
 	return;
 }
 
+bool MediaPlayer::TrySwitchMedia(Frame* free_frame)
+{
+	if (!switching_media) {
+		uint64_t manual_id = switch_request_id;
+		if ((manual_id == 0 && !rotation_due) || !preloader.IsReady())
+			return false;
+
+		std::unique_ptr<MediaPreloader::Result> ready = preloader.Take();
+		if (!ready)
+			return false;
+
+		// playlist item was requested before the manual switch, which is coming
+		if (manual_id != 0 && ready->request_id != manual_id)
+			return false;
+
+		if (manual_id != 0) {
+			switch_request_id.compare_exchange_strong(manual_id, 0);
+
+			// media chosen by user replaces playlist
+			playlist.Clear();
+			rotation_due = false;
+		}
+
+		if (!ready->media) {
+			// current media goes on, playlist tries the next item
+			if (rotation_due) {
+				preload_index = playlist.GetNextIndex(preload_index);
+
+				if (preload_index != playlist_index) {
+					preloader.Request(playlist.GetItem(preload_index), rotation_time);
+				}
+				else {
+					// no other item can be played, the current one starts its time again
+					rotation_due = false;
+					item_started = false;
+				}
+			}
+
+			return false;
+		}
+
+		if (manual_id == 0) {
+			playlist_index = preload_index;
+			ready->requested = rotation_time;
+		}
+
+		switching_media = std::move(ready);
+
+		// frames of new media don't fit the queue, player thread replaces it after the old frames are drawn
+		long scaled_width = 0, scaled_height = 0;
+		current_media->GetScaledResolution(scaled_width, scaled_height);
+
+		if (!IsSameGeometry(frame, switching_media->frame) || current_media->IsBaked() || switching_media->media->IsBaked() ||
+			scaled_width != switching_media->frame.original_width || scaled_height != switching_media->frame.original_height) {
+			rebuild_queue = true;
+			return false;
+		}
+	}
+
+	TRACE_SCOPE("SwitchMedia");
+
+	// timestamps of new media continue after the last frame of the old one
+	CopyFrame(switching_media->frame, *free_frame);
+	timestamp_offset = next_timestamp - switching_media->frame.timestamp;
+	free_frame->timestamp = next_timestamp;
+	free_frame->switch_requested = switching_media->requested;
+
+	item_start_timestamp = switching_media->frame.timestamp;
+	item_start_loops = switching_media->media->GetLoopsCount();
+	item_started = true;
+	rotation_due = false;
+
+	// poster belongs to the media this start was made with
+	capture_poster = false;
+
+	// old media is released after the first new frame is queued
+	std::unique_ptr<MediaPack> old_media;
+	{
+		std::lock_guard<std::mutex> lock(media_mutex);
+
+		switching_media->media->SetReducedDecoding(current_media->IsReducedDecoding());
+		old_media = std::move(current_media);
+		current_media = std::move(switching_media->media);
+	}
+	switching_media.reset();
+	++media_generation;
+
+	next_timestamp = free_frame->timestamp + free_frame->duration;
+	frame_queue->EndWrite();
+
+	RequestNextItem();
+
+	return true;
+}
+
+void MediaPlayer::RequestNextItem()
+{
+	if (playlist.GetItemsCount() < 2)
+		return;
+
+	// manual switch isn't replaced by playlist
+	std::lock_guard<std::mutex> lock(media_mutex);
+	if (switch_request_id != 0)
+		return;
+
+	preload_index = playlist.GetNextIndex(playlist_index);
+	preloader.Request(playlist.GetItem(preload_index));
+}
+
+bool MediaPlayer::RebuildQueue()
+{
+	TRACE_SCOPE("RebuildQueue");
+
+	// decoder waits, all frames of the old media are drawn
+	Frame old_frame = frame;
+	frame = switching_media->frame;
+	frame.frame_buf = nullptr;
+	frame.linesize = 0;
+	frame.switch_requested = steady_clock::time_point();
+
+	frame_queue.reset();
+	monitor.ReleaseSurfaces();
+
+	// decoder keeps waiting until player is stopped
+	if (!CreateFrameQueue(*switching_media->media)) {
+		frame = old_frame;
+		return false;
+	}
+
+	UpdateMirrorsScaling(*switching_media->media);
+
+	// decoder swaps media into the new queue
+	{
+		std::lock_guard<std::mutex> lock(decoder_mutex);
+		rebuild_queue = false;
+	}
+	decoder_condition.notify_one();
+
+	return true;
+}
+
+void MediaPlayer::PauseDecoder()
+{
+	std::lock_guard<std::mutex> lock(decoder_mutex);
+	decoder_paused = true;
+}
+
+void MediaPlayer::ResumeDecoder()
+{
+	{
+		std::lock_guard<std::mutex> lock(decoder_mutex);
+		decoder_paused = false;
+	}
+
+	decoder_condition.notify_one();
+}
+
+bool MediaPlayer::WaitPresented(int monitor_id, uint64_t ticket)
+{
+	if (ticket == 0)
+		return false;
+
+	TRACE_SCOPE("WaitPresented");
+
+	// compositor wakes player up right after the tick which drew the frame
+	return compositor.WaitPresented(monitor_id, ticket);
+}
+
+bool MediaPlayer::IsPlaying()
+{
+	return is_playing;
+}
+
 int MediaPlayer::GetMonitorID()
 {
-	return monitor.monitor_id;
+	return monitor.GetTargetID();
+}
+
+uint64_t MediaPlayer::GetDroppedFrames()
+{
+	return metrics.dropped_frames;
+}
+
+uint64_t MediaPlayer::GetThrottledFrames()
+{
+	return metrics.throttled_frames;
+}
+
+bool MediaPlayer::IsPaused()
+{
+	return is_paused;
+}
+
+PlayerMetrics& MediaPlayer::GetMetrics()
+{
+	return metrics;
 }
 
 ms MediaPlayer::GetFrameDuration()
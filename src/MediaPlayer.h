@@ -1,13 +1,23 @@
 #pragma once
 
-#include "Monitor.h"
+#include "Compositor.h"
 #include "MediaPack.h"
+#include "MediaPreloader.h"
+#include "Playlist.h"
+#include "FrameQueue.h"
+#include "MediaClock.h"
+#include "PlaybackPolicy.h"
+#include "PlayerMetrics.h"
+#include "PosterCache.h"
 
 #include <memory>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <thread>
 #include <chrono>
 #include <iostream>
+#include <vector>
 
 using namespace std::chrono;
 
@@ -15,29 +25,235 @@ using namespace std::chrono;
 class MediaPlayer {
 public:
 	MediaPlayer() = delete;
-	MediaPlayer(Monitor& monitor);
+	// frames are drawn by compositor, which must have monitors of this player as targets;
+	// monitor is any FrameTarget, e.g. in-memory sink of benchmark
+	MediaPlayer(FrameTarget& monitor, Compositor& compositor);
 	
 	~MediaPlayer();
 
+	// how media of another size is fitted into monitor
+	enum class ScalingMode {
+		Ask = 0,	// user is asked in console
+		Crop = 1,	// only the middle part of bigger media is shown
+		Scale = 2,	// the whole media is stretched
+		Fill = 3	// media is cropped to monitor's aspect ratio and scaled
+	};
+
+	// false for empty or not loaded media
 	bool SetMedia(std::unique_ptr<MediaPack> new_media);
-	bool SetScaling();
+
+	// new media is opened and decoded up to its first frame in background, then it replaces
+	// the current one at a frame boundary without stopping the player; stopped player just
+	// loads it with the last scaling mode; playlist is dropped
+	bool SwitchMedia(const std::string& path);
+
+	// items are played one after another and switched like SwitchMedia does, the next one is
+	// preloaded while the current one is playing; the first item is loaded here, then scaling
+	// is set and player is started as usual
+	bool SetPlaylist(Playlist new_playlist);
+	// can be changed while playing, player is restarted with the new scaling
+	bool SetScaling(ScalingMode mode = ScalingMode::Ask);
+
+	// BGRA by default, BGR24 uses less memory; applied by SetScaling
+	bool SetFrameFormat(FrameFormat format);
+
+	// show the same decoded frames on another monitor
+	bool AddMirror(FrameTarget& mirror_monitor);
+	bool RemoveMirror(int monitor_id);
+	bool HasMirror(int monitor_id);
+
+	// memory budget in bytes for frames of looped media (0 - disabled)
+	bool SetLoopCache(size_t budget);
+
+	// decode media once with current scaling into a file, which is played without decoding;
+	// media is released after baking
+	bool BakeMedia(std::string baked_path, size_t& frames_count);
+
+	// media is played from position in seconds, playing player is restarted from it
+	bool Seek(double position);
+
+	// position of media is stored per monitor when player stops, the same media is resumed from it
+	// by the first start after SetMedia (disabled by default)
+	bool SetResume(bool enabled);
+
+	// the first frame shown after SetMedia is kept in PosterCache and the next start with the same media,
+	// scaling and position draws it at once, before the first frame is decoded (disabled by default)
+	bool SetPoster(bool enabled);
+
+	// how many decoded frames can be prepared ahead of presentation
+	bool SetQueueDepth(size_t depth);
+
+	// consulted before every frame: frame rate limit, lighter decoding or pause (nullptr - full rate)
+	bool SetPlaybackPolicy(std::shared_ptr<PlaybackPolicy> policy);
 
 	bool StartPlayer(bool loop = false);
 	void StopPlayer();
 	void PlayerThreadFunction();
+	void DecoderThreadFunction();
 
+	bool IsPlaying();
 	int GetMonitorID();
 	ms GetFrameDuration();
+	uint64_t GetDroppedFrames();
+
+	// frames not presented because of frame rate limit of policy
+	uint64_t GetThrottledFrames();
+	bool IsPaused();
+
+	// per-stage timing and frame counters since the player was started, take GetSnapshot() of it
+	PlayerMetrics& GetMetrics();
 
 private:
-	Monitor &monitor;
+	FrameTarget& monitor;
+	Compositor& compositor;
 	std::unique_ptr<MediaPack> current_media;
 
+	// current_media is swapped by decoder thread while player thread can use it
+	std::mutex media_mutex;
+
 	std::thread player_thread;
-	bool is_playing = false;
+	std::thread decoder_thread;
+	std::atomic<bool> is_playing{ false };
+
+	// player is counted by DecodeBudget from SetMedia or StartPlayer till StopPlayer
+	bool budget_registered = false;
+	void SetBudgetRegistered(bool registered);
+
 	bool loop_media = false;
 
 	std::atomic_flag keep_drawing = ATOMIC_FLAG_INIT;
+	std::atomic_flag keep_decoding = ATOMIC_FLAG_INIT;
+	std::atomic<bool> decoding_finished{ false };
+
+	// decoded frames ready to be drawn
+	std::unique_ptr<FrameQueue> frame_queue;
+
+	// buffers of frame queue are reused when player is restarted with the same frame size
+	FramePool frame_pool;
+	size_t queue_depth = 4;
+
+	// media switching: the next media is prepared by preloader and swapped in by decoder thread
+	// at a frame boundary, timestamps of new media continue after the last frame of the old one
+	MediaPreloader preloader;
+	Playlist playlist;
+	size_t playlist_index = 0;
+	size_t preload_index = 0;
+
+	// manual switch is done as soon as its media is ready (0 - no manual switch),
+	// playlist item when its rotation is due
+	std::atomic<uint64_t> switch_request_id{ 0 };
+	bool rotation_due = false;
+	std::chrono::steady_clock::time_point rotation_time;
+
+	// position of current media is stored by StopPlayer: the first frame left in queue, the last frame
+	// taken by player thread or where stopped media was started (negative - unknown); media set by
+	// SetMedia is resumed by the next StartPlayer
+	bool resume_enabled = false;
+	bool resume_pending = false;
+	double media_position = -1.0;
+	std::atomic<double> shown_position{ -1.0 };
+
+	// where playing stopped, next_frame is the frame which would be shown next (nullptr - not decoded yet)
+	double GetStopPosition(const Frame*& next_frame);
 
+	// poster is drawn by player thread before the first decoded frame of the first start after SetMedia;
+	// if it isn't cached, decoder captures the first frame, StopPlayer captures the frame playing is
+	// resumed from; posters are encoded and written by poster thread
+	bool poster_enabled = false;
+	bool show_poster = false;
+	std::atomic<bool> capture_poster{ false };
+	std::string poster_path;
+	std::string poster_layout;
+	double poster_position = 0.0;
+	std::thread poster_thread;
+
+	// scaling mode, monitor resolution and frame format
+	std::string GetPosterLayout();
+
+	// player thread: false if poster isn't cached or the first frame is already decoded
+	bool ShowPoster();
+
+	// copy of the drawn region is written in background
+	void StorePoster(const Frame& poster_frame, double position);
+
+	// used only by decoder thread, kept while it is paused
+	double timestamp_offset = 0.0;
+	double next_timestamp = 0.0;
+	double item_start_timestamp = 0.0;
+	size_t item_start_loops = 0;
+	bool item_started = false;
+
+	// frames of ready media have other size or crop params, so player thread recreates
+	// frame queue after the old frames are drawn, decoder waits for it
+	std::unique_ptr<MediaPreloader::Result> switching_media;
+	std::atomic<bool> rebuild_queue{ false };
+
+	// threads waiting for frames, slots or rebuilt queue are woken up at once, the timeout
+	// only bounds how late they notice stop or end of decoding
+	static constexpr milliseconds max_wait{ 10 };
+
+	// changed by every swap, so player thread updates frame rate of media
+	std::atomic<uint64_t> media_generation{ 0 };
+
+	// scaling chosen by user, it is used for switched media
+	std::atomic<ScalingMode> scaling_mode{ ScalingMode::Ask };
+	std::atomic<size_t> loop_cache_budget{ 0 };
+
+	// scaling and first frame of media on preloader thread
+	bool PrepareMedia(MediaPack& media, Frame& media_frame);
+
+	// decoder thread: switch if it is due and media is ready, true if a frame was written
+	bool TrySwitchMedia(Frame* free_frame);
+	void RequestNextItem();
+
+	// player thread: new frame queue for switching media with other geometry
+	bool RebuildQueue();
+
+	// frame queue for media: monitor's surfaces or buffers from pool
+	bool CreateFrameQueue(MediaPack& media);
+
+	// presentation timing
+	MediaClock media_clock;
+	PlayerMetrics metrics;
+
+	// playback policy
+	std::shared_ptr<PlaybackPolicy> playback_policy;
+	FrameLimiter frame_limiter;
+	std::atomic<bool> is_paused{ false };
+
+	// decoder thread waits while player is paused, decoded frames stay in queue, and while
+	// player thread rebuilds frame queue; only StartPlayer and StopPlayer start and join decoder thread
+	std::mutex decoder_mutex;
+	std::condition_variable decoder_condition;
+	bool decoder_paused = false;
+	void PauseDecoder();
+	void ResumeDecoder();
+
+	std::atomic<FrameFormat> frame_format{ FrameFormat::BGRA };
+
+	// crop params for frames in queue
 	Frame frame;
+
+	// monitors which show frames of this player with their own crop params
+	struct Mirror {
+		FrameTarget* monitor;
+		Frame frame;
+		uint64_t ticket;
+	};
+	std::vector<Mirror> mirrors;
+
+	void UpdateMirrorsScaling(MediaPack& media);
+
+	// wait until compositor draws published frame, returns result of drawing
+	bool WaitPresented(int monitor_id, uint64_t ticket);
+
+	// scaling of stopped player
+	bool ApplyScaling(ScalingMode mode);
+
+	// scaling of media and crop params of its frames, user is asked in console for Ask mode
+	// and mode is changed to the chosen one
+	bool ApplyScaling(MediaPack& media, Frame& media_frame, ScalingMode& mode);
+
+	// crop media to monitor's aspect ratio and scale it to monitor resolution
+	bool SetFillScaling(MediaPack& media, long monitor_width, long monitor_height, long media_width, long media_height);
 };
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "MediaPreloader.h"
+#include "Tracer.h"
+
+#include <iostream>
+
+
+MediaPreloader::MediaPreloader(PrepareFunction prepare) :
+	prepare(prepare)
+{
+}
+
+MediaPreloader::~MediaPreloader()
+{
+	Stop();
+}
+
+uint64_t MediaPreloader::Request(const std::string& path, std::chrono::steady_clock::time_point requested)
+{
+	std::unique_ptr<Result> dropped;
+	uint64_t id = 0;
+	{
+		std::lock_guard<std::mutex> lock(preloader_mutex);
+
+		has_request = true;
+		id = ++request_id;
+		request_path = path;
+		request_time = requested;
+
+		// media of the previous request is released outside of the lock
+		dropped = std::move(result);
+		is_ready = false;
+
+		if (!preloader_thread.joinable()) {
+			stop_requested = false;
+			preloader_thread = std::thread(&MediaPreloader::ThreadFunction, this);
+		}
+	}
+
+	request_condition.notify_one();
+
+	return id;
+}
+
+void MediaPreloader::Cancel()
+{
+	std::unique_ptr<Result> dropped;
+
+	std::lock_guard<std::mutex> lock(preloader_mutex);
+
+	has_request = false;
+	++request_id;
+
+	dropped = std::move(result);
+	is_ready = false;
+}
+
+void MediaPreloader::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(preloader_mutex);
+		stop_requested = true;
+	}
+	request_condition.notify_one();
+
+	if (preloader_thread.joinable())
+		preloader_thread.join();
+
+	Cancel();
+}
+
+bool MediaPreloader::IsReady()
+{
+	return is_ready;
+}
+
+std::unique_ptr<MediaPreloader::Result> MediaPreloader::Take()
+{
+	std::lock_guard<std::mutex> lock(preloader_mutex);
+
+	is_ready = false;
+
+	return std::move(result);
+}
+
+void MediaPreloader::ThreadFunction()
+{
+	TRACE_THREAD_NAME("preloader");
+
+	while (true) {
+		std::unique_ptr<Result> prepared = std::make_unique<Result>();
+		uint64_t id = 0;
+		{
+			std::unique_lock<std::mutex> lock(preloader_mutex);
+			request_condition.wait(lock, [this]() { return stop_requested || has_request; });
+
+			if (stop_requested)
+				break;
+
+			has_request = false;
+			id = request_id;
+			prepared->request_id = id;
+			prepared->path = request_path;
+			prepared->requested = request_time;
+		}
+
+		try {
+			TRACE_SCOPE("Preload");
+
+			std::unique_ptr<MediaPack> media = std::make_unique<MediaPack>(prepared->path);
+
+			if (prepare(*media, prepared->frame)) {
+				prepared->frame_buffer.resize(media->GetFrameBufferSize());
+				prepared->frame.frame_buf = prepared->frame_buffer.data();
+				prepared->frame.linesize = 0;
+
+				// the same looping as player, so media of one frame can be played too
+				if (media->DecodeNextFrame(prepared->frame, true) == 0)
+					prepared->media = std::move(media);
+			}
+		}
+		catch (std::exception& exception) {
+			std::cout << prepared->path << ": " << exception.what() << std::endl;
+		}
+
+		// failed media is reported too, so player can go on with another one
+		std::lock_guard<std::mutex> lock(preloader_mutex);
+		if (id == request_id) {
+			result = std::move(prepared);
+			is_ready = true;
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "MediaPack.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Opens the next media of a player on its own thread: container is probed, codec is opened,
+// scaling is chosen by player's prepare function and the first frame is decoded, so player
+// only swaps media when it is ready. One request at a time, a new request replaces the old one.
+class MediaPreloader {
+public:
+	struct Result {
+		uint64_t request_id = 0;
+		std::string path;
+
+		// nullptr if media can't be opened, prepared or decoded
+		std::unique_ptr<MediaPack> media;
+
+		// the first decoded frame in frame_buffer, with crop params chosen by prepare function
+		Frame frame;
+		std::vector<uint8_t> frame_buffer;
+
+		// when switch to this media was requested
+		std::chrono::steady_clock::time_point requested;
+	};
+
+	// sets scaling of opened media and crop params of its frames, called on preloader thread
+	typedef std::function<bool(MediaPack& media, Frame& frame)> PrepareFunction;
+
+	MediaPreloader(PrepareFunction prepare);
+
+	~MediaPreloader();
+
+	MediaPreloader(const MediaPreloader& obj) = delete;
+	MediaPreloader& operator=(const MediaPreloader& obj) = delete;
+	MediaPreloader(MediaPreloader&& obj) = delete;
+	MediaPreloader& operator=(MediaPreloader&& obj) = delete;
+
+	// thread is started by the first request, returns id of request which is stored in its result
+	uint64_t Request(const std::string& path, std::chrono::steady_clock::time_point requested = std::chrono::steady_clock::now());
+
+	// drop waiting request and result, media which is being opened is dropped when it is ready
+	void Cancel();
+
+	// must be called before prepare function becomes invalid
+	void Stop();
+
+	// can be called from any thread
+	bool IsReady();
+
+	// result of the last request, nullptr while it isn't ready
+	std::unique_ptr<Result> Take();
+
+private:
+	void ThreadFunction();
+
+	PrepareFunction prepare;
+
+	std::thread preloader_thread;
+	std::mutex preloader_mutex;
+	std::condition_variable request_condition;
+	bool stop_requested = false;
+
+	// the last request, its id is changed by every Request and Cancel
+	bool has_request = false;
+	uint64_t request_id = 0;
+	std::string request_path;
+	std::chrono::steady_clock::time_point request_time;
+
+	std::unique_ptr<Result> result;
+	std::atomic<bool> is_ready{ false };
+};
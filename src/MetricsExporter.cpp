@@ -0,0 +1,89 @@
+#include "MetricsExporter.h"
+
+
+MetricsExporter::~MetricsExporter()
+{
+	Stop();
+}
+
+bool MetricsExporter::AddSource(int player_id, PlayerMetrics* metrics)
+{
+	if (!metrics || IsRunning())
+		return false;
+
+	sources.push_back({ player_id, metrics });
+
+	return true;
+}
+
+bool MetricsExporter::Start(std::string path, std::chrono::milliseconds interval)
+{
+	Stop();
+
+	if (interval.count() <= 0)
+		return false;
+
+	file.open(path, std::ios::out | std::ios::app);
+	if (!file)
+		return false;
+
+	this->interval = interval;
+	start_time = std::chrono::steady_clock::now();
+
+	keep_exporting.test_and_set();
+	export_thread = std::thread(&MetricsExporter::ExportThreadFunction, this);
+
+	return true;
+}
+
+void MetricsExporter::Stop()
+{
+	if (export_thread.joinable()) {
+		keep_exporting.clear();
+		export_thread.join();
+	}
+
+	if (file.is_open())
+		file.close();
+}
+
+bool MetricsExporter::IsRunning()
+{
+	return export_thread.joinable();
+}
+
+bool MetricsExporter::Export()
+{
+	if (!file.is_open())
+		return false;
+
+	auto time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+	for (auto& source : sources) {
+		file << "{\"time_ms\": " << time_ms << ", \"player\": " << source.player_id
+			<< ", \"metrics\": " << source.metrics->GetSnapshot().ToJson() << "}\n";
+	}
+
+	file.flush();
+
+	return !file.fail();
+}
+
+void MetricsExporter::ExportThreadFunction()
+{
+	std::chrono::steady_clock::time_point next_export = std::chrono::steady_clock::now() + interval;
+
+	while (keep_exporting.test_and_set()) {
+		// short sleeps, so Stop doesn't wait for the whole interval
+		if (std::chrono::steady_clock::now() < next_export) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			continue;
+		}
+
+		Export();
+		next_export += interval;
+	}
+
+	// the last state before stopping
+	Export();
+}
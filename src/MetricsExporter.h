@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PlayerMetrics.h"
+
+
+// Appends snapshots of players' metrics to a file as JSON lines, one line per player
+// every interval: {"time_ms": ..., "player": ..., "metrics": {...}}
+class MetricsExporter {
+public:
+	MetricsExporter() = default;
+
+	~MetricsExporter();
+
+	MetricsExporter(const MetricsExporter& obj) = delete;
+	MetricsExporter& operator=(const MetricsExporter& obj) = delete;
+
+	// sources can be added only while exporter is stopped, metrics must outlive exporter
+	bool AddSource(int player_id, PlayerMetrics* metrics);
+
+	bool Start(std::string path, std::chrono::milliseconds interval);
+	void Stop();
+	bool IsRunning();
+
+	// write snapshots of all sources right now
+	bool Export();
+
+private:
+	void ExportThreadFunction();
+
+	struct Source {
+		int player_id;
+		PlayerMetrics* metrics;
+	};
+	std::vector<Source> sources;
+
+	std::ofstream file;
+	std::chrono::milliseconds interval{ 1000 };
+	std::chrono::steady_clock::time_point start_time;
+
+	std::thread export_thread;
+	std::atomic_flag keep_exporting = ATOMIC_FLAG_INIT;
+};
@@ -1,5 +1,8 @@
 #include "Monitor.h"
 #include "WinHelper.h"
+#include "Tracer.h"
+
+#include <algorithm>
 
 
 std::deque<Monitor> Monitor::monitors;
@@ -9,7 +12,6 @@ HWND Monitor::progman_hwnd = NULL;
 HWND Monitor::worker_hwnd = NULL;
 HDC Monitor::worker_hdc = NULL;
 RECT Monitor::worker_rect = {0, 0, 0, 0};
-std::timed_mutex Monitor::worker_lock;
 
 Monitor::Monitor(int monitor_id, RECT rect, bool is_primary) :
 	monitor_id(monitor_id), is_primary(is_primary)
@@ -38,22 +40,18 @@ Monitor::Monitor(int monitor_id, RECT rect, bool is_primary) :
 	bitmap_info.bmiHeader.biWidth = monitor_width;
 	bitmap_info.bmiHeader.biHeight = -monitor_height;
 	bitmap_info.bmiHeader.biPlanes = 1;
-	bitmap_info.bmiHeader.biBitCount = 24;
 	bitmap_info.bmiHeader.biCompression = BI_RGB;
-	bitmap_info.bmiHeader.biSizeImage = monitor_width * monitor_height * 3;
 
-	// drawing_pixels will be freed when DeleteObject will be called
-	drawing_bitmap = CreateDIBSection(drawing_hdc, &bitmap_info, DIB_PAL_COLORS, reinterpret_cast<void**>(&drawing_pixels), NULL, 0);
-	if (!drawing_bitmap) {
+	if (!CreateDrawingBitmap(FrameFormat::BGRA, monitor_width, monitor_height)) {
 		DeleteDC(drawing_hdc);
 		throw std::exception("Error while allocating DIB section.");
 	}
-
-	drawing_pixels_size = (size_t)monitor_width * monitor_height * 3;
 }
 
 Monitor::~Monitor()
 {
+	ReleaseSurfaces();
+
 	if (drawing_bitmap)
 		DeleteObject(drawing_bitmap);
 
@@ -62,7 +60,8 @@ Monitor::~Monitor()
 }
 
 Monitor::Monitor(const Monitor& obj) : 
-	bitmap_info(obj.bitmap_info), monitor_rect(obj.monitor_rect), monitor_id(obj.monitor_id), is_primary(obj.is_primary)
+	bitmap_info(obj.bitmap_info), drawing_pixels_size(obj.drawing_pixels_size), drawing_format(obj.drawing_format),
+	drawing_stride(obj.drawing_stride), drawing_width(obj.drawing_width), drawing_height(obj.drawing_height), monitor_rect(obj.monitor_rect), monitor_id(obj.monitor_id), is_primary(obj.is_primary)
 {
 	drawing_hdc = CreateCompatibleDC(worker_hdc);
 	if (!drawing_hdc)
@@ -76,7 +75,8 @@ Monitor::Monitor(const Monitor& obj) :
 }
 
 Monitor::Monitor(Monitor&& obj) noexcept :
-	bitmap_info(obj.bitmap_info), monitor_rect(obj.monitor_rect), monitor_id(obj.monitor_id), is_primary(obj.is_primary)
+	bitmap_info(obj.bitmap_info), drawing_pixels_size(obj.drawing_pixels_size), drawing_format(obj.drawing_format),
+	drawing_stride(obj.drawing_stride), drawing_width(obj.drawing_width), drawing_height(obj.drawing_height), monitor_rect(obj.monitor_rect), monitor_id(obj.monitor_id), is_primary(obj.is_primary)
 {
 	drawing_hdc = obj.drawing_hdc;
 	obj.drawing_hdc = NULL;
@@ -86,6 +86,9 @@ Monitor::Monitor(Monitor&& obj) noexcept :
 
 	drawing_pixels = obj.drawing_pixels;
 	obj.drawing_pixels = nullptr;
+
+	surfaces = std::move(obj.surfaces);
+	obj.surfaces.clear();
 }
 
 bool Monitor::DrawFrame(Frame& frame)
@@ -93,54 +96,207 @@ bool Monitor::DrawFrame(Frame& frame)
 	if (frame.frame_buf == nullptr || frame.crop_width == 0 || frame.crop_height == 0)
 		return false;
 
-	// try to lock mutex for 5 sec
-	if (!worker_lock.try_lock_for(std::chrono::seconds(5)))
-		return false;
+	// worker's HDC is shared by all monitors, but only compositor thread draws on it
 
-	std::lock_guard<std::timed_mutex> locker(worker_lock, std::adopt_lock_t());
+	// frame was decoded directly into one of our DIB sections - nothing to copy
+	HBITMAP source_bitmap = NULL;
+	for (auto& surface : surfaces) {
+		if (surface.pixels == frame.frame_buf) {
+			source_bitmap = surface.bitmap;
+			break;
+		}
+	}
 
+	// our DIB must have the same pixel format as frame and fit it
+	if (!source_bitmap && (frame.format != drawing_format || frame.crop_width > drawing_width || frame.crop_height > drawing_height)) {
+		if (!CreateDrawingBitmap(frame.format, std::max(frame.crop_width, monitor_width), std::max(frame.crop_height, monitor_height)))
+			return false;
+	}
+
+	int bpp = frame.bytes_per_pixel;
+	const uint8_t* region = frame.frame_buf + (size_t)frame.linesize * frame.y_offset + (size_t)frame.x_offset * bpp;
+
+	// our DIB has only changed tiles of the previous frame, if it was drawn from another DIB
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (!tile_diff.IsSameGeometry(frame.crop_width, frame.crop_height, bpp))
+		tile_diff.Reset(frame.crop_width, frame.crop_height, bpp);
+	else if ((!source_bitmap && last_from_surface) || now - last_full_present > std::chrono::seconds(1))
+		tile_diff.Invalidate();	// desktop can be repainted by system, so sometimes the whole frame is presented
+
+	size_t dirty_tiles = tile_diff.Update(region, frame.linesize);
+	dirty_ratio = tile_diff.GetDirtyRatio();
+
+	// the same frame is already on the screen
+	if (dirty_tiles == 0) {
+		++skipped_frames;
+		return true;
+	}
+
+	if (dirty_tiles == tile_diff.GetTilesCount())
+		last_full_present = now;
+
+	last_from_surface = source_bitmap != NULL;
 
 	// change bitmap to our
-	HGDIOBJ old_bitmap = SelectObject(drawing_hdc, drawing_bitmap);
+	HGDIOBJ old_bitmap = SelectObject(drawing_hdc, source_bitmap ? source_bitmap : drawing_bitmap);
 	if (!old_bitmap)
 		return false;
 
+	// copy changed tiles of frame to DIB
+	if (!source_bitmap) {
+		TRACE_SCOPE("CopyDirty");
+		tile_diff.CopyDirty(region, frame.linesize, drawing_pixels, drawing_stride);
+	}
+
+	TRACE_SCOPE("Blit");
 
-	// copy frame pixels to DIB
 	int copy_code = 0;
-	for (long f = frame.y_offset, t = 0; f < (frame.y_offset + frame.crop_height); ++f, ++t) {
-		copy_code = memcpy_s(
-			drawing_pixels + monitor_width * t * 3, drawing_pixels_size - monitor_width * t * 3,
-			frame.frame_buf + frame.linesize * f + frame.x_offset * 3, frame.crop_width * 3
-		);
 
-		if (copy_code) {
-			SelectObject(drawing_hdc, old_bitmap);
-			return false;
+	// without scaling changed tiles are blitted one by one, scaled tiles could have seams
+	const std::vector<TileDiff::Rect>& dirty_rects = tile_diff.GetDirtyRects();
+	bool is_scaled = frame.crop_width != monitor_width || frame.crop_height != monitor_height;
+
+	if (!is_scaled && dirty_rects.size() <= 64) {
+		for (auto& rect : dirty_rects) {
+			copy_code = BitBlt(worker_hdc, x_offset + rect.x, y_offset + rect.y, rect.width, rect.height,
+				drawing_hdc, rect.x, rect.y, SRCCOPY);
+
+			if (!copy_code)
+				break;
 		}
 	}
+	else {
+		// stretching the original frame to monitor
+		copy_code = StretchBlt(
+			worker_hdc,										// destination HDC
+			x_offset, y_offset,								// upper left corner of the destination rectangle
+			monitor_width, monitor_height,					// width and heigh of the destination rectangle
+			drawing_hdc,									// source HDC
+			0, 0,	 										// upper left corner of the source rectangle
+			frame.crop_width, frame.crop_height,	 		// width and heigh of the source rectangle
+			SRCCOPY
+		);
+	}
 
-	// stretching the original frame to monitor
-	copy_code = StretchBlt(
-		worker_hdc,										// destination HDC
-		x_offset, y_offset,								// upper left corner of the destination rectangle
-		monitor_width, monitor_height,					// width and heigh of the destination rectangle
-		drawing_hdc,									// source HDC
-		0, 0,	 										// upper left corner of the source rectangle
-		frame.crop_width, frame.crop_height,	 		// width and heigh of the source rectangle
-		SRCCOPY
-	);
+	SelectObject(drawing_hdc, old_bitmap);
 
+	// tiles which weren't presented must be presented with the next frame
 	if (!copy_code) {
-		SelectObject(drawing_hdc, old_bitmap);
+		tile_diff.Invalidate();
 		return false;
 	}
 
-	SelectObject(drawing_hdc, old_bitmap);
+	return true;
+}
+
+bool Monitor::CreateSurfaces(size_t count, long width, long height, const Frame& frame_template, std::vector<Frame>& frames)
+{
+	ReleaseSurfaces();
+
+	if (count == 0 || width <= 0 || height <= 0)
+		return false;
+
+	int bpp = frame_template.bytes_per_pixel;
+
+	BITMAPINFO surface_info = bitmap_info;
+	surface_info.bmiHeader.biWidth = width;
+	surface_info.bmiHeader.biHeight = -height;
+	surface_info.bmiHeader.biBitCount = (WORD)(bpp * 8);
+
+	// DIB rows are aligned to 4 bytes
+	long stride = (width * bpp + 3) & ~3;
+	surface_info.bmiHeader.biSizeImage = stride * height;
+
+	frames.clear();
+	for (size_t i = 0; i < count; ++i) {
+		Surface surface = { NULL, nullptr };
+
+		// pixels will be freed when DeleteObject will be called
+		surface.bitmap = CreateDIBSection(drawing_hdc, &surface_info, DIB_RGB_COLORS, reinterpret_cast<void**>(&surface.pixels), NULL, 0);
+		if (!surface.bitmap) {
+			ReleaseSurfaces();
+			frames.clear();
+			return false;
+		}
+
+		surfaces.push_back(surface);
+
+		Frame frame = frame_template;
+		frame.frame_buf = surface.pixels;
+		frame.linesize = stride;
+		frame.original_width = width;
+		frame.original_height = height;
+		frames.push_back(frame);
+	}
 
 	return true;
 }
 
+bool Monitor::CreateDrawingBitmap(FrameFormat format, long width, long height)
+{
+	if (drawing_bitmap) {
+		DeleteObject(drawing_bitmap);
+		drawing_bitmap = NULL;
+		drawing_pixels = nullptr;
+	}
+
+	int bpp = GetBytesPerPixel(format);
+
+	// DIB rows are aligned to 4 bytes
+	drawing_stride = (width * bpp + 3) & ~3;
+
+	bitmap_info.bmiHeader.biWidth = width;
+	bitmap_info.bmiHeader.biHeight = -height;
+	bitmap_info.bmiHeader.biBitCount = (WORD)(bpp * 8);
+	bitmap_info.bmiHeader.biSizeImage = drawing_stride * height;
+
+	// drawing_pixels will be freed when DeleteObject will be called
+	drawing_bitmap = CreateDIBSection(drawing_hdc, &bitmap_info, DIB_PAL_COLORS, reinterpret_cast<void**>(&drawing_pixels), NULL, 0);
+	if (!drawing_bitmap)
+		return false;
+
+	drawing_format = format;
+	drawing_width = width;
+	drawing_height = height;
+	drawing_pixels_size = (size_t)drawing_stride * height;
+
+	// new DIB doesn't have pixels of the previous frame
+	tile_diff.Invalidate();
+
+	return true;
+}
+
+void Monitor::ReleaseSurfaces()
+{
+	for (auto& surface : surfaces) {
+		if (surface.bitmap)
+			DeleteObject(surface.bitmap);
+	}
+
+	surfaces.clear();
+}
+
+void Monitor::Flush()
+{
+	// GDI batches calls of this thread, so one flush finishes drawing of all monitors
+	GdiFlush();
+}
+
+int Monitor::GetTargetID()
+{
+	return monitor_id;
+}
+
+double Monitor::GetDirtyRatio()
+{
+	return dirty_ratio;
+}
+
+uint64_t Monitor::GetSkippedFrames()
+{
+	return skipped_frames;
+}
+
 bool Monitor::GetResolution(long& width, long& height)
 {
 	if (monitor_width == 0 || monitor_height == 0)
@@ -152,6 +308,19 @@ bool Monitor::GetResolution(long& width, long& height)
 	return true;
 }
 
+double Monitor::GetRefreshRate()
+{
+	if (!worker_hdc)
+		return 60.0;
+
+	// 0 and 1 mean default refresh rate of hardware
+	int refresh_rate = GetDeviceCaps(worker_hdc, VREFRESH);
+	if (refresh_rate <= 1)
+		return 60.0;
+
+	return refresh_rate;
+}
+
 bool Monitor::Initialize()
 {
 	BOOL ret_code;
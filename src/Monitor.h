@@ -3,15 +3,17 @@
 #include "Windows.h"
 
 #include "MediaPack.h"
+#include "Compositor.h"
+#include "TileDiff.h"
 
 #include <iostream>
 #include <vector>
 #include <deque>
-#include <mutex>
 #include <chrono>
+#include <atomic>
 
 
-class Monitor {
+class Monitor : public FrameTarget {
 public:
 	Monitor() = delete;
 	Monitor(int monitor_id, RECT rect, bool is_primary);
@@ -23,9 +25,23 @@ public:
 	Monitor(Monitor&& obj) noexcept;
 	Monitor& operator=(Monitor&& obj) = delete;
 
-	bool DrawFrame(Frame& frame);
+	// must be called only by compositor thread, which flushes GDI after drawing
+	bool DrawFrame(Frame& frame) override;
+	void Flush() override;
 
-	bool GetResolution(long& width, long& height);
+	int GetTargetID() override;
+	bool GetResolution(long& width, long& height) override;
+
+	// DIB sections which frames can be decoded directly into, so DrawFrame doesn't copy them
+	bool CreateSurfaces(size_t count, long width, long height, const Frame& frame_template, std::vector<Frame>& frames) override;
+	void ReleaseSurfaces() override;
+
+	// part of the last frame which was changed, identical frames aren't presented at all
+	double GetDirtyRatio() override;
+	uint64_t GetSkippedFrames() override;
+
+	// refresh rate of the desktop, 60 if it's unknown
+	static double GetRefreshRate();
 
 	static bool Initialize();
 	static void Finilize();
@@ -40,7 +56,6 @@ private:
 	static BOOL WINAPI MonitorEnumProc(HMONITOR monitor, HDC hdc, LPRECT rect, LPARAM data);
 
 	static bool is_initialized;
-	static std::timed_mutex worker_lock;
 
 	// ProgMan HWND
 	static HWND progman_hwnd;
@@ -56,6 +71,26 @@ private:
 	BITMAPINFO bitmap_info;
 	uint8_t* drawing_pixels = nullptr;
 	size_t drawing_pixels_size = 0;
+	FrameFormat drawing_format = FrameFormat::BGRA;
+	long drawing_stride = 0;
+	long drawing_width = 0, drawing_height = 0;
+
+	// (re)create drawing DIB for frames of this format and size
+	bool CreateDrawingBitmap(FrameFormat format, long width, long height);
+
+	// only changed tiles are copied and presented
+	TileDiff tile_diff;
+	bool last_from_surface = false;
+	std::chrono::steady_clock::time_point last_full_present;
+	std::atomic<double> dirty_ratio{ 0.0 };
+	std::atomic<uint64_t> skipped_frames{ 0 };
+
+	// DIB sections owned by player's frame queue
+	struct Surface {
+		HBITMAP bitmap;
+		uint8_t* pixels;
+	};
+	std::vector<Surface> surfaces;
 
 	// monitor params
 	RECT monitor_rect;
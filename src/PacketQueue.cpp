@@ -0,0 +1,180 @@
+#include "PacketQueue.h"
+
+#include <stdexcept>
+
+
+PacketQueue::PacketQueue(const Limits& limits) :
+	limits(limits)
+{
+	if (limits.max_packets == 0 || limits.low_bytes > limits.high_bytes || limits.low_seconds > limits.high_seconds)
+		throw std::runtime_error("Wrong packet queue params.");
+
+	packets.resize(limits.max_packets, nullptr);
+	durations.resize(limits.max_packets, 0.0);
+
+	for (auto& packet : packets) {
+		packet = av_packet_alloc();
+		if (!packet) {
+			for (auto& allocated : packets)
+				av_packet_free(&allocated);
+
+			throw std::runtime_error("Can't allocate packet queue.");
+		}
+	}
+}
+
+PacketQueue::~PacketQueue()
+{
+	for (auto& packet : packets)
+		av_packet_free(&packet);
+}
+
+AVPacket* PacketQueue::BeginWrite()
+{
+	std::unique_lock<std::mutex> locker(queue_lock);
+
+	if (!is_draining && IsAboveHigh())
+		is_draining = true;
+
+	packet_read.wait(locker, [this]() {
+		return is_aborted || (is_draining ? IsBelowLow() : count < packets.size());
+	});
+
+	if (is_aborted)
+		return nullptr;
+
+	if (is_draining) {
+		is_draining = false;
+		++refills;
+	}
+
+	// the slot after the last packet isn't read by consumer, so it is filled without lock
+	return packets[(read_idx + count) % packets.size()];
+}
+
+void PacketQueue::EndWrite(double duration_seconds)
+{
+	{
+		std::lock_guard<std::mutex> locker(queue_lock);
+
+		size_t write_idx = (read_idx + count) % packets.size();
+		durations[write_idx] = duration_seconds;
+
+		bytes += packets[write_idx]->size;
+		seconds += duration_seconds;
+		++count;
+	}
+
+	packet_written.notify_one();
+}
+
+void PacketQueue::Finish(int code)
+{
+	{
+		std::lock_guard<std::mutex> locker(queue_lock);
+		is_finished = true;
+		finish_code = code;
+	}
+
+	packet_written.notify_one();
+}
+
+int PacketQueue::Read(AVPacket* packet)
+{
+	AVPacket* queued = nullptr;
+	{
+		std::unique_lock<std::mutex> locker(queue_lock);
+
+		// decoder is faster than disk
+		if (count == 0 && !is_finished && !is_aborted && was_read)
+			++underruns;
+
+		packet_written.wait(locker, [this]() {
+			return is_aborted || is_finished || count > 0;
+		});
+
+		// packets written before Finish are read first
+		if (count == 0)
+			return is_aborted ? AVERROR_EXIT : finish_code;
+
+		queued = packets[read_idx];
+
+		bytes -= queued->size;
+		seconds -= durations[read_idx];
+		if (count == 1)
+			seconds = 0.0;	// no accumulated rounding error in empty queue
+
+		// data reference is moved, the packet itself stays in the ring
+		av_packet_move_ref(packet, queued);
+
+		read_idx = (read_idx + 1) % packets.size();
+		--count;
+		was_read = true;
+	}
+
+	packet_read.notify_one();
+
+	return 0;
+}
+
+void PacketQueue::Abort()
+{
+	{
+		std::lock_guard<std::mutex> locker(queue_lock);
+		is_aborted = true;
+	}
+
+	packet_written.notify_all();
+	packet_read.notify_all();
+}
+
+void PacketQueue::Resume()
+{
+	std::lock_guard<std::mutex> locker(queue_lock);
+
+	is_aborted = false;
+	is_finished = false;
+	finish_code = 0;
+}
+
+void PacketQueue::Reset()
+{
+	std::lock_guard<std::mutex> locker(queue_lock);
+
+	for (auto& packet : packets)
+		av_packet_unref(packet);
+
+	read_idx = 0;
+	count = 0;
+	bytes = 0;
+	seconds = 0.0;
+
+	is_draining = false;
+	is_finished = false;
+	finish_code = 0;
+	was_read = false;
+}
+
+PacketQueue::Stats PacketQueue::GetStats()
+{
+	std::lock_guard<std::mutex> locker(queue_lock);
+
+	Stats stats;
+	stats.packets = count;
+	stats.bytes = bytes;
+	stats.seconds = seconds;
+	stats.underruns = underruns;
+	stats.refills = refills;
+
+	return stats;
+}
+
+bool PacketQueue::IsAboveHigh()
+{
+	return count >= packets.size() || bytes >= limits.high_bytes || seconds >= limits.high_seconds;
+}
+
+bool PacketQueue::IsBelowLow()
+{
+	return bytes <= limits.low_bytes && seconds <= limits.low_seconds && count < packets.size();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+// Bounded queue of demuxed packets between demuxer thread and decoder. Packets are allocated
+// once and recycled, only their data references are moved through the queue. Demuxer fills
+// the queue up to a high watermark (bytes or seconds of media) and then waits until decoder
+// drains it to the low watermark, so the disk is read in bursts instead of packet by packet.
+class PacketQueue {
+public:
+	struct Limits {
+		size_t max_packets = 512;
+		size_t high_bytes = 32 * 1024 * 1024, low_bytes = 16 * 1024 * 1024;
+		double high_seconds = 2.0, low_seconds = 1.0;
+	};
+
+	struct Stats {
+		size_t packets = 0;
+		size_t bytes = 0;
+		double seconds = 0.0;
+		uint64_t underruns = 0;		// decoder waited for a packet after the queue was started
+		uint64_t refills = 0;		// queue was drained to low watermark and filled again
+	};
+
+	PacketQueue(const Limits& limits);
+	~PacketQueue();
+
+	PacketQueue(const PacketQueue& obj) = delete;
+	PacketQueue& operator=(const PacketQueue& obj) = delete;
+
+	// producer: empty packet to fill, waits while queue is above watermark; nullptr after Abort
+	AVPacket* BeginWrite();
+	void EndWrite(double duration_seconds);
+
+	// producer: no more packets will be written, code is returned to decoder (e.g. AVERROR_EOF)
+	void Finish(int code);
+
+	// consumer: moves the oldest packet into 'packet', waits while queue is empty;
+	// returns 0, code given to Finish or AVERROR_EXIT after Abort
+	int Read(AVPacket* packet);
+
+	// wake up both sides, they stop waiting; packets which are already queued can still be read
+	void Abort();
+
+	// after Abort, for a new producer which continues where the old one stopped
+	void Resume();
+
+	// drop all packets and errors, aborted queue stays aborted; nobody may use the queue at this moment
+	void Reset();
+
+	Stats GetStats();
+
+private:
+	bool IsAboveHigh();
+	bool IsBelowLow();
+
+	Limits limits;
+
+	std::mutex queue_lock;
+	std::condition_variable packet_written, packet_read;
+
+	// ring of recycled packets, durations are kept separately
+	std::vector<AVPacket*> packets;
+	std::vector<double> durations;
+	size_t read_idx = 0, count = 0;
+
+	size_t bytes = 0;
+	double seconds = 0.0;
+
+	// producer waits for the low watermark after reaching the high one
+	bool is_draining = false;
+
+	bool is_finished = false, is_aborted = false;
+	int finish_code = 0;
+	bool was_read = false;
+
+	uint64_t underruns = 0, refills = 0;
+};
@@ -0,0 +1,140 @@
+#include "PlaybackPolicy.h"
+
+#include <algorithm>
+
+
+FpsCapPolicy::FpsCapPolicy(double max_fps) :
+	max_fps(max_fps)
+{
+}
+
+PlaybackDecision FpsCapPolicy::Decide(double media_fps, time_point now)
+{
+	PlaybackDecision decision;
+
+	if (max_fps > 0.0 && (media_fps <= 0.0 || max_fps < media_fps))
+		decision.max_fps = max_fps;
+
+	return decision;
+}
+
+LoadThrottlePolicy::LoadThrottlePolicy(std::shared_ptr<LoadSource> load_source, double threshold, double release,
+	std::chrono::steady_clock::duration sample_interval) :
+	load_source(load_source), threshold(threshold), release(std::min(release, threshold)), sample_interval(sample_interval)
+{
+}
+
+PlaybackDecision LoadThrottlePolicy::Decide(double media_fps, time_point now)
+{
+	// load is averaged over sample interval, so short spikes don't switch frame rate
+	if (load_source && (!is_sampled || now >= next_sample)) {
+		double load = load_source->GetCpuLoad();
+		if (load >= 0.0) {
+			last_load = load;
+
+			if (load > threshold)
+				is_throttled = true;
+			else if (load < release)
+				is_throttled = false;
+		}
+
+		is_sampled = true;
+		next_sample = now + sample_interval;
+	}
+
+	PlaybackDecision decision;
+
+	if (is_throttled && media_fps > 0.0) {
+		decision.max_fps = media_fps / 2.0;
+		decision.reduce_decoding = true;
+	}
+
+	return decision;
+}
+
+bool LoadThrottlePolicy::IsThrottled()
+{
+	return is_throttled;
+}
+
+double LoadThrottlePolicy::GetLastLoad()
+{
+	return last_load;
+}
+
+PlaybackDecision PausePolicy::Decide(double media_fps, time_point now)
+{
+	PlaybackDecision decision;
+	decision.pause = is_paused;
+
+	return decision;
+}
+
+void PausePolicy::SetPaused(bool paused)
+{
+	is_paused = paused;
+}
+
+bool PausePolicy::IsPaused()
+{
+	return is_paused;
+}
+
+void CombinedPolicy::AddPolicy(std::shared_ptr<PlaybackPolicy> policy)
+{
+	if (policy)
+		policies.push_back(policy);
+}
+
+PlaybackDecision CombinedPolicy::Decide(double media_fps, time_point now)
+{
+	PlaybackDecision result;
+
+	// every policy is asked, so all of them keep their state up to date
+	for (auto& policy : policies) {
+		PlaybackDecision decision = policy->Decide(media_fps, now);
+
+		result.pause = result.pause || decision.pause;
+		result.reduce_decoding = result.reduce_decoding || decision.reduce_decoding;
+
+		if (decision.max_fps > 0.0 && (result.max_fps == 0.0 || decision.max_fps < result.max_fps))
+			result.max_fps = decision.max_fps;
+	}
+
+	return result;
+}
+
+void FrameLimiter::Reset()
+{
+	is_started = false;
+}
+
+bool FrameLimiter::ShouldPresent(double timestamp, double duration, double max_fps)
+{
+	// media went back (e.g. seek), so previous timestamps mean nothing
+	if (is_started && timestamp < last_timestamp)
+		is_started = false;
+
+	last_timestamp = timestamp;
+
+	if (max_fps <= 0.0) {
+		is_started = false;
+		return true;
+	}
+
+	// half of frame tolerance, e.g. every second frame of 60 fps media is presented at 30 fps
+	if (is_started && timestamp + duration / 2.0 < next_timestamp)
+		return false;
+
+	double interval = 1.0 / max_fps;
+
+	// next frame is counted from the planned time, so rounding errors don't accumulate
+	if (is_started && timestamp - next_timestamp < interval)
+		next_timestamp += interval;
+	else
+		next_timestamp = timestamp + interval;
+
+	is_started = true;
+
+	return true;
+}
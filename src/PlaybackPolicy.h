@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+
+// System CPU load for policies. Real one is SystemLoadSource, tests can use a fake one.
+class LoadSource {
+public:
+	virtual ~LoadSource() = default;
+
+	// recent load of all cores, 0.0 - 1.0, negative if unknown;
+	// one source may be shared by several policies, so it must not depend on who called it last
+	virtual double GetCpuLoad() = 0;
+};
+
+
+// What player is allowed to do with the next frame.
+struct PlaybackDecision {
+	bool pause = false;				// decoder thread is stopped, the last frame stays on monitor
+	double max_fps = 0.0;			// presented frames per second, 0 - not limited
+	bool reduce_decoding = false;	// decoder skips non-reference frames
+};
+
+
+// Consulted by player thread before every frame. Current time is passed in by caller,
+// so policies don't depend on real time.
+class PlaybackPolicy {
+public:
+	typedef std::chrono::steady_clock::time_point time_point;
+
+	virtual ~PlaybackPolicy() = default;
+
+	virtual PlaybackDecision Decide(double media_fps, time_point now) = 0;
+};
+
+
+// Frame rate is never higher than max_fps.
+class FpsCapPolicy : public PlaybackPolicy {
+public:
+	FpsCapPolicy(double max_fps);
+
+	PlaybackDecision Decide(double media_fps, time_point now) override;
+
+private:
+	double max_fps;
+};
+
+
+// Half of media frame rate and lighter decoding while system CPU load is above threshold.
+// Full rate is restored when load falls below release threshold.
+class LoadThrottlePolicy : public PlaybackPolicy {
+public:
+	LoadThrottlePolicy(std::shared_ptr<LoadSource> load_source, double threshold = 0.85, double release = 0.65,
+		std::chrono::steady_clock::duration sample_interval = std::chrono::seconds(1));
+
+	PlaybackDecision Decide(double media_fps, time_point now) override;
+
+	bool IsThrottled();
+	double GetLastLoad();
+
+private:
+	std::shared_ptr<LoadSource> load_source;
+	double threshold, release;
+	std::chrono::steady_clock::duration sample_interval;
+
+	time_point next_sample;
+	bool is_sampled = false;
+
+	std::atomic<bool> is_throttled{ false };
+	std::atomic<double> last_load{ 0.0 };
+};
+
+
+// Pause switched from any thread, e.g. by user or when fullscreen application is active.
+class PausePolicy : public PlaybackPolicy {
+public:
+	PausePolicy() = default;
+
+	PlaybackDecision Decide(double media_fps, time_point now) override;
+
+	void SetPaused(bool paused);
+	bool IsPaused();
+
+private:
+	std::atomic<bool> is_paused{ false };
+};
+
+
+// All policies are applied: pause if any of them pauses, the lowest frame rate.
+class CombinedPolicy : public PlaybackPolicy {
+public:
+	CombinedPolicy() = default;
+
+	void AddPolicy(std::shared_ptr<PlaybackPolicy> policy);
+
+	PlaybackDecision Decide(double media_fps, time_point now) override;
+
+private:
+	std::vector<std::shared_ptr<PlaybackPolicy>> policies;
+};
+
+
+// Chooses frames to present under frame rate limit by their timestamps,
+// other frames are dropped without drawing.
+class FrameLimiter {
+public:
+	FrameLimiter() = default;
+
+	void Reset();
+
+	// max_fps == 0 - every frame is presented
+	bool ShouldPresent(double timestamp, double duration, double max_fps);
+
+private:
+	bool is_started = false;
+	double next_timestamp = 0.0;
+	double last_timestamp = 0.0;
+};
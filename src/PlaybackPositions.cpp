@@ -0,0 +1,165 @@
+#include "PlaybackPositions.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+
+std::mutex PlaybackPositions::positions_lock;
+std::string PlaybackPositions::positions_file = PlaybackPositions::GetDefaultFile();
+
+// one line of the file, false if it is damaged
+static bool ParseLine(const std::string& line, int& monitor_id, double& position, std::string& path)
+{
+	std::istringstream line_stream(line);
+	std::string monitor_field, position_field;
+	if (!std::getline(line_stream, monitor_field, '\t') || !std::getline(line_stream, position_field, '\t') ||
+		!std::getline(line_stream, path) || path.empty())
+		return false;
+
+	try {
+		monitor_id = std::stoi(monitor_field);
+		position = std::stod(position_field);
+	}
+	catch (std::exception&) {
+		return false;
+	}
+
+	return position >= 0.0;
+}
+
+void PlaybackPositions::SetFile(const std::string& file)
+{
+	std::lock_guard<std::mutex> locker(positions_lock);
+
+	positions_file = file;
+}
+
+std::string PlaybackPositions::GetFile()
+{
+	std::lock_guard<std::mutex> locker(positions_lock);
+
+	return positions_file;
+}
+
+std::string PlaybackPositions::GetDefaultFile()
+{
+	std::filesystem::path file;
+
+#ifdef _WIN32
+	char app_data[MAX_PATH];
+	DWORD size = GetEnvironmentVariableA("APPDATA", app_data, MAX_PATH);
+	if (size > 0 && size < MAX_PATH)
+		file = std::filesystem::path(app_data) / "DynamicWallpaper" / "positions.txt";
+#else
+	const char* state_home = std::getenv("XDG_STATE_HOME");
+	const char* home = std::getenv("HOME");
+	if (state_home && *state_home)
+		file = std::filesystem::path(state_home) / "dynamic-wallpaper" / "positions";
+	else if (home && *home)
+		file = std::filesystem::path(home) / ".local" / "state" / "dynamic-wallpaper" / "positions";
+#endif
+
+	// next to the working folder if there is no user profile
+	if (file.empty())
+		file = "positions.txt";
+
+	return file.string();
+}
+
+bool PlaybackPositions::Load(int monitor_id, std::string& path, double& position)
+{
+	std::lock_guard<std::mutex> locker(positions_lock);
+
+	if (positions_file.empty())
+		return false;
+
+	std::ifstream file(positions_file);
+	if (!file)
+		return false;
+
+	std::string line;
+	while (std::getline(file, line)) {
+		int line_monitor_id = 0;
+		double line_position = 0.0;
+		std::string line_path;
+		if (ParseLine(line, line_monitor_id, line_position, line_path) && line_monitor_id == monitor_id) {
+			path = line_path;
+			position = line_position;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool PlaybackPositions::Store(int monitor_id, const std::string& path, double position)
+{
+	if (path.empty() || path.find('\n') != std::string::npos)
+		return false;
+
+	std::lock_guard<std::mutex> locker(positions_lock);
+
+	if (positions_file.empty())
+		return false;
+
+	// lines of other monitors are kept
+	std::vector<std::string> lines;
+	{
+		std::ifstream file(positions_file);
+		std::string line;
+		while (file && std::getline(file, line)) {
+			int line_monitor_id = 0;
+			double line_position = 0.0;
+			std::string line_path;
+			if (ParseLine(line, line_monitor_id, line_position, line_path) && line_monitor_id != monitor_id)
+				lines.push_back(line);
+		}
+	}
+
+	std::ostringstream new_line;
+	new_line.precision(17);
+	new_line << monitor_id << '\t' << position << '\t' << path;
+	lines.push_back(new_line.str());
+
+	std::error_code error;
+	std::filesystem::path file_path(positions_file);
+	if (file_path.has_parent_path()) {
+		std::filesystem::create_directories(file_path.parent_path(), error);
+		if (error)
+			return false;
+	}
+
+	// the old file stays valid if writing is interrupted
+	std::string temp_path = positions_file + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::trunc);
+		if (!file)
+			return false;
+
+		for (const std::string& line : lines)
+			file << line << '\n';
+
+		file.close();
+		if (file.fail()) {
+			std::filesystem::remove(temp_path, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temp_path, positions_file, error);
+	if (error) {
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+
+
+// The last position of media played on every monitor, kept in a small text file, one line per monitor:
+//   monitor_id <tab> position in seconds <tab> media path
+// Player stores it when it stops and resumes the same media from it on the next start.
+class PlaybackPositions {
+public:
+	PlaybackPositions() = delete;
+
+	// file of positions; empty - positions aren't kept
+	static void SetFile(const std::string& file);
+	static std::string GetFile();
+
+	// per-user state file: %APPDATA% on Windows, $XDG_STATE_HOME or ~/.local/state elsewhere
+	static std::string GetDefaultFile();
+
+	// false if nothing was stored for the monitor
+	static bool Load(int monitor_id, std::string& path, double& position);
+	static bool Store(int monitor_id, const std::string& path, double position);
+
+private:
+	static std::mutex positions_lock;
+	static std::string positions_file;
+};
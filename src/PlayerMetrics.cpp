@@ -0,0 +1,207 @@
+#include "PlayerMetrics.h"
+
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+
+
+LatencyHistogram::LatencyHistogram()
+{
+	Reset();
+}
+
+void LatencyHistogram::Record(std::chrono::steady_clock::duration duration)
+{
+	int64_t value_us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+
+	RecordUs(value_us > 0 ? (uint64_t)value_us : 0);
+}
+
+void LatencyHistogram::RecordMs(double milliseconds)
+{
+	RecordUs(milliseconds > 0.0 ? (uint64_t)(milliseconds * 1000.0 + 0.5) : 0);
+}
+
+void LatencyHistogram::RecordUs(uint64_t value_us)
+{
+	buckets[GetBucket(value_us)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	total_us.fetch_add(value_us, std::memory_order_relaxed);
+
+	// only one thread records into a histogram, so max doesn't need compare-exchange
+	if (value_us > max_us.load(std::memory_order_relaxed))
+		max_us.store(value_us, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Reset()
+{
+	for (auto& bucket : buckets)
+		bucket.store(0, std::memory_order_relaxed);
+
+	count = 0;
+	total_us = 0;
+	max_us = 0;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot()
+{
+	Snapshot snapshot;
+
+	snapshot.count = count.load(std::memory_order_relaxed);
+	if (snapshot.count == 0)
+		return snapshot;
+
+	snapshot.mean_ms = total_us.load(std::memory_order_relaxed) / 1000.0 / snapshot.count;
+	snapshot.p50_ms = GetPercentileUs(0.5) / 1000.0;
+	snapshot.p90_ms = GetPercentileUs(0.9) / 1000.0;
+	snapshot.p99_ms = GetPercentileUs(0.99) / 1000.0;
+	snapshot.max_ms = max_us.load(std::memory_order_relaxed) / 1000.0;
+
+	return snapshot;
+}
+
+uint64_t LatencyHistogram::GetPercentileUs(double part)
+{
+	// buckets can be changed while they are summed, so total is counted here
+	uint64_t total = 0;
+	for (auto& bucket : buckets)
+		total += bucket.load(std::memory_order_relaxed);
+
+	if (total == 0)
+		return 0;
+
+	uint64_t rank = (uint64_t)std::ceil(part * total);
+	if (rank == 0)
+		rank = 1;
+
+	uint64_t counted = 0;
+	for (size_t i = 0; i < buckets_count; ++i) {
+		counted += buckets[i].load(std::memory_order_relaxed);
+		if (counted >= rank)
+			return std::min(GetBucketValue(i), max_us.load(std::memory_order_relaxed));
+	}
+
+	return max_us;
+}
+
+size_t LatencyHistogram::GetBucket(uint64_t value_us)
+{
+	if (value_us < (1 << linear_bits))
+		return (size_t)value_us;
+
+	// position of the highest bit
+	int msb = linear_bits;
+	while (msb + 1 < max_bits && (value_us >> (msb + 1)) != 0)
+		++msb;
+
+	if ((value_us >> max_bits) != 0)
+		return buckets_count - 1;
+
+	size_t sub_bucket = (size_t)(value_us >> (msb - sub_bits)) & ((1 << sub_bits) - 1);
+
+	return (1 << linear_bits) + (size_t)(msb - linear_bits) * (1 << sub_bits) + sub_bucket;
+}
+
+uint64_t LatencyHistogram::GetBucketValue(size_t bucket)
+{
+	if (bucket < (1 << linear_bits))
+		return bucket;
+
+	size_t index = bucket - (1 << linear_bits);
+	int msb = linear_bits + (int)(index >> sub_bits);
+	uint64_t sub_bucket = index & ((1 << sub_bits) - 1);
+
+	// middle of the bucket
+	uint64_t width = (uint64_t)1 << (msb - sub_bits);
+	return (((uint64_t)1 << sub_bits) + sub_bucket) * width + width / 2;
+}
+
+std::string MetricsSnapshot::ToJson()
+{
+	std::ostringstream json;
+	json << std::fixed << std::setprecision(3);
+
+	auto histogram = [&json](const char* name, const LatencyHistogram::Snapshot& snapshot) {
+		json << "\"" << name << "\": {\"count\": " << snapshot.count << ", \"mean_ms\": " << snapshot.mean_ms
+			<< ", \"p50_ms\": " << snapshot.p50_ms << ", \"p90_ms\": " << snapshot.p90_ms
+			<< ", \"p99_ms\": " << snapshot.p99_ms << ", \"max_ms\": " << snapshot.max_ms << "}";
+	};
+
+	json << "{";
+	histogram("demux", demux);
+	json << ", ";
+	histogram("decode", decode);
+	json << ", ";
+	histogram("convert", convert);
+	json << ", ";
+	histogram("copy", copy);
+	json << ", ";
+	histogram("sleep_jitter", sleep_jitter);
+	json << ", ";
+	histogram("packet_queue", packet_queue);
+	json << ", \"packet_queue_packets\": " << packet_queue_packets << ", \"packet_queue_bytes\": " << packet_queue_bytes
+		<< ", \"demuxer_underruns\": " << demuxer_underruns << ", ";
+	histogram("media_switch", media_switch);
+	json << ", \"presented\": " << presented_frames << ", \"dropped\": " << dropped_frames
+		<< ", \"late\": " << late_frames << ", \"duplicated\": " << duplicated_frames
+		<< ", \"throttled\": " << throttled_frames << ", \"dirty_ratio\": " << dirty_ratio
+		<< ", \"skipped\": " << skipped_frames << "}";
+
+	return json.str();
+}
+
+void PlayerMetrics::Reset()
+{
+	demux.Reset();
+	decode.Reset();
+	convert.Reset();
+	copy.Reset();
+	sleep_jitter.Reset();
+
+	packet_queue.Reset();
+	packet_queue_packets = 0;
+	packet_queue_bytes = 0;
+	demuxer_underruns = 0;
+
+	media_switch.Reset();
+
+	presented_frames = 0;
+	dropped_frames = 0;
+	late_frames = 0;
+	duplicated_frames = 0;
+	throttled_frames = 0;
+
+	dirty_ppm_total = 0;
+	skipped_frames = 0;
+}
+
+MetricsSnapshot PlayerMetrics::GetSnapshot()
+{
+	MetricsSnapshot snapshot;
+
+	snapshot.demux = demux.GetSnapshot();
+	snapshot.decode = decode.GetSnapshot();
+	snapshot.convert = convert.GetSnapshot();
+	snapshot.copy = copy.GetSnapshot();
+	snapshot.sleep_jitter = sleep_jitter.GetSnapshot();
+
+	snapshot.packet_queue = packet_queue.GetSnapshot();
+	snapshot.packet_queue_packets = packet_queue_packets;
+	snapshot.packet_queue_bytes = packet_queue_bytes;
+	snapshot.demuxer_underruns = demuxer_underruns;
+
+	snapshot.media_switch = media_switch.GetSnapshot();
+
+	snapshot.presented_frames = presented_frames;
+	snapshot.dropped_frames = dropped_frames;
+	snapshot.late_frames = late_frames;
+	snapshot.duplicated_frames = duplicated_frames;
+	snapshot.throttled_frames = throttled_frames;
+
+	if (snapshot.presented_frames > 0)
+		snapshot.dirty_ratio = dirty_ppm_total.load(std::memory_order_relaxed) / 1e6 / snapshot.presented_frames;
+	snapshot.skipped_frames = skipped_frames;
+
+	return snapshot;
+}
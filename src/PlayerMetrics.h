@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+
+// Lock-free histogram of durations with about 1.5% precision, like HdrHistogram:
+// values up to 128 us are counted exactly, every next power of two is split into 64 buckets.
+// Record can be called from any thread, values above ~67 s fall into the last bucket.
+class LatencyHistogram {
+public:
+	struct Snapshot {
+		uint64_t count = 0;
+		double mean_ms = 0.0;
+		double p50_ms = 0.0, p90_ms = 0.0, p99_ms = 0.0, max_ms = 0.0;
+	};
+
+	LatencyHistogram();
+
+	LatencyHistogram(const LatencyHistogram& obj) = delete;
+	LatencyHistogram& operator=(const LatencyHistogram& obj) = delete;
+
+	void Record(std::chrono::steady_clock::duration duration);
+	void RecordMs(double milliseconds);
+	void Reset();
+
+	Snapshot GetSnapshot();
+
+	// microseconds of the value which is bigger than 'part' of recorded values (0.0 - 1.0)
+	uint64_t GetPercentileUs(double part);
+
+private:
+	static const int linear_bits = 7;		// values below 2^7 us have their own buckets
+	static const int sub_bits = 6;			// buckets per power of two
+	static const int max_bits = 26;			// 2^26 us ~ 67 s
+	static const size_t buckets_count = (1 << linear_bits) + (max_bits - linear_bits) * (1 << sub_bits);
+
+	static size_t GetBucket(uint64_t value_us);
+	static uint64_t GetBucketValue(size_t bucket);
+
+	void RecordUs(uint64_t value_us);
+
+	std::atomic<uint64_t> buckets[buckets_count];
+	std::atomic<uint64_t> count{ 0 };
+	std::atomic<uint64_t> total_us{ 0 };
+	std::atomic<uint64_t> max_us{ 0 };
+};
+
+
+// Copy of player's metrics at one moment
+struct MetricsSnapshot {
+	LatencyHistogram::Snapshot demux, decode, convert, copy, sleep_jitter;
+
+	// media time buffered in demuxer's packet queue, sampled for every decoded frame
+	LatencyHistogram::Snapshot packet_queue;
+	uint64_t packet_queue_packets = 0;
+	uint64_t packet_queue_bytes = 0;
+	uint64_t demuxer_underruns = 0;		// decoder waited for demuxer
+
+	// from switch request till the first frame of new media was drawn, count is number of switches
+	LatencyHistogram::Snapshot media_switch;
+
+	uint64_t presented_frames = 0;
+	uint64_t dropped_frames = 0;		// decoded too late and skipped to catch up
+	uint64_t late_frames = 0;			// presented later than their display interval
+	uint64_t duplicated_frames = 0;		// intervals when the previous frame stayed on monitor, decoder was behind
+	uint64_t throttled_frames = 0;		// skipped because of playback policy
+
+	// monitor of the player: mean changed part of presented frames (1.0 - every frame is drawn whole)
+	// and frames identical to the previous one, which monitor didn't present
+	double dirty_ratio = 0.0;
+	uint64_t skipped_frames = 0;
+
+	// one JSON object in a line
+	std::string ToJson();
+};
+
+
+// Per-stage timing and frame counters of one player. Updated by player thread with relaxed
+// atomics, so snapshot can be taken from any thread at any time.
+class PlayerMetrics {
+public:
+	PlayerMetrics() = default;
+
+	PlayerMetrics(const PlayerMetrics& obj) = delete;
+	PlayerMetrics& operator=(const PlayerMetrics& obj) = delete;
+
+	void Reset();
+
+	MetricsSnapshot GetSnapshot();
+
+	LatencyHistogram demux, decode, convert, copy, sleep_jitter;
+
+	LatencyHistogram packet_queue;
+	std::atomic<uint64_t> packet_queue_packets{ 0 };
+	std::atomic<uint64_t> packet_queue_bytes{ 0 };
+	std::atomic<uint64_t> demuxer_underruns{ 0 };
+
+	LatencyHistogram media_switch;
+
+	std::atomic<uint64_t> presented_frames{ 0 };
+	std::atomic<uint64_t> dropped_frames{ 0 };
+	std::atomic<uint64_t> late_frames{ 0 };
+	std::atomic<uint64_t> duplicated_frames{ 0 };
+	std::atomic<uint64_t> throttled_frames{ 0 };
+
+	// sum of dirty ratios of presented frames in millionths, it is averaged by snapshot
+	std::atomic<uint64_t> dirty_ppm_total{ 0 };
+	std::atomic<uint64_t> skipped_frames{ 0 };
+};
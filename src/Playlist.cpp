@@ -0,0 +1,65 @@
+#include "Playlist.h"
+
+
+void Playlist::AddItem(const std::string& path)
+{
+	items.push_back(path);
+}
+
+void Playlist::Clear()
+{
+	items.clear();
+}
+
+size_t Playlist::GetItemsCount()
+{
+	return items.size();
+}
+
+std::string Playlist::GetItem(size_t index)
+{
+	if (index >= items.size())
+		return std::string();
+
+	return items[index];
+}
+
+size_t Playlist::GetNextIndex(size_t index)
+{
+	if (items.empty())
+		return 0;
+
+	return (index + 1) % items.size();
+}
+
+bool Playlist::SetRotation(double seconds, size_t loops)
+{
+	if (seconds < 0.0 || (seconds == 0.0 && loops == 0))
+		return false;
+
+	rotation_seconds = seconds;
+	rotation_loops = loops;
+
+	return true;
+}
+
+double Playlist::GetRotationSeconds()
+{
+	return rotation_seconds;
+}
+
+size_t Playlist::GetRotationLoops()
+{
+	return rotation_loops;
+}
+
+bool Playlist::IsRotationDue(double seconds, size_t loops)
+{
+	if (rotation_seconds > 0.0 && seconds >= rotation_seconds)
+		return true;
+
+	if (rotation_loops > 0 && loops >= rotation_loops)
+		return true;
+
+	return false;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+// Media files played one after another on a monitor, after the last one the first is played
+// again. Player switches to the next item when time or loops of the current one are over.
+class Playlist {
+public:
+	Playlist() = default;
+
+	void AddItem(const std::string& path);
+	void Clear();
+
+	size_t GetItemsCount();
+	std::string GetItem(size_t index);
+
+	// index of the item after 'index', wraps around
+	size_t GetNextIndex(size_t index);
+
+	// item is switched after 'seconds' of its media time or after 'loops' loops, whichever
+	// comes first (0 - not limited); false if both are 0
+	bool SetRotation(double seconds, size_t loops);
+	double GetRotationSeconds();
+	size_t GetRotationLoops();
+
+	// current item played for 'seconds' and passed 'loops' loop boundaries
+	bool IsRotationDue(double seconds, size_t loops);
+
+private:
+	std::vector<std::string> items;
+
+	// every item is played once by default
+	double rotation_seconds = 0.0;
+	size_t rotation_loops = 1;
+};
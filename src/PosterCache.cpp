@@ -0,0 +1,360 @@
+#include "PosterCache.h"
+#include "ProbeCache.h"
+#include "ColorConverter.h"
+#include "FramePool.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+
+const char PosterCache::signature[8] = { 'D', 'W', 'P', 'O', 'S', 'T', 'R', '\0' };
+
+std::mutex PosterCache::cache_lock;
+std::string PosterCache::cache_directory = PosterCache::GetDefaultDirectory();
+
+static AVPixelFormat GetPixelFormat(FrameFormat format)
+{
+	return format == FrameFormat::BGR24 ? AV_PIX_FMT_BGR24 : AV_PIX_FMT_BGRA;
+}
+
+void PosterCache::SetDirectory(const std::string& directory)
+{
+	std::lock_guard<std::mutex> locker(cache_lock);
+
+	cache_directory = directory;
+}
+
+std::string PosterCache::GetDirectory()
+{
+	std::lock_guard<std::mutex> locker(cache_lock);
+
+	return cache_directory;
+}
+
+std::string PosterCache::GetDefaultDirectory()
+{
+	std::filesystem::path directory;
+
+#ifdef _WIN32
+	char local_app_data[MAX_PATH];
+	DWORD size = GetEnvironmentVariableA("LOCALAPPDATA", local_app_data, MAX_PATH);
+	if (size > 0 && size < MAX_PATH)
+		directory = std::filesystem::path(local_app_data) / "DynamicWallpaper" / "PosterCache";
+#else
+	const char* cache_home = std::getenv("XDG_CACHE_HOME");
+	const char* home = std::getenv("HOME");
+	if (cache_home && *cache_home)
+		directory = std::filesystem::path(cache_home) / "dynamic-wallpaper" / "poster";
+	else if (home && *home)
+		directory = std::filesystem::path(home) / ".cache" / "dynamic-wallpaper" / "poster";
+#endif
+
+	// next to the working folder if there is no user profile
+	if (directory.empty())
+		directory = "poster_cache";
+
+	return directory.string();
+}
+
+bool PosterCache::ReadHeader(std::istream& file, const std::string& path, const std::string& layout, double position, Header& header)
+{
+	uint64_t file_size = 0;
+	int64_t modified = 0;
+	if (!ProbeCache::GetFileKey(path, file_size, modified))
+		return false;
+
+	if (!file.read((char*)&header, sizeof(header)))
+		return false;
+
+	if (std::memcmp(header.signature, signature, sizeof(signature)) != 0 || header.version != version)
+		return false;
+
+	// media file was changed since poster was taken
+	if (header.file_size != file_size || header.modified != modified)
+		return false;
+
+	// frames are drawn from another position or with another scaling
+	if (std::abs(header.position - position) > 1e-6)
+		return false;
+
+	if (header.path_size > max_string_size || header.layout_size > max_string_size || header.image_size > max_image_size ||
+		header.width <= 0 || header.height <= 0 || header.format < 0 || header.format > (int32_t)FrameFormat::BGR24)
+		return false;
+
+	// different media with the same hash of path
+	std::string poster_media_path(header.path_size, '\0');
+	if (!file.read(&poster_media_path[0], header.path_size) || poster_media_path != path)
+		return false;
+
+	std::string poster_layout(header.layout_size, '\0');
+	if (!file.read(&poster_layout[0], header.layout_size) || poster_layout != layout)
+		return false;
+
+	return true;
+}
+
+bool PosterCache::Load(const std::string& path, const std::string& layout, double position, Poster& poster)
+{
+	std::string poster_path = GetPosterPath(path);
+	if (poster_path.empty())
+		return false;
+
+	std::ifstream file(poster_path, std::ios::binary);
+	if (!file)
+		return false;
+
+	Header header = {};
+	if (!ReadHeader(file, path, layout, position, header))
+		return false;
+
+	std::vector<uint8_t> image(header.image_size);
+	if (!file.read((char*)image.data(), image.size()))
+		return false;
+
+	poster.width = header.width;
+	poster.height = header.height;
+	poster.format = (FrameFormat)header.format;
+	poster.position = header.position;
+
+	return Decode(image, poster);
+}
+
+bool PosterCache::IsStored(const std::string& path, const std::string& layout, double position)
+{
+	std::string poster_path = GetPosterPath(path);
+	if (poster_path.empty())
+		return false;
+
+	std::ifstream file(poster_path, std::ios::binary);
+	if (!file)
+		return false;
+
+	Header header = {};
+	return ReadHeader(file, path, layout, position, header);
+}
+
+bool PosterCache::Store(const std::string& path, const std::string& layout, const Poster& poster)
+{
+	uint64_t file_size = 0;
+	int64_t modified = 0;
+	if (!ProbeCache::GetFileKey(path, file_size, modified))
+		return false;
+
+	std::string poster_path = GetPosterPath(path);
+	if (poster_path.empty())
+		return false;
+
+	if (path.size() > max_string_size || layout.size() > max_string_size || poster.width <= 0 || poster.height <= 0 ||
+		poster.pixels.size() < (size_t)poster.linesize * poster.height)
+		return false;
+
+	std::vector<uint8_t> image;
+	if (!Encode(poster, image) || image.empty() || image.size() > max_image_size)
+		return false;
+
+	Header header = {};
+	std::memcpy(header.signature, signature, sizeof(signature));
+	header.version = version;
+	header.path_size = (uint32_t)path.size();
+	header.layout_size = (uint32_t)layout.size();
+	header.image_size = (uint32_t)image.size();
+	header.file_size = file_size;
+	header.modified = modified;
+	header.width = (int32_t)poster.width;
+	header.height = (int32_t)poster.height;
+	header.format = (int32_t)poster.format;
+	header.position = poster.position;
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(poster_path).parent_path(), error);
+	if (error)
+		return false;
+
+	// players of the same file write their own temporary file, a reader sees only a complete poster
+	std::string temp_path = poster_path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write((const char*)&header, sizeof(header));
+		file.write(path.data(), path.size());
+		file.write(layout.data(), layout.size());
+		file.write((const char*)image.data(), image.size());
+
+		file.close();
+		if (file.fail()) {
+			std::filesystem::remove(temp_path, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temp_path, poster_path, error);
+	if (error) {
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	return true;
+}
+
+bool PosterCache::Remove(const std::string& path)
+{
+	std::string poster_path = GetPosterPath(path);
+	if (poster_path.empty())
+		return false;
+
+	std::error_code error;
+	return std::filesystem::remove(poster_path, error);
+}
+
+bool PosterCache::Capture(const Frame& frame, double position, Poster& poster)
+{
+	if (!frame.frame_buf || frame.crop_width <= 0 || frame.crop_height <= 0 || frame.x_offset < 0 || frame.y_offset < 0 ||
+		frame.x_offset + frame.crop_width > frame.original_width || frame.y_offset + frame.crop_height > frame.original_height)
+		return false;
+
+	size_t row_size = (size_t)frame.crop_width * frame.bytes_per_pixel;
+
+	poster.width = frame.crop_width;
+	poster.height = frame.crop_height;
+	poster.format = frame.format;
+	poster.linesize = (int)((row_size + FramePool::alignment - 1) / FramePool::alignment * FramePool::alignment);
+	poster.pixels.resize((size_t)poster.linesize * poster.height);
+	poster.position = position;
+
+	const uint8_t* region = frame.frame_buf + (size_t)frame.linesize * frame.y_offset + (size_t)frame.x_offset * frame.bytes_per_pixel;
+	for (long row = 0; row < poster.height; ++row)
+		std::memcpy(poster.pixels.data() + (size_t)poster.linesize * row, region + (size_t)frame.linesize * row, row_size);
+
+	return true;
+}
+
+bool PosterCache::Encode(const Poster& poster, std::vector<uint8_t>& image)
+{
+	const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+	if (!codec)
+		return false;
+
+	AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
+	AVFrame* yuv_frame = av_frame_alloc();
+	AVPacket* packet = av_packet_alloc();
+	SwsContext* sws_ctx = sws_getContext(poster.width, poster.height, GetPixelFormat(poster.format),
+		poster.width, poster.height, AV_PIX_FMT_YUVJ420P, SWS_BICUBIC, NULL, NULL, NULL);
+
+	bool success = false;
+	if (codec_ctx && yuv_frame && packet && sws_ctx) {
+		codec_ctx->width = poster.width;
+		codec_ctx->height = poster.height;
+		codec_ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;
+		codec_ctx->time_base = { 1, 25 };
+
+		// constant quantizer instead of bit rate
+		codec_ctx->flags |= AV_CODEC_FLAG_QSCALE;
+		codec_ctx->global_quality = FF_QP2LAMBDA * quality;
+
+		yuv_frame->format = AV_PIX_FMT_YUVJ420P;
+		yuv_frame->width = poster.width;
+		yuv_frame->height = poster.height;
+		yuv_frame->quality = codec_ctx->global_quality;
+		yuv_frame->pts = 0;
+
+		const uint8_t* src_data[4] = { poster.pixels.data(), NULL, NULL, NULL };
+		int src_linesize[4] = { poster.linesize, 0, 0, 0 };
+
+		if (avcodec_open2(codec_ctx, codec, NULL) == 0 && av_frame_get_buffer(yuv_frame, 0) == 0 &&
+			sws_scale(sws_ctx, src_data, src_linesize, 0, poster.height, yuv_frame->data, yuv_frame->linesize) > 0 &&
+			avcodec_send_frame(codec_ctx, yuv_frame) == 0 && avcodec_receive_packet(codec_ctx, packet) == 0) {
+			image.assign(packet->data, packet->data + packet->size);
+			success = true;
+		}
+	}
+
+	sws_freeContext(sws_ctx);
+	av_packet_free(&packet);
+	av_frame_free(&yuv_frame);
+	avcodec_free_context(&codec_ctx);
+
+	return success;
+}
+
+bool PosterCache::Decode(const std::vector<uint8_t>& image, Poster& poster)
+{
+	const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+	if (!codec)
+		return false;
+
+	AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
+	AVFrame* yuv_frame = av_frame_alloc();
+	AVPacket* packet = av_packet_alloc();
+
+	bool success = false;
+	if (codec_ctx && yuv_frame && packet && avcodec_open2(codec_ctx, codec, NULL) == 0 &&
+		av_new_packet(packet, (int)image.size()) == 0) {
+		std::memcpy(packet->data, image.data(), image.size());
+
+		if (avcodec_send_packet(codec_ctx, packet) == 0 && avcodec_receive_frame(codec_ctx, yuv_frame) == 0 &&
+			yuv_frame->width == poster.width && yuv_frame->height == poster.height) {
+			size_t row_size = (size_t)poster.width * GetBytesPerPixel(poster.format);
+			poster.linesize = (int)((row_size + FramePool::alignment - 1) / FramePool::alignment * FramePool::alignment);
+			poster.pixels.resize((size_t)poster.linesize * poster.height);
+
+			// JPEG is always full range BT.601, the same as swscale wrote it in Encode
+			AVPixelFormat src_format = (AVPixelFormat)yuv_frame->format;
+			success = ColorConverter::Convert(yuv_frame->data, yuv_frame->linesize, src_format, true, AVCOL_SPC_BT470BG,
+				poster.pixels.data(), poster.linesize, GetPixelFormat(poster.format), poster.width, poster.height);
+
+			// image wasn't written by this build, e.g. with another chroma subsampling
+			if (!success) {
+				SwsContext* sws_ctx = sws_getContext(poster.width, poster.height, src_format,
+					poster.width, poster.height, GetPixelFormat(poster.format), SWS_BICUBIC, NULL, NULL, NULL);
+				uint8_t* dst_data[4] = { poster.pixels.data(), NULL, NULL, NULL };
+				int dst_linesize[4] = { poster.linesize, 0, 0, 0 };
+
+				success = sws_ctx && sws_scale(sws_ctx, yuv_frame->data, yuv_frame->linesize, 0, poster.height, dst_data, dst_linesize) > 0;
+				sws_freeContext(sws_ctx);
+			}
+		}
+	}
+
+	av_packet_free(&packet);
+	av_frame_free(&yuv_frame);
+	avcodec_free_context(&codec_ctx);
+
+	return success;
+}
+
+std::string PosterCache::GetPosterPath(const std::string& path)
+{
+	std::string directory = GetDirectory();
+	if (directory.empty())
+		return std::string();
+
+	// FNV-1a of the path, collisions are found by the path stored in poster
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c : path) {
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.poster", (unsigned long long)hash);
+
+	return (std::filesystem::path(directory) / name).string();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Frame.h"
+
+
+// The first frame a player shows for media, kept on disk as a small JPEG of the region drawn on monitor,
+// so the next start draws it at once while media is opened and its first GOP is decoded. Posters are keyed
+// by path, size and modification time of the media file, layout of the player (scaling mode, monitor
+// resolution, frame format) and position the player starts from.
+class PosterCache {
+public:
+	// converted pixels of the drawn region, rows are aligned like frames of the queue
+	struct Poster {
+		long width = 0, height = 0;
+		FrameFormat format = FrameFormat::BGRA;
+		int linesize = 0;
+		std::vector<uint8_t> pixels;
+
+		// where player started in seconds, poster is the first frame shown from it
+		double position = 0.0;
+	};
+
+	PosterCache() = delete;
+
+	// folder of poster files, created by the first Store; empty - posters aren't kept
+	static void SetDirectory(const std::string& directory);
+	static std::string GetDirectory();
+
+	// per-user cache folder: %LOCALAPPDATA% on Windows, $XDG_CACHE_HOME or ~/.cache elsewhere
+	static std::string GetDefaultDirectory();
+
+	// false if there is no poster for the current media file, layout and position
+	static bool Load(const std::string& path, const std::string& layout, double position, Poster& poster);
+
+	// the same check as Load without decoding the image
+	static bool IsStored(const std::string& path, const std::string& layout, double position);
+
+	// JPEG is encoded on the calling thread, it takes tens of milliseconds for 4K
+	static bool Store(const std::string& path, const std::string& layout, const Poster& poster);
+	static bool Remove(const std::string& path);
+
+	// copy of the region of frame drawn on monitor (crop params of frame), false if it is outside of frame
+	static bool Capture(const Frame& frame, double position, Poster& poster);
+
+private:
+	// on-disk structures: header | path | layout | JPEG image
+	struct Header {
+		char signature[8];
+		uint32_t version;
+		uint32_t path_size;
+		uint32_t layout_size;
+		uint32_t image_size;
+		uint64_t file_size;
+		int64_t modified;
+		int32_t width, height;
+		int32_t format;
+		int32_t reserved;
+		double position;
+	};
+
+	static const char signature[8];
+	static const uint32_t version = 1;
+
+	// sanity limits of a poster file
+	static const uint32_t max_string_size = 64 * 1024;
+	static const uint32_t max_image_size = 64 * 1024 * 1024;
+
+	// quantizer of JPEG, 2 is visually lossless
+	static const int quality = 2;
+
+	// header of valid poster, file is left positioned after the layout
+	static bool ReadHeader(std::istream& file, const std::string& path, const std::string& layout, double position, Header& header);
+
+	static bool Encode(const Poster& poster, std::vector<uint8_t>& image);
+	static bool Decode(const std::vector<uint8_t>& image, Poster& poster);
+
+	// poster file named by hash of media path
+	static std::string GetPosterPath(const std::string& path);
+
+	static std::mutex cache_lock;
+	static std::string cache_directory;
+};
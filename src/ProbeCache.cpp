@@ -0,0 +1,413 @@
+#include "ProbeCache.h"
+#include "MediaInput.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/mem.h>
+}
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+
+const char ProbeCache::signature[8] = { 'D', 'W', 'P', 'R', 'O', 'B', 'E', '\0' };
+
+std::mutex ProbeCache::cache_lock;
+std::string ProbeCache::cache_directory = ProbeCache::GetDefaultDirectory();
+
+void ProbeCache::SetDirectory(const std::string& directory)
+{
+	std::lock_guard<std::mutex> locker(cache_lock);
+
+	cache_directory = directory;
+}
+
+std::string ProbeCache::GetDirectory()
+{
+	std::lock_guard<std::mutex> locker(cache_lock);
+
+	return cache_directory;
+}
+
+std::string ProbeCache::GetDefaultDirectory()
+{
+	std::filesystem::path directory;
+
+#ifdef _WIN32
+	char local_app_data[MAX_PATH];
+	DWORD size = GetEnvironmentVariableA("LOCALAPPDATA", local_app_data, MAX_PATH);
+	if (size > 0 && size < MAX_PATH)
+		directory = std::filesystem::path(local_app_data) / "DynamicWallpaper" / "ProbeCache";
+#else
+	const char* cache_home = std::getenv("XDG_CACHE_HOME");
+	const char* home = std::getenv("HOME");
+	if (cache_home && *cache_home)
+		directory = std::filesystem::path(cache_home) / "dynamic-wallpaper" / "probe";
+	else if (home && *home)
+		directory = std::filesystem::path(home) / ".cache" / "dynamic-wallpaper" / "probe";
+#endif
+
+	// next to the working folder if there is no user profile
+	if (directory.empty())
+		directory = "probe_cache";
+
+	return directory.string();
+}
+
+bool ProbeCache::Load(const std::string& path, Entry& entry)
+{
+	uint64_t file_size = 0;
+	int64_t modified = 0;
+	if (!GetFileKey(path, file_size, modified))
+		return false;
+
+	std::string entry_path = GetEntryPath(path);
+	if (entry_path.empty())
+		return false;
+
+	std::ifstream file(entry_path, std::ios::binary);
+	if (!file)
+		return false;
+
+	Header header = {};
+	if (!file.read((char*)&header, sizeof(header)))
+		return false;
+
+	if (std::memcmp(header.signature, signature, sizeof(signature)) != 0 || header.version != version ||
+		header.format_version != LIBAVFORMAT_VERSION_INT || header.codec_version != LIBAVCODEC_VERSION_INT)
+		return false;
+
+	// media file was changed since it was probed
+	if (header.file_size != file_size || header.modified != modified)
+		return false;
+
+	if (header.path_size > max_string_size || header.format_name_size > max_string_size ||
+		header.extradata_size > max_extradata_size || header.keyframes_count > max_keyframes_count)
+		return false;
+
+	// different media with the same hash of path
+	std::string entry_media_path(header.path_size, '\0');
+	if (!file.read(&entry_media_path[0], header.path_size) || entry_media_path != path)
+		return false;
+
+	entry.format_name.assign(header.format_name_size, '\0');
+	entry.extradata.resize(header.extradata_size);
+	entry.keyframes.resize(header.keyframes_count);
+
+	if (!file.read(&entry.format_name[0], header.format_name_size) ||
+		!file.read((char*)entry.extradata.data(), entry.extradata.size()) ||
+		!file.read((char*)entry.keyframes.data(), entry.keyframes.size() * sizeof(Keyframe)))
+		return false;
+
+	entry.keyframes_complete = header.keyframes_complete != 0;
+	entry.streams_count = header.streams_count;
+	entry.video_stream = header.video_stream;
+	entry.codec_id = header.codec_id;
+	entry.codec_tag = header.codec_tag;
+	entry.pixel_format = header.pixel_format;
+	entry.width = header.width;
+	entry.height = header.height;
+	entry.profile = header.profile;
+	entry.level = header.level;
+	entry.bit_rate = header.bit_rate;
+	entry.sample_aspect_ratio = { header.sar_num, header.sar_den };
+	entry.field_order = header.field_order;
+	entry.color_range = header.color_range;
+	entry.color_primaries = header.color_primaries;
+	entry.color_trc = header.color_trc;
+	entry.color_space = header.color_space;
+	entry.chroma_location = header.chroma_location;
+	entry.video_delay = header.video_delay;
+	entry.time_base = { header.time_base_num, header.time_base_den };
+	entry.r_frame_rate = { header.r_frame_rate_num, header.r_frame_rate_den };
+	entry.avg_frame_rate = { header.avg_frame_rate_num, header.avg_frame_rate_den };
+	entry.start_time = header.start_time;
+	entry.duration = header.duration;
+	entry.frames_count = header.frames_count;
+	entry.format_start_time = header.format_start_time;
+	entry.format_duration = header.format_duration;
+
+	return true;
+}
+
+bool ProbeCache::Store(const std::string& path, const Entry& entry)
+{
+	uint64_t file_size = 0;
+	int64_t modified = 0;
+	if (!GetFileKey(path, file_size, modified))
+		return false;
+
+	std::string entry_path = GetEntryPath(path);
+	if (entry_path.empty())
+		return false;
+
+	if (path.size() > max_string_size || entry.format_name.size() > max_string_size ||
+		entry.extradata.size() > max_extradata_size || entry.keyframes.size() > max_keyframes_count)
+		return false;
+
+	Header header = {};
+	std::memcpy(header.signature, signature, sizeof(signature));
+	header.version = version;
+	header.format_version = LIBAVFORMAT_VERSION_INT;
+	header.codec_version = LIBAVCODEC_VERSION_INT;
+	header.file_size = file_size;
+	header.modified = modified;
+	header.path_size = (uint32_t)path.size();
+	header.format_name_size = (uint32_t)entry.format_name.size();
+	header.extradata_size = (uint32_t)entry.extradata.size();
+	header.keyframes_count = (uint32_t)entry.keyframes.size();
+	header.keyframes_complete = entry.keyframes_complete ? 1 : 0;
+	header.streams_count = entry.streams_count;
+	header.video_stream = entry.video_stream;
+	header.codec_id = entry.codec_id;
+	header.codec_tag = entry.codec_tag;
+	header.pixel_format = entry.pixel_format;
+	header.width = entry.width;
+	header.height = entry.height;
+	header.profile = entry.profile;
+	header.level = entry.level;
+	header.sar_num = entry.sample_aspect_ratio.num;
+	header.sar_den = entry.sample_aspect_ratio.den;
+	header.field_order = entry.field_order;
+	header.color_range = entry.color_range;
+	header.color_primaries = entry.color_primaries;
+	header.color_trc = entry.color_trc;
+	header.color_space = entry.color_space;
+	header.chroma_location = entry.chroma_location;
+	header.video_delay = entry.video_delay;
+	header.time_base_num = entry.time_base.num;
+	header.time_base_den = entry.time_base.den;
+	header.r_frame_rate_num = entry.r_frame_rate.num;
+	header.r_frame_rate_den = entry.r_frame_rate.den;
+	header.avg_frame_rate_num = entry.avg_frame_rate.num;
+	header.avg_frame_rate_den = entry.avg_frame_rate.den;
+	header.bit_rate = entry.bit_rate;
+	header.start_time = entry.start_time;
+	header.duration = entry.duration;
+	header.frames_count = entry.frames_count;
+	header.format_start_time = entry.format_start_time;
+	header.format_duration = entry.format_duration;
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(entry_path).parent_path(), error);
+	if (error)
+		return false;
+
+	// players opening the same file write their own temporary file, a reader sees only a complete entry
+	std::string temp_path = entry_path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write((const char*)&header, sizeof(header));
+		file.write(path.data(), path.size());
+		file.write(entry.format_name.data(), entry.format_name.size());
+		file.write((const char*)entry.extradata.data(), entry.extradata.size());
+		file.write((const char*)entry.keyframes.data(), entry.keyframes.size() * sizeof(Keyframe));
+
+		file.close();
+		if (file.fail()) {
+			std::filesystem::remove(temp_path, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temp_path, entry_path, error);
+	if (error) {
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	return true;
+}
+
+bool ProbeCache::Remove(const std::string& path)
+{
+	std::string entry_path = GetEntryPath(path);
+	if (entry_path.empty())
+		return false;
+
+	std::error_code error;
+	return std::filesystem::remove(entry_path, error);
+}
+
+bool ProbeCache::Capture(AVFormatContext* media_ctx, int video_stream, Entry& entry)
+{
+	if (!media_ctx || !media_ctx->iformat || video_stream < 0 || (unsigned int)video_stream >= media_ctx->nb_streams)
+		return false;
+
+	// streams of e.g. MPEG-TS are found only while packets are read
+	if (media_ctx->ctx_flags & AVFMTCTX_NOHEADER)
+		return false;
+
+	AVStream* stream = media_ctx->streams[video_stream];
+	AVCodecParameters* params = stream->codecpar;
+
+	// the first of format's names, e.g. "matroska" of "matroska,webm"
+	entry.format_name = media_ctx->iformat->name;
+	entry.format_name = entry.format_name.substr(0, entry.format_name.find(','));
+
+	entry.streams_count = media_ctx->nb_streams;
+	entry.video_stream = video_stream;
+
+	entry.codec_id = params->codec_id;
+	entry.codec_tag = params->codec_tag;
+	entry.pixel_format = params->format;
+	entry.width = params->width;
+	entry.height = params->height;
+	entry.profile = params->profile;
+	entry.level = params->level;
+	entry.bit_rate = params->bit_rate;
+	entry.sample_aspect_ratio = params->sample_aspect_ratio;
+	entry.field_order = params->field_order;
+	entry.color_range = params->color_range;
+	entry.color_primaries = params->color_primaries;
+	entry.color_trc = params->color_trc;
+	entry.color_space = params->color_space;
+	entry.chroma_location = params->chroma_location;
+	entry.video_delay = params->video_delay;
+	entry.extradata.assign(params->extradata, params->extradata + (params->extradata ? params->extradata_size : 0));
+
+	entry.time_base = stream->time_base;
+	entry.r_frame_rate = stream->r_frame_rate;
+	entry.avg_frame_rate = stream->avg_frame_rate;
+	entry.start_time = stream->start_time;
+	entry.duration = stream->duration;
+	entry.frames_count = stream->nb_frames;
+	entry.format_start_time = media_ctx->start_time;
+	entry.format_duration = media_ctx->duration;
+
+	KeyframeIndex index;
+	index.AddStreamIndex(stream);
+	entry.keyframes = index.GetKeyframes();
+
+	return true;
+}
+
+bool ProbeCache::Apply(const Entry& entry, AVFormatContext* media_ctx)
+{
+	if (!media_ctx || media_ctx->nb_streams != entry.streams_count || entry.video_stream < 0 ||
+		(unsigned int)entry.video_stream >= media_ctx->nb_streams)
+		return false;
+
+	AVStream* stream = media_ctx->streams[entry.video_stream];
+	AVCodecParameters* params = stream->codecpar;
+
+	// header must declare the same video stream, probing only completes it
+	if (params->codec_type != AVMEDIA_TYPE_VIDEO || params->codec_id != entry.codec_id ||
+		stream->time_base.num != entry.time_base.num || stream->time_base.den != entry.time_base.den)
+		return false;
+
+	if ((params->width > 0 && params->width != entry.width) || (params->height > 0 && params->height != entry.height))
+		return false;
+
+	// the first video stream is chosen by player, so the earlier ones must not be video either
+	for (int i = 0; i < entry.video_stream; ++i) {
+		if (media_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+			return false;
+	}
+
+	if (entry.width <= 0 || entry.height <= 0 || entry.pixel_format < 0)
+		return false;
+
+	// extradata of the header is the same, it is added only if the header doesn't have it
+	if (params->extradata_size == 0 && !entry.extradata.empty()) {
+		uint8_t* extradata = (uint8_t*)av_mallocz(entry.extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+		if (!extradata)
+			return false;
+
+		std::memcpy(extradata, entry.extradata.data(), entry.extradata.size());
+
+		av_freep(&params->extradata);
+		params->extradata = extradata;
+		params->extradata_size = (int)entry.extradata.size();
+	}
+
+	params->codec_tag = entry.codec_tag;
+	params->format = entry.pixel_format;
+	params->width = entry.width;
+	params->height = entry.height;
+	params->profile = entry.profile;
+	params->level = entry.level;
+	params->bit_rate = entry.bit_rate;
+	params->sample_aspect_ratio = entry.sample_aspect_ratio;
+	params->field_order = (AVFieldOrder)entry.field_order;
+	params->color_range = (AVColorRange)entry.color_range;
+	params->color_primaries = (AVColorPrimaries)entry.color_primaries;
+	params->color_trc = (AVColorTransferCharacteristic)entry.color_trc;
+	params->color_space = (AVColorSpace)entry.color_space;
+	params->chroma_location = (AVChromaLocation)entry.chroma_location;
+	params->video_delay = entry.video_delay;
+
+	stream->r_frame_rate = entry.r_frame_rate;
+	stream->avg_frame_rate = entry.avg_frame_rate;
+
+	// values estimated by probing, the ones read from header are kept
+	if (stream->start_time == AV_NOPTS_VALUE)
+		stream->start_time = entry.start_time;
+	if (stream->duration == AV_NOPTS_VALUE)
+		stream->duration = entry.duration;
+	if (stream->nb_frames == 0)
+		stream->nb_frames = entry.frames_count;
+	if (media_ctx->start_time == AV_NOPTS_VALUE)
+		media_ctx->start_time = entry.format_start_time;
+	if (media_ctx->duration == AV_NOPTS_VALUE)
+		media_ctx->duration = entry.format_duration;
+
+	// seeking doesn't have to read MKV cues or search the file if index isn't in the header
+	if (KeyframeIndex::GetStreamIndexSize(stream) == 0)
+		KeyframeIndex::FillStreamIndex(stream, entry.keyframes);
+
+	return true;
+}
+
+bool ProbeCache::GetFileKey(const std::string& path, uint64_t& file_size, int64_t& modified)
+{
+	if (!MediaInput::IsLocalFile(path))
+		return false;
+
+	std::error_code error;
+	std::filesystem::path file_path(path);
+
+	file_size = std::filesystem::file_size(file_path, error);
+	if (error)
+		return false;
+
+	auto write_time = std::filesystem::last_write_time(file_path, error);
+	if (error)
+		return false;
+
+	modified = (int64_t)write_time.time_since_epoch().count();
+
+	return true;
+}
+
+std::string ProbeCache::GetEntryPath(const std::string& path)
+{
+	std::string directory = GetDirectory();
+	if (directory.empty())
+		return std::string();
+
+	// FNV-1a of the path, collisions are found by the path stored in entry
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c : path) {
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.probe", (unsigned long long)hash);
+
+	return (std::filesystem::path(directory) / name).string();
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "KeyframeIndex.h"
+
+
+// Stream layout of probed media files kept on disk, one small file per media. avformat_find_stream_info
+// reads and decodes the beginning of the media (megabytes of big MKV/WebM files), with a cached entry
+// only the container header is read: input format isn't probed and video stream params are taken
+// from the entry. Entries are keyed by path, size and modification time of the media file.
+class ProbeCache {
+public:
+	typedef KeyframeIndex::Keyframe Keyframe;
+
+	// everything what probing adds to the header of a media file
+	struct Entry {
+		std::string format_name;
+		uint32_t streams_count = 0;
+		int32_t video_stream = -1;
+
+		// codec params of video stream
+		int32_t codec_id = 0;
+		uint32_t codec_tag = 0;
+		int32_t pixel_format = -1;
+		int32_t width = 0, height = 0;
+		int32_t profile = 0, level = 0;
+		int64_t bit_rate = 0;
+		AVRational sample_aspect_ratio = { 0, 1 };
+		int32_t field_order = 0;
+		int32_t color_range = 0, color_primaries = 0, color_trc = 0, color_space = 0;
+		int32_t chroma_location = 0;
+		int32_t video_delay = 0;
+		std::vector<uint8_t> extradata;
+
+		// timing of video stream and container
+		AVRational time_base = { 0, 1 };
+		AVRational r_frame_rate = { 0, 1 }, avg_frame_rate = { 0, 1 };
+		int64_t start_time = 0, duration = 0, frames_count = 0;
+		int64_t format_start_time = 0, format_duration = 0;
+
+		// keyframes of container's index, every keyframe of the stream once it was read to the end
+		std::vector<Keyframe> keyframes;
+		bool keyframes_complete = false;
+	};
+
+	ProbeCache() = delete;
+
+	// folder of cache files, created by the first Store; empty - cache is disabled
+	static void SetDirectory(const std::string& directory);
+	static std::string GetDirectory();
+
+	// per-user cache folder: %LOCALAPPDATA% on Windows, $XDG_CACHE_HOME or ~/.cache elsewhere
+	static std::string GetDefaultDirectory();
+
+	// false if there is no entry for the current size and modification time of the file
+	static bool Load(const std::string& path, Entry& entry);
+	static bool Store(const std::string& path, const Entry& entry);
+	static bool Remove(const std::string& path);
+
+	// entry from media probed by avformat_find_stream_info, false if media can't be opened
+	// without probing (streams aren't declared in its header)
+	static bool Capture(AVFormatContext* media_ctx, int video_stream, Entry& entry);
+
+	// fill media opened by avformat_open_input with probed params, nothing is changed and false
+	// is returned if its header doesn't have the same streams
+	static bool Apply(const Entry& entry, AVFormatContext* media_ctx);
+
+	// size and modification time of media file, false if it isn't a local file
+	static bool GetFileKey(const std::string& path, uint64_t& file_size, int64_t& modified);
+
+private:
+	// on-disk structures: header | path | format name | extradata | keyframes
+	struct Header {
+		char signature[8];
+		uint32_t version;
+		uint32_t format_version;	// codec ids and enums must be the same as in this build
+		uint32_t codec_version;
+		uint64_t file_size;
+		int64_t modified;
+		uint32_t path_size;
+		uint32_t format_name_size;
+		uint32_t extradata_size;
+		uint32_t keyframes_count;
+		uint32_t keyframes_complete;
+		uint32_t streams_count;
+		int32_t video_stream;
+		int32_t codec_id;
+		uint32_t codec_tag;
+		int32_t pixel_format;
+		int32_t width, height;
+		int32_t profile, level;
+		int32_t sar_num, sar_den;
+		int32_t field_order;
+		int32_t color_range, color_primaries, color_trc, color_space;
+		int32_t chroma_location;
+		int32_t video_delay;
+		int32_t time_base_num, time_base_den;
+		int32_t r_frame_rate_num, r_frame_rate_den;
+		int32_t avg_frame_rate_num, avg_frame_rate_den;
+		int64_t bit_rate;
+		int64_t start_time, duration, frames_count;
+		int64_t format_start_time, format_duration;
+	};
+
+	static const char signature[8];
+	static const uint32_t version = 2;
+
+	// sanity limits of a cache file
+	static const uint32_t max_string_size = 64 * 1024;
+	static const uint32_t max_extradata_size = 16 * 1024 * 1024;
+	static const uint32_t max_keyframes_count = 16 * 1024 * 1024;
+
+	// cache file named by hash of media path
+	static std::string GetEntryPath(const std::string& path);
+
+	static std::mutex cache_lock;
+	static std::string cache_directory;
+};
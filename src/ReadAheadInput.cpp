@@ -0,0 +1,163 @@
+#include "ReadAheadInput.h"
+
+extern "C"
+{
+#include <libavutil/mem.h>
+}
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+// buffer of AVIOContext, FFmpeg reads packets through it
+static const size_t context_buffer_size = 64 * 1024;
+static const size_t page_size = 4096;
+
+
+ReadAheadInput::~ReadAheadInput()
+{
+	Close();
+}
+
+bool ReadAheadInput::Open(const std::string& path, size_t block_size, size_t blocks)
+{
+	Close();
+
+	if (block_size == 0 || blocks == 0)
+		return false;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	file_handle = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+		Close();
+		return false;
+	}
+
+	file_size = (uint64_t)size.QuadPart;
+#else
+	file_descriptor = open(path.c_str(), O_RDONLY);
+	if (file_descriptor < 0)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(file_descriptor, &file_stat) != 0 || file_stat.st_size <= 0) {
+		Close();
+		return false;
+	}
+
+	file_size = (uint64_t)file_stat.st_size;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(file_descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#endif
+
+	this->block_size = (block_size + page_size - 1) / page_size * page_size;
+
+	window_capacity = this->block_size * blocks;
+	window = (uint8_t*)av_malloc(window_capacity);
+	if (!window || !CreateContext(context_buffer_size)) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+int ReadAheadInput::Read(uint8_t* buffer, int size)
+{
+	if (position < window_start || position >= window_start + window_size) {
+		if (!FillWindow(position))
+			return AVERROR(EIO);
+
+		if (window_size == 0)
+			return AVERROR_EOF;
+	}
+
+	size_t available = (size_t)(window_start + window_size - position);
+	size_t copied = std::min((size_t)size, available);
+	std::memcpy(buffer, window + (position - window_start), copied);
+
+	return (int)copied;
+}
+
+bool ReadAheadInput::Seek(uint64_t new_position)
+{
+	// window is read again only when position leaves it
+	return new_position <= file_size;
+}
+
+void ReadAheadInput::Close()
+{
+	if (window)
+		av_freep(&window);
+	window_capacity = 0;
+	window_start = 0;
+	window_size = 0;
+
+#ifdef _WIN32
+	if (file_handle)
+		CloseHandle(file_handle);
+	file_handle = nullptr;
+#else
+	if (file_descriptor >= 0)
+		close(file_descriptor);
+	file_descriptor = -1;
+#endif
+}
+
+bool ReadAheadInput::FillWindow(uint64_t offset)
+{
+	window_start = offset - offset % block_size;
+	window_size = 0;
+
+	if (window_start >= file_size)
+		return true;
+
+	size_t size = (size_t)std::min<uint64_t>(window_capacity, file_size - window_start);
+
+	// one read from OS for the whole window, it can be shorter only at the end of file
+	while (window_size < size) {
+#ifdef _WIN32
+		uint64_t read_offset = window_start + window_size;
+
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = (DWORD)read_offset;
+		overlapped.OffsetHigh = (DWORD)(read_offset >> 32);
+
+		DWORD read = 0;
+		if (!ReadFile(file_handle, window + window_size, (DWORD)(size - window_size), &read, &overlapped))
+			return false;
+#else
+		ssize_t read = pread(file_descriptor, window + window_size, size - window_size, (off_t)(window_start + window_size));
+		if (read < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+#endif
+		++read_calls;
+
+		if (read == 0)
+			break;
+
+		window_size += (size_t)read;
+		bytes_read += (uint64_t)read;
+	}
+
+	return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "MediaInput.h"
+
+
+// Local file read in big blocks: every read from OS fills the whole window of several blocks,
+// which starts at block boundary. Demuxer's small reads and skips over discarded packets are
+// served from the window, so there are few syscalls and they are friendly to disk read-ahead.
+class ReadAheadInput : public MediaInput {
+public:
+	ReadAheadInput() = default;
+
+	~ReadAheadInput() override;
+
+	// block size is rounded up to 4 KB pages
+	bool Open(const std::string& path, size_t block_size, size_t blocks);
+
+protected:
+	int Read(uint8_t* buffer, int size) override;
+	bool Seek(uint64_t new_position) override;
+
+private:
+	void Close();
+
+	// window with the block of offset, window_size is 0 after the end of file
+	bool FillWindow(uint64_t offset);
+
+#ifdef _WIN32
+	void* file_handle = nullptr;
+#else
+	int file_descriptor = -1;
+#endif
+
+	size_t block_size = 0;
+
+	uint8_t* window = nullptr;
+	size_t window_capacity = 0;
+	uint64_t window_start = 0;
+	size_t window_size = 0;
+};
@@ -0,0 +1,51 @@
+#include "SystemLoad.h"
+
+
+SystemLoadSource::SystemLoadSource(std::chrono::steady_clock::duration sample_period) :
+	sample_period(sample_period), last_sample(std::chrono::steady_clock::now())
+{
+	ReadTimes(last_idle, last_total);
+}
+
+double SystemLoadSource::GetCpuLoad()
+{
+	std::lock_guard<std::mutex> locker(sample_lock);
+
+	// callers within the period share the last sample
+	auto now = std::chrono::steady_clock::now();
+	if (now - last_sample < sample_period)
+		return last_load;
+
+	uint64_t idle = 0, total = 0;
+	if (!ReadTimes(idle, total))
+		return last_load;
+
+	uint64_t idle_delta = idle - last_idle;
+	uint64_t total_delta = total - last_total;
+	if (total_delta == 0)
+		return last_load;
+
+	last_idle = idle;
+	last_total = total;
+	last_sample = now;
+	last_load = 1.0 - (double)idle_delta / total_delta;
+
+	return last_load;
+}
+
+bool SystemLoadSource::ReadTimes(uint64_t& idle, uint64_t& total)
+{
+	FILETIME idle_time, kernel_time, user_time;
+	if (!GetSystemTimes(&idle_time, &kernel_time, &user_time))
+		return false;
+
+	auto to_uint64 = [](const FILETIME& time) {
+		return ((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime;
+	};
+
+	// kernel time includes idle time
+	idle = to_uint64(idle_time);
+	total = to_uint64(kernel_time) + to_uint64(user_time);
+
+	return true;
+}
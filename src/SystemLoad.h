@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Windows.h"
+
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+#include "PlaybackPolicy.h"
+
+
+// CPU load of the whole system from GetSystemTimes. One source is shared by policies of all players,
+// so load is sampled once per sample period and every caller gets the same value, not load since its own call.
+class SystemLoadSource : public LoadSource {
+public:
+	SystemLoadSource(std::chrono::steady_clock::duration sample_period = std::chrono::milliseconds(500));
+
+	// unknown until the first period has passed
+	double GetCpuLoad() override;
+
+private:
+	std::mutex sample_lock;
+	std::chrono::steady_clock::duration sample_period;
+
+	// times of the last sample in 100 ns units
+	uint64_t last_idle = 0, last_total = 0;
+	std::chrono::steady_clock::time_point last_sample;
+	double last_load = -1.0;
+
+	bool ReadTimes(uint64_t& idle, uint64_t& total);
+};
@@ -0,0 +1,205 @@
+#include "TileDiff.h"
+
+#include <cstring>
+#include <algorithm>
+
+
+// primes of xxHash64, multiplication by odd constant is reversible
+static const uint64_t hash_prime_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t hash_prime_2 = 0xC2B2AE3D27D4EB4FULL;
+
+static inline uint64_t Load64(const uint8_t* data)
+{
+	uint64_t value;
+	std::memcpy(&value, data, sizeof(value));
+
+	return value;
+}
+
+static inline uint64_t Rotate(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// round of xxHash64: multiplication moves changes only to higher bits, rotation brings them back
+// to lower ones, so changes of high bits in several words of the lane don't cancel each other
+static inline uint64_t HashRound(uint64_t lane, uint64_t input)
+{
+	lane += input * hash_prime_2;
+	lane = Rotate(lane, 31);
+
+	return lane * hash_prime_1;
+}
+
+// 4 independent lanes, so several multiplications are in flight
+static inline void HashSegment(const uint8_t* data, size_t size, uint64_t lane[4])
+{
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		lane[0] = HashRound(lane[0], Load64(data + i));
+		lane[1] = HashRound(lane[1], Load64(data + i + 8));
+		lane[2] = HashRound(lane[2], Load64(data + i + 16));
+		lane[3] = HashRound(lane[3], Load64(data + i + 24));
+	}
+
+	for (; i + 8 <= size; i += 8)
+		lane[0] = HashRound(lane[0], Load64(data + i));
+
+	for (; i < size; ++i)
+		lane[1] = HashRound(lane[1], data[i]);
+}
+
+static inline uint64_t FinalizeHash(const uint64_t lane[4])
+{
+	uint64_t hash = lane[0];
+	hash = (hash ^ Rotate(lane[1], 21)) * hash_prime_1;
+	hash = (hash ^ Rotate(lane[2], 42)) * hash_prime_1;
+	hash = (hash ^ lane[3]) * hash_prime_1;
+
+	return hash ^ (hash >> 29);
+}
+
+void TileDiff::Reset(long width, long height, int bytes_per_pixel)
+{
+	this->width = width > 0 ? width : 0;
+	this->height = height > 0 ? height : 0;
+	this->bytes_per_pixel = bytes_per_pixel;
+
+	tiles_x = (this->width + tile_size - 1) / tile_size;
+	tiles_y = (this->height + tile_size - 1) / tile_size;
+
+	hashes.assign((size_t)tiles_x * tiles_y, 0);
+	dirty.assign((size_t)tiles_x * tiles_y, 1);
+	lanes.assign((size_t)tiles_x * 4, 0);
+	dirty_rects.clear();
+	dirty_count = 0;
+
+	is_valid = false;
+}
+
+bool TileDiff::IsSameGeometry(long width, long height, int bytes_per_pixel)
+{
+	return this->width == width && this->height == height && this->bytes_per_pixel == bytes_per_pixel;
+}
+
+void TileDiff::Invalidate()
+{
+	is_valid = false;
+}
+
+size_t TileDiff::Update(const uint8_t* pixels, int stride)
+{
+	dirty_count = 0;
+	dirty_rects.clear();
+
+	if (!pixels || tiles_x == 0 || tiles_y == 0)
+		return 0;
+
+	for (long ty = 0; ty < tiles_y; ++ty) {
+		for (long tx = 0; tx < tiles_x; ++tx) {
+			for (int k = 0; k < 4; ++k)
+				lanes[tx * 4 + k] = k + 1;
+		}
+
+		// rows are read sequentially, every tile of the row has its own hash lanes
+		long y_end = std::min(height, (ty + 1) * tile_size);
+		for (long y = ty * tile_size; y < y_end; ++y) {
+			const uint8_t* row = pixels + (size_t)stride * y;
+
+			for (long tx = 0; tx < tiles_x; ++tx) {
+				long x = tx * tile_size;
+				long tile_width = std::min(tile_size, width - x);
+
+				HashSegment(row + (size_t)x * bytes_per_pixel, (size_t)tile_width * bytes_per_pixel, &lanes[tx * 4]);
+			}
+		}
+
+		for (long tx = 0; tx < tiles_x; ++tx) {
+			size_t index = (size_t)ty * tiles_x + tx;
+			uint64_t hash = FinalizeHash(&lanes[tx * 4]);
+
+			bool is_dirty = !is_valid || hashes[index] != hash;
+			hashes[index] = hash;
+			dirty[index] = is_dirty;
+			dirty_count += is_dirty;
+		}
+	}
+
+	is_valid = true;
+
+	BuildDirtyRects();
+
+	return dirty_count;
+}
+
+const std::vector<TileDiff::Rect>& TileDiff::GetDirtyRects()
+{
+	return dirty_rects;
+}
+
+void TileDiff::CopyDirty(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride)
+{
+	for (auto& rect : dirty_rects) {
+		size_t offset = (size_t)rect.x * bytes_per_pixel;
+		size_t row_size = (size_t)rect.width * bytes_per_pixel;
+
+		for (long y = rect.y; y < rect.y + rect.height; ++y)
+			std::memcpy(dst + (size_t)dst_stride * y + offset, src + (size_t)src_stride * y + offset, row_size);
+	}
+}
+
+size_t TileDiff::GetTilesCount()
+{
+	return hashes.size();
+}
+
+size_t TileDiff::GetDirtyCount()
+{
+	return dirty_count;
+}
+
+double TileDiff::GetDirtyRatio()
+{
+	return hashes.empty() ? 0.0 : (double)dirty_count / hashes.size();
+}
+
+void TileDiff::BuildDirtyRects()
+{
+	// the whole frame is one rectangle
+	if (dirty_count == hashes.size() && dirty_count > 0) {
+		dirty_rects.push_back({ 0, 0, width, height });
+		return;
+	}
+
+	for (long ty = 0; ty < tiles_y; ++ty) {
+		size_t row_begin = dirty_rects.size();
+
+		for (long tx = 0; tx < tiles_x; ++tx) {
+			if (!dirty[(size_t)ty * tiles_x + tx])
+				continue;
+
+			// run of dirty tiles in this row
+			long run_begin = tx;
+			while (tx + 1 < tiles_x && dirty[(size_t)ty * tiles_x + tx + 1])
+				++tx;
+
+			long x = run_begin * tile_size;
+			long y = ty * tile_size;
+			Rect run = { x, y, std::min(width, (tx + 1) * tile_size) - x, std::min(height, y + tile_size) - y };
+
+			// extend the same run which ends at this row down
+			bool is_merged = false;
+			for (size_t i = 0; i < row_begin; ++i) {
+				Rect& rect = dirty_rects[i];
+				if (rect.x == run.x && rect.width == run.width && rect.y + rect.height == run.y) {
+					rect.height += run.height;
+					is_merged = true;
+					break;
+				}
+			}
+
+			if (!is_merged)
+				dirty_rects.push_back(run);
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+
+// Finds changed tiles between consecutive frames by hashes of their pixels,
+// so only dirty tiles have to be copied and presented. Frames are read only once
+// and previous frame doesn't have to be kept.
+class TileDiff {
+public:
+	struct Rect {
+		long x, y, width, height;
+	};
+
+	// tile is tile_size x tile_size pixels
+	static const long tile_size = 64;
+
+	TileDiff() = default;
+
+	// frame geometry, all tiles are dirty after reset
+	void Reset(long width, long height, int bytes_per_pixel);
+	bool IsSameGeometry(long width, long height, int bytes_per_pixel);
+
+	// the next frame will be fully dirty
+	void Invalidate();
+
+	// compare frame with the previous one, returns count of dirty tiles
+	size_t Update(const uint8_t* pixels, int stride);
+
+	// dirty tiles of the last update merged into rectangles, in pixels
+	const std::vector<Rect>& GetDirtyRects();
+
+	// copy only dirty tiles
+	void CopyDirty(const uint8_t* src, int src_stride, uint8_t* dst, int dst_stride);
+
+	size_t GetTilesCount();
+	size_t GetDirtyCount();
+	double GetDirtyRatio();
+
+private:
+	long width = 0, height = 0;
+	int bytes_per_pixel = 0;
+	long tiles_x = 0, tiles_y = 0;
+
+	// hashes of the previous frame
+	std::vector<uint64_t> hashes;
+	std::vector<uint8_t> dirty;
+	size_t dirty_count = 0;
+	bool is_valid = false;
+
+	std::vector<Rect> dirty_rects;
+	void BuildDirtyRects();
+
+	// hash lanes of one row of tiles
+	std::vector<uint64_t> lanes;
+};
@@ -0,0 +1,243 @@
+#include "Tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace {
+
+	// ~1.3 MB per thread, about a minute and a half of a player at 60 fps
+	const uint64_t ring_size = 1 << 15;
+
+	// seqlock: sequence is 0 while event is written, then its index + 1
+	struct TraceEvent {
+		std::atomic<uint64_t> sequence{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> begin_ns{ 0 };
+		std::atomic<uint64_t> end_ns{ 0 };
+		std::atomic<uint32_t> thread_id{ 0 };
+	};
+
+	struct ThreadBuffer {
+		std::unique_ptr<TraceEvent[]> events{ new TraceEvent[ring_size] };
+		std::atomic<uint64_t> written{ 0 };
+		bool in_use = false;
+	};
+
+	struct Registry {
+		std::mutex lock;
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+		std::map<uint32_t, std::string> thread_names;
+		std::atomic<uint32_t> next_thread_id{ 1 };
+		std::atomic<uint64_t> start_ns{ 0 };
+	};
+
+	Registry& GetRegistry()
+	{
+		// never destroyed, threads can record events during exit
+		static Registry* registry = new Registry();
+		return *registry;
+	}
+
+	// buffer of a finished thread is given to the next new thread, its events are kept
+	struct ThreadState {
+		uint32_t thread_id = GetRegistry().next_thread_id.fetch_add(1, std::memory_order_relaxed);
+		ThreadBuffer* buffer = nullptr;
+
+		~ThreadState()
+		{
+			if (!buffer)
+				return;
+
+			std::lock_guard<std::mutex> guard(GetRegistry().lock);
+			buffer->in_use = false;
+		}
+
+		ThreadBuffer* GetBuffer()
+		{
+			if (buffer)
+				return buffer;
+
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> guard(registry.lock);
+
+			for (auto& free_buffer : registry.buffers) {
+				if (!free_buffer->in_use) {
+					buffer = free_buffer.get();
+					break;
+				}
+			}
+
+			if (!buffer) {
+				registry.buffers.push_back(std::make_unique<ThreadBuffer>());
+				buffer = registry.buffers.back().get();
+			}
+
+			buffer->in_use = true;
+			return buffer;
+		}
+	};
+
+	thread_local ThreadState thread_state;
+
+	std::string EscapeJson(const std::string& text)
+	{
+		std::string escaped;
+		for (char symbol : text) {
+			if (symbol == '"' || symbol == '\\')
+				escaped += '\\';
+
+			escaped += (unsigned char)symbol < 0x20 ? ' ' : symbol;
+		}
+
+		return escaped;
+	}
+}
+
+std::atomic<bool> Tracer::enabled{ false };
+
+
+void Tracer::Start()
+{
+	GetRegistry().start_ns.store(GetTimeNs(), std::memory_order_relaxed);
+	enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::Stop()
+{
+	enabled.store(false, std::memory_order_relaxed);
+}
+
+void Tracer::SetThreadName(const std::string& name)
+{
+	Registry& registry = GetRegistry();
+
+	std::lock_guard<std::mutex> guard(registry.lock);
+	registry.thread_names[thread_state.thread_id] = name;
+}
+
+void Tracer::AddEvent(const char* name, uint64_t begin_ns, uint64_t end_ns)
+{
+	ThreadBuffer* buffer = thread_state.GetBuffer();
+
+	uint64_t index = buffer->written.load(std::memory_order_relaxed);
+	TraceEvent& event = buffer->events[index & (ring_size - 1)];
+
+	event.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	event.name.store(name, std::memory_order_relaxed);
+	event.begin_ns.store(begin_ns, std::memory_order_relaxed);
+	event.end_ns.store(end_ns, std::memory_order_relaxed);
+	event.thread_id.store(thread_state.thread_id, std::memory_order_relaxed);
+
+	event.sequence.store(index + 1, std::memory_order_release);
+	buffer->written.store(index + 1, std::memory_order_release);
+}
+
+uint64_t Tracer::GetTimeNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+
+	struct EventCopy {
+		const char* name;
+		uint64_t begin_ns, end_ns;
+		uint32_t thread_id;
+	};
+
+	// events which are overwritten while they are read are skipped
+	std::vector<EventCopy> CopyEvents(std::map<uint32_t, std::string>& thread_names)
+	{
+		Registry& registry = GetRegistry();
+		uint64_t start_ns = registry.start_ns.load(std::memory_order_relaxed);
+
+		std::vector<ThreadBuffer*> buffers;
+		{
+			std::lock_guard<std::mutex> guard(registry.lock);
+			for (auto& buffer : registry.buffers)
+				buffers.push_back(buffer.get());
+
+			thread_names = registry.thread_names;
+		}
+
+		std::vector<EventCopy> events;
+		for (ThreadBuffer* buffer : buffers) {
+			uint64_t written = buffer->written.load(std::memory_order_acquire);
+			uint64_t first = written > ring_size ? written - ring_size : 0;
+
+			for (uint64_t index = first; index < written; ++index) {
+				TraceEvent& event = buffer->events[index & (ring_size - 1)];
+
+				if (event.sequence.load(std::memory_order_acquire) != index + 1)
+					continue;
+
+				EventCopy copy;
+				copy.name = event.name.load(std::memory_order_relaxed);
+				copy.begin_ns = event.begin_ns.load(std::memory_order_relaxed);
+				copy.end_ns = event.end_ns.load(std::memory_order_relaxed);
+				copy.thread_id = event.thread_id.load(std::memory_order_relaxed);
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (event.sequence.load(std::memory_order_relaxed) != index + 1)
+					continue;
+
+				if (copy.name && copy.begin_ns >= start_ns)
+					events.push_back(copy);
+			}
+		}
+
+		std::sort(events.begin(), events.end(), [](const EventCopy& left, const EventCopy& right) {
+			return left.begin_ns < right.begin_ns;
+		});
+
+		return events;
+	}
+}
+
+bool Tracer::WriteChromeTrace(const std::string& path)
+{
+	std::map<uint32_t, std::string> thread_names;
+	std::vector<EventCopy> events = CopyEvents(thread_names);
+
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file)
+		return false;
+
+	uint64_t start_ns = GetRegistry().start_ns.load(std::memory_order_relaxed);
+
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+	file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"DynamicWallpaper\"}}";
+
+	for (auto& thread_name : thread_names) {
+		file << "," << std::endl << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread_name.first
+			<< ", \"args\": {\"name\": \"" << EscapeJson(thread_name.second) << "\"}}";
+	}
+
+	// complete events, time in microseconds from the start of tracing
+	file << std::fixed << std::setprecision(3);
+	for (auto& event : events) {
+		file << "," << std::endl << "{\"name\": \"" << EscapeJson(event.name) << "\", \"cat\": \"playback\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+			<< event.thread_id << ", \"ts\": " << (event.begin_ns - start_ns) / 1000.0
+			<< ", \"dur\": " << (event.end_ns - event.begin_ns) / 1000.0 << "}";
+	}
+
+	file << std::endl << "]}" << std::endl;
+
+	return file.good();
+}
+
+size_t Tracer::GetEventsCount()
+{
+	std::map<uint32_t, std::string> thread_names;
+
+	return CopyEvents(thread_names).size();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+// Timeline of the playback pipeline in Chrome trace format, it can be opened in chrome://tracing
+// or ui.perfetto.dev. Every thread writes its events into its own ring buffer without locks,
+// the oldest events are overwritten. Tracing code exists only with DW_TRACING defined,
+// while tracing is stopped every scope costs one check of a flag.
+class Tracer {
+public:
+	// events recorded before start are dropped
+	static void Start();
+	static void Stop();
+
+	static bool IsEnabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	// name of the calling thread on the timeline
+	static void SetThreadName(const std::string& name);
+
+	// name must be a string literal, it is stored as a pointer
+	static void AddEvent(const char* name, uint64_t begin_ns, uint64_t end_ns);
+
+	static uint64_t GetTimeNs();
+
+	// events of all threads as Chrome trace JSON, tracing can be running
+	static bool WriteChromeTrace(const std::string& path);
+
+	static size_t GetEventsCount();
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+
+// Event from construction till destruction of the scope
+class TraceScope {
+public:
+	explicit TraceScope(const char* name) :
+		name(Tracer::IsEnabled() ? name : nullptr)
+	{
+		if (this->name)
+			begin_ns = Tracer::GetTimeNs();
+	}
+
+	~TraceScope()
+	{
+		if (name)
+			Tracer::AddEvent(name, begin_ns, Tracer::GetTimeNs());
+	}
+
+	TraceScope(const TraceScope& obj) = delete;
+	TraceScope& operator=(const TraceScope& obj) = delete;
+
+private:
+	const char* name;
+	uint64_t begin_ns = 0;
+};
+
+
+#ifdef DW_TRACING
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Tracer::SetThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif